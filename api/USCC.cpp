@@ -0,0 +1,135 @@
+//
+//  USCC.cpp
+//  uscc
+//
+//  Implements the embeddable uscc API (libuscc).
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "USCC.h"
+#include "../parse/Parse.h"
+#include "../parse/ParseExcept.h"
+#include "../parse/Emitter.h"
+#include "../opt/Passes.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/Support/raw_ostream.h>
+#pragma clang diagnostic pop
+
+#include <istream>
+#include <streambuf>
+
+using namespace uscc;
+using namespace uscc::api;
+
+namespace
+{
+
+// Reads directly out of the caller's buffer, so the source
+// isn't copied before the parse
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+	MemoryStreamBuf(const char* source, size_t length)
+	{
+		char* begin = const_cast<char*>(source);
+		setg(begin, begin, begin + length);
+	}
+};
+
+// Adds an error that isn't tied to a line in the source
+void addDiagnostic(const std::string& fileName, const char* message,
+				   std::vector<Diagnostic>& diagnostics)
+{
+	Diagnostic diag;
+	diag.mFileName = fileName;
+	diag.mMessage = message;
+	diagnostics.push_back(diag);
+}
+
+} // anonymous
+
+void api::initialize()
+{
+	opt::initializeOptPasses();
+}
+
+std::unique_ptr<llvm::Module> api::compileToModule(const std::string& fileName,
+												   const char* source, size_t length,
+												   llvm::LLVMContext& context,
+												   const Options& options,
+												   std::vector<Diagnostic>& diagnostics)
+{
+	MemoryStreamBuf buffer(source, length);
+	std::istream sourceStream(&buffer);
+
+	try
+	{
+		// No error stream, since the errors are returned as Diagnostics
+		parse::Parser parser(fileName.c_str(), sourceStream, nullptr, nullptr, false);
+		if (!parser.IsValid())
+		{
+			for (const auto& error : parser.GetErrors())
+			{
+				Diagnostic diag;
+				diag.mFileName = fileName;
+				diag.mLine = error->mLineNum;
+				diag.mColumn = error->mColNum;
+				diag.mMessage = error->mMsg;
+				diag.mSourceLine = parser.GetSourceLine(error->mLineNum);
+				diagnostics.push_back(diag);
+			}
+			return nullptr;
+		}
+
+		parse::Emitter emit(parser, context);
+		if (options.mOptimize)
+		{
+			emit.optimize(options.mOptLevel);
+		}
+
+		if (!emit.verify())
+		{
+			addDiagnostic(fileName, "Emitted bad IR", diagnostics);
+			return nullptr;
+		}
+
+		return std::unique_ptr<llvm::Module>(emit.releaseModule());
+	}
+	catch (parse::ParseExcept& e)
+	{
+		addDiagnostic(fileName, "Critical error", diagnostics);
+	}
+
+	return nullptr;
+}
+
+bool api::compileToBitcode(const std::string& fileName,
+						   const char* source, size_t length,
+						   llvm::LLVMContext& context,
+						   const Options& options,
+						   std::vector<Diagnostic>& diagnostics,
+						   std::string& bitcode)
+{
+	std::unique_ptr<llvm::Module> module = compileToModule(fileName, source, length,
+														   context, options, diagnostics);
+	if (!module)
+	{
+		return false;
+	}
+
+	llvm::raw_string_ostream output(bitcode);
+	llvm::WriteBitcodeToFile(module.get(), output);
+	output.flush();
+	return true;
+}
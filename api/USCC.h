@@ -0,0 +1,98 @@
+//
+//  USCC.h
+//  uscc
+//
+//  Declares the embeddable uscc API (libuscc).
+//  This compiles USC source that's already in memory
+//  straight to an llvm::Module or to bitcode in memory,
+//  without touching the filesystem or spawning uscc.
+//
+//  libuscc.a contains the parser, scanner, optimizer and
+//  support code, so it only needs to be linked with LLVM.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm
+{
+	class LLVMContext;
+	class Module;
+}
+
+namespace uscc
+{
+namespace api
+{
+
+// A single error found while compiling
+struct Diagnostic
+{
+	Diagnostic()
+	: mLine(0)
+	, mColumn(0)
+	{ }
+
+	// Name the source was compiled under
+	std::string mFileName;
+	// 1-based line and column of the error
+	int mLine;
+	int mColumn;
+	// Error text, without the file/line prefix
+	std::string mMessage;
+	// Text of the source line the error is on
+	std::string mSourceLine;
+};
+
+// Options for a single compile
+struct Options
+{
+	Options()
+	: mOptimize(false)
+	, mOptLevel(1)
+	{ }
+
+	// Run the uscc optimization passes (-O)
+	bool mOptimize;
+	// Which passes to run when mOptimize is set (-O1 to -O3)
+	unsigned int mOptLevel;
+};
+
+// Must be called once before the first compile.
+// Registers the analyses that the optimization passes use.
+void initialize();
+
+// Compiles length bytes of source into a module owned by context.
+// fileName is only used for diagnostics.
+// Returns null if there were any errors, in which case they're
+// appended to diagnostics.
+// Compiles in different contexts can run on different threads.
+std::unique_ptr<llvm::Module> compileToModule(const std::string& fileName,
+											  const char* source, size_t length,
+											  llvm::LLVMContext& context,
+											  const Options& options,
+											  std::vector<Diagnostic>& diagnostics);
+
+// Compiles the source and writes its bitcode to bitcode.
+// Returns false if there were any errors, in which case they're
+// appended to diagnostics.
+bool compileToBitcode(const std::string& fileName,
+					  const char* source, size_t length,
+					  llvm::LLVMContext& context,
+					  const Options& options,
+					  std::vector<Diagnostic>& diagnostics,
+					  std::string& bitcode);
+
+} // api
+} // uscc
@@ -16,6 +16,10 @@
 #include <set>
 
 namespace llvm {
+// Defined by INITIALIZE_PASS in Liveness.cpp (a stock LLVM's
+// InitializePasses.h doesn't declare it)
+void initializeLivenessPass(PassRegistry&);
+
 // Liveness analysis
 class Liveness : public FunctionPass 
 {
@@ -17,25 +17,231 @@
 #include <llvm/IR/Dominators.h>
 #include <llvm/Analysis/LoopInfo.h>
 #include <llvm/PassRegistry.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Vectorize.h>
+#include "../support/Timing.h"
+#include <sstream>
 
 using namespace llvm;
+using uscc::support::PhaseTimer;
+
+namespace
+{
+
+// Brackets a pass, so the phase timer can record how long
+// the pass takes on each function.
+// The end marker points at the start marker, which holds
+// the time (and counts) when the pass started on the current
+// function.
+struct PhaseMarker : public FunctionPass
+{
+	static char ID;
+	PhaseMarker(const char* name, PhaseMarker* startMarker)
+	: FunctionPass(ID)
+	, mName(name)
+	, mStartMarker(startMarker)
+	{ }
+	
+	virtual bool runOnFunction(Function& F) override
+	{
+		PhaseTimer* timer = PhaseTimer::getActive();
+		if (!timer)
+		{
+			return false;
+		}
+		
+		if (!mStartMarker)
+		{
+			mStartCounts = timer->readCounters();
+			mStart = PhaseTimer::Clock::now();
+		}
+		else
+		{
+			PhaseTimer::Clock::time_point end = PhaseTimer::Clock::now();
+			timer->record(mName, mStartMarker->mStart, end,
+						  timer->readCounters() - mStartMarker->mStartCounts);
+		}
+		return false;
+	}
+	
+	virtual void getAnalysisUsage(AnalysisUsage& Info) const override
+	{
+		Info.setPreservesAll();
+	}
+	
+	virtual const char* getPassName() const override
+	{
+		return "USCC phase marker";
+	}
+	
+	const char* mName;
+	PhaseMarker* mStartMarker;
+	PhaseTimer::Clock::time_point mStart;
+	uscc::support::PhaseCounts mStartCounts;
+};
+
+char PhaseMarker::ID = 0;
+
+// Adds the pass, timed under name if there's an active phase timer.
+// (Analyses the pass requires are scheduled inside the markers, so
+// they count towards its time.)
+void addTimedPass(legacy::PassManager& pm, Pass* pass, const char* name)
+{
+	if (PhaseTimer::getActive())
+	{
+		PhaseMarker* startMarker = new PhaseMarker(name, nullptr);
+		pm.add(startMarker);
+		pm.add(pass);
+		pm.add(new PhaseMarker(name, startMarker));
+	}
+	else
+	{
+		pm.add(pass);
+	}
+}
+
+// The passes that can be named in a pipeline
+struct OptPassInfo
+{
+	const char* mName;
+	// Name in the phase timer
+	const char* mPhaseName;
+	Pass* (*mCreate)();
+};
+
+const OptPassInfo sOptPasses[] =
+{
+	// uscc's passes
+	{ "constops", "optimize/ConstantOps", []() -> Pass* { return new uscc::opt::ConstantOps(); } },
+	{ "constbranch", "optimize/ConstantBranch", []() -> Pass* { return new uscc::opt::ConstantBranch(); } },
+	{ "deadblocks", "optimize/DeadBlocks", []() -> Pass* { return new uscc::opt::DeadBlocks(); } },
+	{ "licm", "optimize/LICM", []() -> Pass* { return new uscc::opt::LICM(); } },
+	{ "dce", "optimize/DCE", []() -> Pass* { return createDCEPass(); } },
+	// LLVM's passes
+	{ "sroa", "optimize/SROA", []() -> Pass* { return createSROAPass(); } },
+	{ "earlycse", "optimize/EarlyCSE", []() -> Pass* { return createEarlyCSEPass(); } },
+	{ "instcombine", "optimize/InstCombine", []() -> Pass* { return createInstructionCombiningPass(); } },
+	{ "simplifycfg", "optimize/SimplifyCFG", []() -> Pass* { return createCFGSimplificationPass(); } },
+	{ "reassociate", "optimize/Reassociate", []() -> Pass* { return createReassociatePass(); } },
+	{ "sccp", "optimize/SCCP", []() -> Pass* { return createSCCPPass(); } },
+	{ "gvn", "optimize/GVN", []() -> Pass* { return createGVNPass(); } },
+	{ "looprotate", "optimize/LoopRotate", []() -> Pass* { return createLoopRotatePass(); } },
+	{ "indvars", "optimize/IndVarSimplify", []() -> Pass* { return createIndVarSimplifyPass(); } },
+	{ "llvm-licm", "optimize/LLVM LICM", []() -> Pass* { return createLICMPass(); } },
+	{ "loopunroll", "optimize/LoopUnroll", []() -> Pass* { return createLoopUnrollPass(); } },
+	{ "loopvectorize", "optimize/LoopVectorize", []() -> Pass* { return createLoopVectorizePass(); } },
+	{ "slpvectorize", "optimize/SLPVectorizer", []() -> Pass* { return createSLPVectorizerPass(); } },
+	{ "adce", "optimize/ADCE", []() -> Pass* { return createAggressiveDCEPass(); } },
+};
+
+// The pipeline of each level. Each level runs the one below
+// it first.
+const char* sOptLevels[] =
+{
+	"constops,constbranch,deadblocks,licm",
+	"dce,earlycse,simplifycfg",
+	"sroa,earlycse,instcombine,reassociate,sccp,looprotate,indvars,llvm-licm,"
+	"loopunroll,gvn,loopvectorize,slpvectorize,instcombine,adce,simplifycfg",
+};
+
+const OptPassInfo* findOptPass(const std::string& name)
+{
+	for (const auto& info : sOptPasses)
+	{
+		if (name == info.mName)
+		{
+			return &info;
+		}
+	}
+	return nullptr;
+}
+
+// Splits pipeline at the commas, and looks up each pass.
+// Returns false (and sets badName) if a name isn't a known pass.
+bool parsePipeline(const std::string& pipeline, std::vector<const OptPassInfo*>& passes,
+				   std::string& badName)
+{
+	std::istringstream names(pipeline);
+	std::string name;
+	while (std::getline(names, name, ','))
+	{
+		if (name.empty())
+		{
+			continue;
+		}
+		const OptPassInfo* info = findOptPass(name);
+		if (!info)
+		{
+			badName = name;
+			return false;
+		}
+		passes.push_back(info);
+	}
+	return true;
+}
+
+void addPipeline(legacy::PassManager& pm, const std::vector<const OptPassInfo*>& passes)
+{
+	uscc::opt::initializeOptPasses();
+	for (auto info : passes)
+	{
+		addTimedPass(pm, info->mCreate(), info->mPhaseName);
+	}
+	pm.add(new DominatorTreeWrapperPass());
+	pm.add(new LoopInfo());
+}
+
+} // anonymous
 
 namespace uscc
 {
 namespace opt
 {
 
-void registerOptPasses(legacy::PassManager& pm)
+void initializeOptPasses()
 {
 	PassRegistry& pr = *PassRegistry::getPassRegistry();
 	initializeLoopInfoPass(pr);
 	initializeDominatorTreeWrapperPassPass(pr);
-	pm.add(new ConstantOps());
-	pm.add(new ConstantBranch());
-	pm.add(new DeadBlocks());
-	pm.add(new LICM());
-	pm.add(new DominatorTreeWrapperPass());
-	pm.add(new LoopInfo());
+}
+
+void registerOptPasses(legacy::PassManager& pm, unsigned int level)
+{
+	std::vector<const OptPassInfo*> passes;
+	std::string badName;
+	for (unsigned int i = 0; i < level && i < sizeof(sOptLevels) / sizeof(sOptLevels[0]); i++)
+	{
+		parsePipeline(sOptLevels[i], passes, badName);
+	}
+	addPipeline(pm, passes);
+}
+
+bool registerOptPipeline(legacy::PassManager& pm, const std::string& pipeline,
+						 std::string& badName)
+{
+	std::vector<const OptPassInfo*> passes;
+	if (!parsePipeline(pipeline, passes, badName))
+	{
+		return false;
+	}
+	addPipeline(pm, passes);
+	return true;
+}
+
+bool isOptPipeline(const std::string& pipeline, std::string& badName)
+{
+	std::vector<const OptPassInfo*> passes;
+	return parsePipeline(pipeline, passes, badName);
+}
+
+std::vector<std::string> getOptPassNames()
+{
+	std::vector<std::string> retVal;
+	for (const auto& info : sOptPasses)
+	{
+		retVal.push_back(info.mName);
+	}
+	return retVal;
 }
 
 } // opt
@@ -10,7 +10,12 @@
 //     * Removal of dead blocks from CFG
 //     * Loop Invariant Code Motion (LICM)
 //
-//  These passes will execute if uscc is ran with -O
+//  These passes will execute if uscc is ran with -O (or -O1).
+//  -O2 adds the DCE pass (opt/DCE.cpp, which is built into
+//  libopt along with the Liveness analysis it uses) and some
+//  cheap LLVM cleanups, and -O3 adds LLVM's scalar, loop and
+//  vector passes.
+//  Every pass in every level only looks at one function at a time.
 //
 //---------------------------------------------------------
 //  Copyright (c) 2014, Sanjay Madhav
@@ -27,6 +32,15 @@
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Dominators.h>
 #pragma clang diagnostic pop
+#include <string>
+#include <vector>
+
+namespace llvm
+{
+	// Defined in opt/DCE.cpp (in libopt, so uscc links
+	// against a stock LLVM)
+	FunctionPass* createDCEPass();
+}
 
 using llvm::FunctionPass;
 using llvm::LoopPass;
@@ -37,8 +51,27 @@ namespace uscc
 namespace opt
 {
 
+// Initializes the LLVM analyses our passes depend on.
+// This is safe to call more than once, but the driver calls it
+// up front so worker threads never race on the PassRegistry.
+void initializeOptPasses();
+
 // Helper function for registering the opt passes
-void registerOptPasses(llvm::legacy::PassManager& pm);
+// of an optimization level (1 to 3)
+void registerOptPasses(llvm::legacy::PassManager& pm, unsigned int level = 1);
+
+// Registers the passes in pipeline, a comma separated list of
+// pass names such as "constops,constbranch,licm".
+// Returns false (and sets badName) if a name isn't a known pass.
+bool registerOptPipeline(llvm::legacy::PassManager& pm, const std::string& pipeline,
+						 std::string& badName);
+
+// Returns true if every name in pipeline is a known pass.
+// Otherwise sets badName to the first unknown one.
+bool isOptPipeline(const std::string& pipeline, std::string& badName);
+
+// Returns the names registerOptPipeline accepts
+std::vector<std::string> getOptPassNames();
 
 // Declares the Constant Propagation Pass
 struct ConstantOps : public FunctionPass
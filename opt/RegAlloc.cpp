@@ -44,6 +44,7 @@
 #undef DEBUG
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetRegisterInfo.h"
 #include <cstdlib>
@@ -58,6 +59,30 @@ using namespace llvm;
 
 #define DEBUG_TYPE "regalloc"
 
+static const char TimerGroupName[] = "USCC Register Allocation";
+
+// uscc's phase timer (-ftime-report, -ftime-trace), from
+// support/Timing.h. These are weak, since llc links this allocator
+// without uscc's support library.
+extern "C" void* usccBeginPhase(const char* name) __attribute__((weak));
+extern "C" void usccEndPhase(void* phase) __attribute__((weak));
+
+namespace {
+	// Records its lifetime as a phase, when the allocator
+	// runs inside uscc with a phase timer active
+	class PhaseScope {
+		void* Phase;
+	public:
+		PhaseScope(const char* name)
+		: Phase(usccBeginPhase ? usccBeginPhase(name) : nullptr) { }
+		~PhaseScope() {
+			if (Phase) {
+				usccEndPhase(Phase);
+			}
+		}
+	};
+}
+
 static FunctionPass* createUSCCRegisterAllocator();
 
 static RegisterRegAlloc usccRegAlloc("uscc", "USCC register allocator",
@@ -310,6 +335,7 @@ bool RAUSCC::runOnMachineFunction(MachineFunction &mf) {
 	std::cout << "********** Function: " << funcName << '\n';
 	std::cout << "NUM_COLORS=" << NUM_COLORS << '\n';
 	MF = &mf;
+	PhaseScope timeRegAlloc("codegen/regalloc");
 	RegAllocBase::init(getAnalysis<VirtRegMap>(),
 					   getAnalysis<LiveIntervals>(),
 					   getAnalysis<LiveRegMatrix>());
@@ -320,10 +346,24 @@ bool RAUSCC::runOnMachineFunction(MachineFunction &mf) {
 	
 	SpillerInstance.reset(createInlineSpiller(*this, *MF, *VRM));
 	
-	initGraph();
-	simplifyGraph();
-	
-	allocatePhysRegs();
+	// These show up in the -time-passes report, and in uscc's
+	// -ftime-report and -ftime-trace under codegen/regalloc
+	{
+		NamedRegionTimer T("Build interference graph", TimerGroupName,
+						   TimePassesIsEnabled);
+		PhaseScope timeGraph("codegen/regalloc/build interference graph");
+		initGraph();
+	}
+	{
+		NamedRegionTimer T("Simplify graph", TimerGroupName, TimePassesIsEnabled);
+		PhaseScope timeSimplify("codegen/regalloc/simplify graph");
+		simplifyGraph();
+	}
+	{
+		NamedRegionTimer T("Select registers", TimerGroupName, TimePassesIsEnabled);
+		PhaseScope timeSelect("codegen/regalloc/select registers");
+		allocatePhysRegs();
+	}
 	
 	// Diagnostic output before rewriting
 	DEBUG(dbgs() << "Post alloc VirtRegMap:\n" << *VRM << "\n");
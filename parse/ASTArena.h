@@ -0,0 +1,176 @@
+//
+//  ASTArena.h
+//  uscc
+//
+//  Declares the arena the parser allocates AST nodes from,
+//  and the arrays the nodes keep their children in.
+//
+//  Nodes are bumped out of large blocks, and are never
+//  destroyed one at a time. The blocks are all released
+//  together when the arena goes away, so a node must not
+//  own anything that needs its destructor to run: it only
+//  holds plain values, pointers to other nodes, and
+//  ASTArrays (which live in the arena too).
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace uscc
+{
+namespace parse
+{
+
+class ASTArena
+{
+public:
+	ASTArena() noexcept
+	: mPos(nullptr)
+	, mEnd(nullptr)
+	, mBytes(0)
+	{ }
+
+	// Returns size bytes aligned to align (a power of two)
+	void* allocate(size_t size, size_t align)
+	{
+		// (Aligning can move pos past the end of the block)
+		char* pos = alignUp(mPos, align);
+		if (pos == nullptr || pos > mEnd || size > static_cast<size_t>(mEnd - pos))
+		{
+			pos = alignUp(grow(size + align), align);
+		}
+
+		mPos = pos + size;
+		mBytes += size;
+		return pos;
+	}
+
+	// Constructs a T in the arena. Its destructor is never called.
+	template <typename T, typename... Args>
+	T* make(Args&&... args)
+	{
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// Number of bytes handed out so far
+	size_t getBytes() const noexcept
+	{
+		return mBytes;
+	}
+
+private:
+	// Disallow copy/assignment
+	ASTArena(const ASTArena& copy);
+	ASTArena& operator=(const ASTArena& rhs);
+
+	static char* alignUp(char* pos, size_t align) noexcept
+	{
+		size_t mask = align - 1;
+		return reinterpret_cast<char*>((reinterpret_cast<size_t>(pos) + mask) & ~mask);
+	}
+
+	// Starts a new block with at least size bytes in it,
+	// and returns the start of it
+	char* grow(size_t size)
+	{
+		size_t blockSize = (size > sBlockSize) ? size : sBlockSize;
+		mBlocks.emplace_back(new char[blockSize]);
+		mPos = mBlocks.back().get();
+		mEnd = mPos + blockSize;
+		return mPos;
+	}
+
+	static const size_t sBlockSize = 64 * 1024;
+
+	std::vector<std::unique_ptr<char[]>> mBlocks;
+	// Free space left in the last block
+	char* mPos;
+	char* mEnd;
+	size_t mBytes;
+};
+
+// A contiguous array in an ASTArena. When it runs out of room,
+// it moves to a block twice the size (the old one is left in
+// the arena), so appending is still amortized constant time.
+template <typename T>
+class ASTArray
+{
+	static_assert(std::is_trivially_copyable<T>::value,
+				  "ASTArray elements are copied with memcpy, and never destroyed");
+
+public:
+	ASTArray() noexcept
+	: mData(nullptr)
+	, mSize(0)
+	, mCapacity(0)
+	{ }
+
+	void push_back(ASTArena& arena, T value)
+	{
+		if (mSize == mCapacity)
+		{
+			size_t capacity = (mCapacity == 0) ? 4 : mCapacity * 2;
+			T* data = static_cast<T*>(arena.allocate(sizeof(T) * capacity, alignof(T)));
+			if (mSize != 0)
+			{
+				std::memcpy(data, mData, sizeof(T) * mSize);
+			}
+			mData = data;
+			mCapacity = capacity;
+		}
+
+		mData[mSize++] = value;
+	}
+
+	size_t size() const noexcept
+	{
+		return mSize;
+	}
+
+	bool empty() const noexcept
+	{
+		return mSize == 0;
+	}
+
+	const T& operator[](size_t index) const noexcept
+	{
+		return mData[index];
+	}
+
+	const T& back() const noexcept
+	{
+		return mData[mSize - 1];
+	}
+
+	const T* begin() const noexcept
+	{
+		return mData;
+	}
+
+	const T* end() const noexcept
+	{
+		return mData + mSize;
+	}
+
+private:
+	T* mData;
+	size_t mSize;
+	size_t mCapacity;
+};
+
+} // parse
+} // uscc
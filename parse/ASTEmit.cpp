@@ -61,17 +61,32 @@ AST_EMIT(ASTProgram)
 		ctx.mPrintfIdent->setAddress(func);
 	}
 	
+	// Declare the functions other files of the program define
+	for (auto ident : ctx.mExternFuncs)
+	{
+		ident->getFunction()->emitDecl(ctx, ident);
+	}
+	
 	// Emit code for all the functions
 	for (auto f : mFuncs)
 	{
-		f->emitIR(ctx);
+		// A function from the function cache only needs to be declared,
+		// since its body is linked in later
+		if (ctx.mCachedFuncs.find(f) != ctx.mCachedFuncs.end())
+		{
+			f->emitDecl(ctx);
+		}
+		else
+		{
+			f->emitIR(ctx);
+		}
 	}
 	// A program actually doesn't have a value to return, since everything
 	// is stored in Module
 	return nullptr;
 }
 
-AST_EMIT(ASTFunction)
+llvm::Function* ASTFunction::emitDecl(CodeContext& ctx, Identifier* ident) noexcept
 {
 	FunctionType* funcType = nullptr;
 	
@@ -100,23 +115,33 @@ AST_EMIT(ASTFunction)
 		std::vector<llvm::Type*> args;
 		for (auto arg : mArgs)
 		{
-			args.push_back(arg->getIdent().llvmType());
+			args.push_back(arg->getIdent().llvmType(ctx.mGlobal));
 		}
 		
 		funcType = FunctionType::get(retType, args, false);
 	}
 	
+	Function* func = Function::Create(funcType,
+									  GlobalValue::LinkageTypes::ExternalLinkage,
+									  mIdent.getName(), ctx.mModule);
+	
+	// Map the ident to this function
+	if (!ident)
+	{
+		ident = &mIdent;
+	}
+	ident->setAddress(func);
+	return func;
+}
+
+AST_EMIT(ASTFunction)
+{
 	// Create the function, and make it the current one
-	ctx.mFunc = Function::Create(funcType,
-								 GlobalValue::LinkageTypes::ExternalLinkage,
-								 mIdent.getName(), ctx.mModule);
+	ctx.mFunc = emitDecl(ctx);
 	
 	// Now that we have a new function, reset our SSA builder
 	ctx.mSSA.reset();
 	
-	// Map the ident to this function
-	mIdent.setAddress(ctx.mFunc);
-	
 	// Create the entry basic block
 	ctx.mBlock = BasicBlock::Create(ctx.mGlobal, "entry", ctx.mFunc);
 	// Add and seal this block
@@ -189,152 +214,211 @@ AST_EMIT(ASTLogicalAnd)
 {
 	// This is extremely similar to logical or
 	
-	// Create the block for the RHS
-	BasicBlock* rhsBlock = BasicBlock::Create(ctx.mGlobal, "and.rhs", ctx.mFunc);
-	// Add the rhs block to SSA (not sealed)
-	ctx.mSSA.addBlock(rhsBlock);
-	
-	// In both "true" and "false" condition, we'll jump to and.end
-	// This is because we'll insert a phi node that assume false
-	// if the and.end jump was from the lhs block
-	BasicBlock* endBlock = BasicBlock::Create(ctx.mGlobal, "and.end", ctx.mFunc);
-	// Also not sealed
-	ctx.mSSA.addBlock(endBlock);
-	
-	// Now generate the LHS
-	Value* lhsVal = mLHS->emitIR(ctx);
-	
-	BasicBlock* lhsBlock = ctx.mBlock;
-	
-	// Add the branch to the end of the LHS
+	// a && b && c parses as ((a && b) && c), so a long chain is a long
+	// left spine. Walk down it here instead of emitting mLHS with a
+	// call, so a chain doesn't use up the stack.
+	std::vector<ASTLogicalAnd*> chain;
+	for (ASTExpr* expr = this; ; )
 	{
-		IRBuilder<> build(ctx.mBlock);
-		// We can assume it WILL be an i32 here
-		// since it'd have been zero-extended otherwise
-		lhsVal = build.CreateICmpNE(lhsVal, ctx.mZero, "tobool");
-		build.CreateCondBr(lhsVal, rhsBlock, endBlock);
+		ASTLogicalAnd* node = dynamic_cast<ASTLogicalAnd*>(expr);
+		if (node == nullptr)
+		{
+			break;
+		}
+		chain.push_back(node);
+		expr = node->mLHS;
 	}
 	
-	// rhsBlock should now be sealed
-	ctx.mSSA.sealBlock(rhsBlock);
-	
-	// Code should now be generated in the RHS block
-	ctx.mBlock = rhsBlock;
-	Value* rhsVal = mRHS->emitIR(ctx);
-	
-	// This is the final RHS block (for the phi node)
-	rhsBlock = ctx.mBlock;
-	
-	// Add the branch and the end of the RHS
+	// Each op's blocks go before the blocks of its LHS, as if the
+	// LHS were emitted from inside this op
+	std::vector<BasicBlock*> rhsBlocks;
+	std::vector<BasicBlock*> endBlocks;
+	for (size_t i = 0; i < chain.size(); i++)
 	{
-		IRBuilder<> build(ctx.mBlock);
-		rhsVal = build.CreateICmpNE(rhsVal, ctx.mZero, "tobool");
+		// Create the block for the RHS
+		BasicBlock* rhsBlock = BasicBlock::Create(ctx.mGlobal, "and.rhs", ctx.mFunc);
+		// Add the rhs block to SSA (not sealed)
+		ctx.mSSA.addBlock(rhsBlock);
+		rhsBlocks.push_back(rhsBlock);
 		
-		// We do an unconditional branch because the phi mode will handle
-		// the correct value
-		build.CreateBr(endBlock);
+		// In both "true" and "false" condition, we'll jump to and.end
+		// This is because we'll insert a phi node that assume false
+		// if the and.end jump was from the lhs block
+		BasicBlock* endBlock = BasicBlock::Create(ctx.mGlobal, "and.end", ctx.mFunc);
+		// Also not sealed
+		ctx.mSSA.addBlock(endBlock);
+		endBlocks.push_back(endBlock);
 	}
 	
-	// endBlock should now be sealed
-	ctx.mSSA.sealBlock(endBlock);
-	
-	ctx.mBlock = endBlock;
+	// Now generate the LHS of the innermost op. Each op's value
+	// is then the LHS of the op above it.
+	Value* lhsVal = chain.back()->mLHS->emitIR(ctx);
 	
-	IRBuilder<> build(ctx.mBlock);
-	
-	// Figure out the value to zext
-	Value* zextVal = nullptr;
-	
-	// If rhs is not also false, we need to make a phi
-	if (rhsVal != ConstantInt::getFalse(ctx.mGlobal))
-	{
-		PHINode* phi = build.CreatePHI(llvm::Type::getInt1Ty(ctx.mGlobal), 2);
-		// If we came from the lhs, it had to be false
-		phi->addIncoming(ConstantInt::getFalse(ctx.mGlobal), lhsBlock);
-		phi->addIncoming(rhsVal, rhsBlock);
-		zextVal = phi;
-	}
-	else
+	for (size_t i = chain.size(); i-- > 0; )
 	{
-		zextVal = ConstantInt::getFalse(ctx.mGlobal);
+		BasicBlock* rhsBlock = rhsBlocks[i];
+		BasicBlock* endBlock = endBlocks[i];
+		BasicBlock* lhsBlock = ctx.mBlock;
+		
+		// Add the branch to the end of the LHS
+		{
+			IRBuilder<> build(ctx.mBlock);
+			// We can assume it WILL be an i32 here
+			// since it'd have been zero-extended otherwise
+			lhsVal = build.CreateICmpNE(lhsVal, ctx.mZero, "tobool");
+			build.CreateCondBr(lhsVal, rhsBlock, endBlock);
+		}
+		
+		// rhsBlock should now be sealed
+		ctx.mSSA.sealBlock(rhsBlock);
+		
+		// Code should now be generated in the RHS block
+		ctx.mBlock = rhsBlock;
+		Value* rhsVal = chain[i]->mRHS->emitIR(ctx);
+		
+		// This is the final RHS block (for the phi node)
+		rhsBlock = ctx.mBlock;
+		
+		// Add the branch and the end of the RHS
+		{
+			IRBuilder<> build(ctx.mBlock);
+			rhsVal = build.CreateICmpNE(rhsVal, ctx.mZero, "tobool");
+			
+			// We do an unconditional branch because the phi mode will handle
+			// the correct value
+			build.CreateBr(endBlock);
+		}
+		
+		// endBlock should now be sealed
+		ctx.mSSA.sealBlock(endBlock);
+		
+		ctx.mBlock = endBlock;
+		
+		IRBuilder<> build(ctx.mBlock);
+		
+		// Figure out the value to zext
+		Value* zextVal = nullptr;
+		
+		// If rhs is not also false, we need to make a phi
+		if (rhsVal != ConstantInt::getFalse(ctx.mGlobal))
+		{
+			PHINode* phi = build.CreatePHI(llvm::Type::getInt1Ty(ctx.mGlobal), 2);
+			// If we came from the lhs, it had to be false
+			phi->addIncoming(ConstantInt::getFalse(ctx.mGlobal), lhsBlock);
+			phi->addIncoming(rhsVal, rhsBlock);
+			zextVal = phi;
+		}
+		else
+		{
+			zextVal = ConstantInt::getFalse(ctx.mGlobal);
+		}
+		
+		lhsVal = build.CreateZExt(zextVal, llvm::Type::getInt32Ty(ctx.mGlobal));
 	}
 	
-	return build.CreateZExt(zextVal, llvm::Type::getInt32Ty(ctx.mGlobal));
+	return lhsVal;
 }
 
 AST_EMIT(ASTLogicalOr)
 {
-	// Create the block for the RHS
-	BasicBlock* rhsBlock = BasicBlock::Create(ctx.mGlobal, "lor.rhs", ctx.mFunc);
-	// Add the rhs block to SSA (not sealed)
-	ctx.mSSA.addBlock(rhsBlock);
-
-	// In both "true" and "false" condition, we'll jump to lor.end
-	// This is because we'll insert a phi node that assume true
-	// if the lor.end jump was from the lhs block
-	BasicBlock* endBlock = BasicBlock::Create(ctx.mGlobal, "lor.end", ctx.mFunc);
-	// Also not sealed
-	ctx.mSSA.addBlock(endBlock);
-	
-	// Now generate the LHS
-	Value* lhsVal = mLHS->emitIR(ctx);
-	
-	BasicBlock* lhsBlock = ctx.mBlock;
-	
-	// Add the branch to the end of the LHS
+	// Same as logical and, this walks down the left spine of a chain
+	std::vector<ASTLogicalOr*> chain;
+	for (ASTExpr* expr = this; ; )
 	{
-		IRBuilder<> build(ctx.mBlock);
-		// We can assume it WILL be an i32 here
-		// since it'd have been zero-extended otherwise
-		lhsVal = build.CreateICmpNE(lhsVal, ctx.mZero, "tobool");
-		build.CreateCondBr(lhsVal, endBlock, rhsBlock);
+		ASTLogicalOr* node = dynamic_cast<ASTLogicalOr*>(expr);
+		if (node == nullptr)
+		{
+			break;
+		}
+		chain.push_back(node);
+		expr = node->mLHS;
 	}
 	
-	// rhsBlock should now be sealed
-	ctx.mSSA.sealBlock(rhsBlock);
-	
-	// Code should now be generated in the RHS block
-	ctx.mBlock = rhsBlock;
-	Value* rhsVal = mRHS->emitIR(ctx);
-	
-	// This is the final RHS block (for the phi node)
-	rhsBlock = ctx.mBlock;
-	
-	// Add the branch and the end of the RHS
+	std::vector<BasicBlock*> rhsBlocks;
+	std::vector<BasicBlock*> endBlocks;
+	for (size_t i = 0; i < chain.size(); i++)
 	{
-		IRBuilder<> build(ctx.mBlock);
-		rhsVal = build.CreateICmpNE(rhsVal, ctx.mZero, "tobool");
-		
-		// We do an unconditional branch because the phi mode will handle
-		// the correct value
-		build.CreateBr(endBlock);
+		// Create the block for the RHS
+		BasicBlock* rhsBlock = BasicBlock::Create(ctx.mGlobal, "lor.rhs", ctx.mFunc);
+		// Add the rhs block to SSA (not sealed)
+		ctx.mSSA.addBlock(rhsBlock);
+		rhsBlocks.push_back(rhsBlock);
+
+		// In both "true" and "false" condition, we'll jump to lor.end
+		// This is because we'll insert a phi node that assume true
+		// if the lor.end jump was from the lhs block
+		BasicBlock* endBlock = BasicBlock::Create(ctx.mGlobal, "lor.end", ctx.mFunc);
+		// Also not sealed
+		ctx.mSSA.addBlock(endBlock);
+		endBlocks.push_back(endBlock);
 	}
 	
-	// endBlock should now be sealed
-	ctx.mSSA.sealBlock(endBlock);
-	
-	ctx.mBlock = endBlock;
-	
-	IRBuilder<> build(ctx.mBlock);
-	
-	// Figure out the value to zext
-	Value* zextVal = nullptr;
+	// Now generate the LHS of the innermost op
+	Value* lhsVal = chain.back()->mLHS->emitIR(ctx);
 	
-	// If rhs is not also true, we need to make a phi
-	if (rhsVal != ConstantInt::getTrue(ctx.mGlobal))
+	for (size_t i = chain.size(); i-- > 0; )
 	{
-		PHINode* phi = build.CreatePHI(llvm::Type::getInt1Ty(ctx.mGlobal), 2);
-		// If we came from the lhs, it had to be false
-		phi->addIncoming(ConstantInt::getTrue(ctx.mGlobal), lhsBlock);
-		phi->addIncoming(rhsVal, rhsBlock);
-		zextVal = phi;
-	}
-	else
-	{
-		zextVal = ConstantInt::getTrue(ctx.mGlobal);
+		BasicBlock* rhsBlock = rhsBlocks[i];
+		BasicBlock* endBlock = endBlocks[i];
+		BasicBlock* lhsBlock = ctx.mBlock;
+		
+		// Add the branch to the end of the LHS
+		{
+			IRBuilder<> build(ctx.mBlock);
+			// We can assume it WILL be an i32 here
+			// since it'd have been zero-extended otherwise
+			lhsVal = build.CreateICmpNE(lhsVal, ctx.mZero, "tobool");
+			build.CreateCondBr(lhsVal, endBlock, rhsBlock);
+		}
+		
+		// rhsBlock should now be sealed
+		ctx.mSSA.sealBlock(rhsBlock);
+		
+		// Code should now be generated in the RHS block
+		ctx.mBlock = rhsBlock;
+		Value* rhsVal = chain[i]->mRHS->emitIR(ctx);
+		
+		// This is the final RHS block (for the phi node)
+		rhsBlock = ctx.mBlock;
+		
+		// Add the branch and the end of the RHS
+		{
+			IRBuilder<> build(ctx.mBlock);
+			rhsVal = build.CreateICmpNE(rhsVal, ctx.mZero, "tobool");
+			
+			// We do an unconditional branch because the phi mode will handle
+			// the correct value
+			build.CreateBr(endBlock);
+		}
+		
+		// endBlock should now be sealed
+		ctx.mSSA.sealBlock(endBlock);
+		
+		ctx.mBlock = endBlock;
+		
+		IRBuilder<> build(ctx.mBlock);
+		
+		// Figure out the value to zext
+		Value* zextVal = nullptr;
+		
+		// If rhs is not also true, we need to make a phi
+		if (rhsVal != ConstantInt::getTrue(ctx.mGlobal))
+		{
+			PHINode* phi = build.CreatePHI(llvm::Type::getInt1Ty(ctx.mGlobal), 2);
+			// If we came from the lhs, it had to be false
+			phi->addIncoming(ConstantInt::getTrue(ctx.mGlobal), lhsBlock);
+			phi->addIncoming(rhsVal, rhsBlock);
+			zextVal = phi;
+		}
+		else
+		{
+			zextVal = ConstantInt::getTrue(ctx.mGlobal);
+		}
+		
+		lhsVal = build.CreateZExt(zextVal, llvm::Type::getInt32Ty(ctx.mGlobal));
 	}
 	
-	return build.CreateZExt(zextVal, llvm::Type::getInt32Ty(ctx.mGlobal));
+	return lhsVal;
 }
 
 AST_EMIT(ASTBinaryCmpOp)
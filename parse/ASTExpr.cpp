@@ -14,7 +14,9 @@
 
 #include "ASTNodes.h"
 #include "Symbols.h"
-#include <sstream>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
 
 using namespace uscc::parse;
 
@@ -69,7 +71,7 @@ bool ASTBinaryMathOp::finalizeOp() noexcept
 	return retVal;
 }
 
-ASTConstantExpr::ASTConstantExpr(const std::string& constStr)
+ASTConstantExpr::ASTConstantExpr(llvm::StringRef constStr)
 {
 	// ConstExpr is always evaluated as a 32-bit integer
 	// it can later be converted to a char at assignment
@@ -93,42 +95,61 @@ ASTConstantExpr::ASTConstantExpr(const std::string& constStr)
 	}
 	else
 	{
-		// NOTE: This WILL throw if the value is out of bounds
-		std::istringstream ss(constStr);
-		ss >> mValue;
-		if (ss.fail())
+		// The scanner only lets through an optional minus sign
+		// followed by digits, so just accumulate them
+		bool negative = (constStr[0] == '-');
+		int64_t value = 0;
+		for (size_t i = negative ? 1 : 0; i < constStr.size(); i++)
 		{
-			throw std::invalid_argument(constStr);
+			value = value * 10 + (constStr[i] - '0');
+			
+			// NOTE: This WILL throw if the value is out of bounds
+			if (value > static_cast<int64_t>(INT_MAX) + 1)
+			{
+				throw std::invalid_argument(constStr.str());
+			}
 		}
+		
+		if (negative)
+		{
+			value = -value;
+		}
+		if (value > INT_MAX)
+		{
+			throw std::invalid_argument(constStr.str());
+		}
+		mValue = static_cast<int>(value);
 	}
 }
 
-ASTStringExpr::ASTStringExpr(const std::string& str, StringTable& tbl)
+ASTStringExpr::ASTStringExpr(llvm::StringRef str, StringTable& tbl)
 {
 	// This function can only be called if this is a valid string
-	std::string actStr = str.substr(1, str.length() - 2);
+	llvm::StringRef text = str.substr(1, str.size() - 2);
 	mType = Type::CharArray;
 	
-	// Replace valid escape sequences
-	size_t pos = actStr.find("\\n");
-	while (pos != std::string::npos)
-	{
-		actStr.replace(pos, 2, "\n");
-		pos = actStr.find("\\n");
-	}
-	
-	pos = actStr.find("\\t");
-	while (pos != std::string::npos)
+	// Replace valid escape sequences (\n and \t are the only
+	// ones the scanner allows)
+	std::string actStr;
+	actStr.reserve(text.size());
+	for (size_t i = 0; i < text.size(); i++)
 	{
-		actStr.replace(pos, 2, "\t");
-		pos = actStr.find("\\t");
+		if (text[i] == '\\' && i + 1 < text.size() && (text[i + 1] == 'n' || text[i + 1] == 't'))
+		{
+			actStr += (text[i + 1] == 'n') ? '\n' : '\t';
+			i++;
+		}
+		else
+		{
+			actStr += text[i];
+		}
 	}
 	
 	// Now grab this from the StringTable
 	mString = tbl.getString(actStr);
 }
 
-void ASTFuncExpr::addArg(std::shared_ptr<ASTExpr> arg) noexcept
+void ASTFuncExpr::addArg(ASTArena& arena, ASTExpr* arg) noexcept
 {
-	mArgs.push_back(arg);
+	mArgs.push_back(arena, arg);
 }
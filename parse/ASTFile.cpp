@@ -0,0 +1,892 @@
+//
+//  ASTFile.cpp
+//  uscc
+//
+//  Implements the writeNode function for every AST node,
+//  and the classes that write and read AST files.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "ASTFile.h"
+#include "ASTNodes.h"
+#include "Parse.h"
+#include <cstring>
+
+using namespace uscc::parse;
+
+namespace
+{
+
+const char sMagic[8] = { 'U', 'S', 'C', 'C', 'A', 'S', 'T', '\0' };
+
+// Sections start at a multiple of this, so their records are aligned
+const size_t sAlignment = 8;
+
+// Returns the node at index, which has to be written before limit,
+// as a T. (nullptr if index is ASTFileNone and the node is optional.)
+template <typename T>
+T* getNode(const std::vector<ASTNode*>& nodes, uint32_t index, uint32_t limit,
+		   bool optional = false)
+{
+	if (index == ASTFileNone && optional)
+	{
+		return nullptr;
+	}
+
+	T* node = nullptr;
+	if (index < limit)
+	{
+		node = dynamic_cast<T*>(nodes[index]);
+	}
+	if (!node)
+	{
+		throw BadASTFile("AST file has a node with a bad child");
+	}
+	return node;
+}
+
+} // anonymous
+
+#define AST_WRITE(a) uint32_t a::writeNode(ASTWriter& writer) const
+
+AST_WRITE(ASTProgram)
+{
+	for (auto func : mFuncs)
+	{
+		writer.addChild(func);
+	}
+	// The functions are the program
+	return ASTFileNone;
+}
+
+AST_WRITE(ASTFunction)
+{
+	std::vector<uint32_t> args;
+	for (auto arg : mArgs)
+	{
+		args.push_back(writer.addChild(arg));
+	}
+
+	std::vector<uint32_t> callees;
+	for (auto callee : mCallees)
+	{
+		callees.push_back(writer.getIdent(*callee));
+	}
+
+	ASTFileFunction func;
+	func.mIdent = writer.getIdent(mIdent);
+	func.mReturnType = static_cast<uint32_t>(mReturnType);
+	func.mScope = writer.getScope(mScopeTable);
+	func.mBody = writer.addChild(mBody);
+	func.mFirstArg = writer.addRefs(args);
+	func.mNumArgs = static_cast<uint32_t>(args.size());
+	func.mFirstCallee = writer.addRefs(callees);
+	func.mNumCallees = static_cast<uint32_t>(callees.size());
+	return writer.addFunction(func);
+}
+
+AST_WRITE(ASTArgDecl)
+{
+	return writer.addNode(ASTFileKind::ArgDecl, Type::Void, 0, writer.getIdent(mIdent));
+}
+
+AST_WRITE(ASTArraySub)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	return writer.addNode(ASTFileKind::ArraySub, Type::Void, 0, writer.getIdent(mIdent), expr);
+}
+
+AST_WRITE(ASTBadExpr)
+{
+	return writer.addNode(ASTFileKind::BadExpr, mType);
+}
+
+AST_WRITE(ASTLogicalAnd)
+{
+	uint32_t lhs = writer.addChild(mLHS);
+	uint32_t rhs = writer.addChild(mRHS);
+	return writer.addNode(ASTFileKind::LogicalAnd, mType, 0, lhs, rhs);
+}
+
+AST_WRITE(ASTLogicalOr)
+{
+	uint32_t lhs = writer.addChild(mLHS);
+	uint32_t rhs = writer.addChild(mRHS);
+	return writer.addNode(ASTFileKind::LogicalOr, mType, 0, lhs, rhs);
+}
+
+AST_WRITE(ASTBinaryCmpOp)
+{
+	uint32_t lhs = writer.addChild(mLHS);
+	uint32_t rhs = writer.addChild(mRHS);
+	return writer.addNode(ASTFileKind::BinaryCmpOp, mType, mOp, lhs, rhs);
+}
+
+AST_WRITE(ASTBinaryMathOp)
+{
+	uint32_t lhs = writer.addChild(mLHS);
+	uint32_t rhs = writer.addChild(mRHS);
+	return writer.addNode(ASTFileKind::BinaryMathOp, mType, mOp, lhs, rhs);
+}
+
+AST_WRITE(ASTNotExpr)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	return writer.addNode(ASTFileKind::NotExpr, mType, 0, expr);
+}
+
+AST_WRITE(ASTConstantExpr)
+{
+	return writer.addNode(ASTFileKind::ConstantExpr, mType, 0, static_cast<uint32_t>(mValue));
+}
+
+AST_WRITE(ASTStringExpr)
+{
+	return writer.addNode(ASTFileKind::StringExpr, mType, 0, writer.getString(*mString));
+}
+
+AST_WRITE(ASTIdentExpr)
+{
+	return writer.addNode(ASTFileKind::IdentExpr, mType, 0, writer.getIdent(mIdent));
+}
+
+AST_WRITE(ASTArrayExpr)
+{
+	uint32_t array = writer.addChild(mArray);
+	return writer.addNode(ASTFileKind::ArrayExpr, mType, 0, array);
+}
+
+AST_WRITE(ASTFuncExpr)
+{
+	std::vector<uint32_t> args;
+	for (auto arg : mArgs)
+	{
+		args.push_back(writer.addChild(arg));
+	}
+
+	return writer.addNode(ASTFileKind::FuncExpr, mType, 0, writer.getIdent(mIdent),
+						  writer.addRefs(args), static_cast<uint32_t>(args.size()));
+}
+
+AST_WRITE(ASTIncExpr)
+{
+	return writer.addNode(ASTFileKind::IncExpr, mType, 0, writer.getIdent(mIdent));
+}
+
+AST_WRITE(ASTDecExpr)
+{
+	return writer.addNode(ASTFileKind::DecExpr, mType, 0, writer.getIdent(mIdent));
+}
+
+AST_WRITE(ASTAddrOfArray)
+{
+	uint32_t array = writer.addChild(mArray);
+	return writer.addNode(ASTFileKind::AddrOfArray, mType, 0, array);
+}
+
+AST_WRITE(ASTToIntExpr)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	return writer.addNode(ASTFileKind::ToIntExpr, mType, 0, expr);
+}
+
+AST_WRITE(ASTToCharExpr)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	return writer.addNode(ASTFileKind::ToCharExpr, mType, 0, expr);
+}
+
+AST_WRITE(ASTDecl)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	return writer.addNode(ASTFileKind::Decl, Type::Void, 0, writer.getIdent(mIdent), expr);
+}
+
+AST_WRITE(ASTCompoundStmt)
+{
+	// The declarations, and then the statements
+	std::vector<uint32_t> children;
+	for (auto decl : mDecls)
+	{
+		children.push_back(writer.addChild(decl));
+	}
+	for (auto stmt : mStmts)
+	{
+		children.push_back(writer.addChild(stmt));
+	}
+
+	return writer.addNode(ASTFileKind::CompoundStmt, Type::Void, 0, writer.addRefs(children),
+						  static_cast<uint32_t>(mDecls.size()),
+						  static_cast<uint32_t>(mStmts.size()));
+}
+
+AST_WRITE(ASTAssignStmt)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	return writer.addNode(ASTFileKind::AssignStmt, Type::Void, 0, writer.getIdent(mIdent), expr);
+}
+
+AST_WRITE(ASTAssignArrayStmt)
+{
+	uint32_t array = writer.addChild(mArray);
+	uint32_t expr = writer.addChild(mExpr);
+	return writer.addNode(ASTFileKind::AssignArrayStmt, Type::Void, 0, array, expr);
+}
+
+AST_WRITE(ASTIfStmt)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	uint32_t thenStmt = writer.addChild(mThenStmt);
+	uint32_t elseStmt = writer.addChild(mElseStmt);
+	return writer.addNode(ASTFileKind::IfStmt, Type::Void, 0, expr, thenStmt, elseStmt);
+}
+
+AST_WRITE(ASTWhileStmt)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	uint32_t loopStmt = writer.addChild(mLoopStmt);
+	return writer.addNode(ASTFileKind::WhileStmt, Type::Void, 0, expr, loopStmt);
+}
+
+AST_WRITE(ASTReturnStmt)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	return writer.addNode(ASTFileKind::ReturnStmt, Type::Void, 0, expr);
+}
+
+AST_WRITE(ASTExprStmt)
+{
+	uint32_t expr = writer.addChild(mExpr);
+	return writer.addNode(ASTFileKind::ExprStmt, Type::Void, 0, expr);
+}
+
+AST_WRITE(ASTNullStmt)
+{
+	return writer.addNode(ASTFileKind::NullStmt);
+}
+
+ASTWriter::ASTWriter(Parser& parser)
+: mNextChild(0)
+, mComplete(true)
+{
+	std::memset(&mHeader, 0, sizeof(mHeader));
+	std::memcpy(mHeader.mMagic, sMagic, sizeof(sMagic));
+	mHeader.mVersion = ASTFileVersion;
+	mHeader.mNeedPrintf = parser.mNeedPrintf ? 1 : 0;
+
+	// The strings keep the order they were added in,
+	// since that's the order they're emitted in
+	for (auto str : parser.mStrings.getStrings())
+	{
+		mStringIndices.emplace(str->getText(), static_cast<uint32_t>(mStrings.size()));
+		mStrings.push_back(addText(str->getText()));
+	}
+
+	// Number the functions first, so the identifiers can say
+	// which one they name
+	if (parser.mRoot)
+	{
+		for (auto func : parser.mRoot->getFunctions())
+		{
+			mFunctionIndices.emplace(func, static_cast<uint32_t>(mFunctionIndices.size()));
+		}
+	}
+
+	addScope(*parser.mSymbols.getCurrScope(), ASTFileNone);
+
+	if (parser.mRoot)
+	{
+		walkAST(*parser.mRoot, *this);
+	}
+}
+
+// Writes the header and each section
+bool ASTWriter::write(std::ostream& output) const
+{
+	if (!mComplete)
+	{
+		return false;
+	}
+
+	ASTFileHeader header = mHeader;
+	size_t offset = sizeof(header);
+	auto place = [&offset](ASTFileSection& section, size_t count, size_t size)
+	{
+		offset = (offset + sAlignment - 1) & ~(sAlignment - 1);
+		section.mOffset = static_cast<uint32_t>(offset);
+		section.mCount = static_cast<uint32_t>(count);
+		offset += count * size;
+	};
+	place(header.mText, mText.size(), sizeof(char));
+	place(header.mStrings, mStrings.size(), sizeof(ASTFileString));
+	place(header.mScopes, mScopes.size(), sizeof(ASTFileScope));
+	place(header.mIdents, mIdents.size(), sizeof(ASTFileIdent));
+	place(header.mFunctions, mFunctions.size(), sizeof(ASTFileFunction));
+	place(header.mNodes, mNodes.size(), sizeof(ASTFileNode));
+	place(header.mRefs, mRefs.size(), sizeof(uint32_t));
+	if (offset > 0xffffffff)
+	{
+		return false;
+	}
+
+	size_t written = 0;
+	auto writeSection = [&output, &written](const ASTFileSection& section,
+											const void* data, size_t size)
+	{
+		static const char padding[sAlignment] = { 0 };
+		output.write(padding, static_cast<std::streamsize>(section.mOffset - written));
+		output.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		written = section.mOffset + size;
+	};
+	output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	written = sizeof(header);
+	writeSection(header.mText, mText.data(), mText.size());
+	writeSection(header.mStrings, mStrings.data(), mStrings.size() * sizeof(ASTFileString));
+	writeSection(header.mScopes, mScopes.data(), mScopes.size() * sizeof(ASTFileScope));
+	writeSection(header.mIdents, mIdents.data(), mIdents.size() * sizeof(ASTFileIdent));
+	writeSection(header.mFunctions, mFunctions.data(),
+				 mFunctions.size() * sizeof(ASTFileFunction));
+	writeSection(header.mNodes, mNodes.data(), mNodes.size() * sizeof(ASTFileNode));
+	writeSection(header.mRefs, mRefs.data(), mRefs.size() * sizeof(uint32_t));
+
+	return output.good();
+}
+
+uint32_t ASTWriter::addNode(ASTFileKind kind, Type type, uint32_t op,
+							uint32_t a, uint32_t b, uint32_t c)
+{
+	ASTFileNode node;
+	node.mKind = kind;
+	node.mType = static_cast<uint8_t>(type);
+	node.mOp = static_cast<uint16_t>(op);
+	node.mA = a;
+	node.mB = b;
+	node.mC = c;
+	mNodes.push_back(node);
+	return static_cast<uint32_t>(mNodes.size() - 1);
+}
+
+uint32_t ASTWriter::addChild(const ASTNode* node)
+{
+	if (!node)
+	{
+		return ASTFileNone;
+	}
+
+	if (mNextChild >= mWritten.size() || mWritten[mNextChild].first != node)
+	{
+		// Not the next child the walk wrote
+		mComplete = false;
+		return ASTFileNone;
+	}
+	return mWritten[mNextChild++].second;
+}
+
+void ASTWriter::leave(const ASTNode& node, int depth)
+{
+	// The children are the last nodes written
+	size_t numChildren = 0;
+	for (size_t i = 0; i < node.getNumChildren(); i++)
+	{
+		if (node.getChild(i))
+		{
+			numChildren++;
+		}
+	}
+
+	size_t first = mWritten.size() - numChildren;
+	mNextChild = first;
+	uint32_t index = node.writeNode(*this);
+	mWritten.resize(first);
+	mWritten.emplace_back(&node, index);
+}
+
+uint32_t ASTWriter::addRefs(const std::vector<uint32_t>& refs)
+{
+	uint32_t first = static_cast<uint32_t>(mRefs.size());
+	mRefs.insert(mRefs.end(), refs.begin(), refs.end());
+	return first;
+}
+
+uint32_t ASTWriter::addFunction(const ASTFileFunction& func)
+{
+	mFunctions.push_back(func);
+	return static_cast<uint32_t>(mFunctions.size() - 1);
+}
+
+uint32_t ASTWriter::getIdent(const Identifier& ident)
+{
+	auto iter = mIdentIndices.find(&ident);
+	if (iter == mIdentIndices.end() && ident.getAlias())
+	{
+		// A function a group of parseInParallel called from another group
+		iter = mIdentIndices.find(ident.getAlias());
+	}
+
+	if (iter == mIdentIndices.end())
+	{
+		// Not in the symbol table (such as a function of another
+		// file of a whole-program compile)
+		mComplete = false;
+		return ASTFileNone;
+	}
+	return iter->second;
+}
+
+uint32_t ASTWriter::getScope(const SymbolTable::ScopeTable& scope)
+{
+	auto iter = mScopeIndices.find(&scope);
+	if (iter == mScopeIndices.end())
+	{
+		mComplete = false;
+		return ASTFileNone;
+	}
+	return iter->second;
+}
+
+uint32_t ASTWriter::getString(const ConstStr& str)
+{
+	auto iter = mStringIndices.find(str.getText());
+	if (iter == mStringIndices.end())
+	{
+		mComplete = false;
+		return ASTFileNone;
+	}
+	return iter->second;
+}
+
+// Adds scope, and then the scopes under it
+void ASTWriter::addScope(const SymbolTable::ScopeTable& scope, uint32_t parent)
+{
+	uint32_t index = static_cast<uint32_t>(mScopes.size());
+	mScopeIndices.emplace(&scope, index);
+
+	ASTFileScope record;
+	record.mParent = parent;
+	record.mFirstIdent = static_cast<uint32_t>(mIdents.size());
+	record.mNumIdents = static_cast<uint32_t>(scope.getIdentifiers().size());
+	mScopes.push_back(record);
+
+	for (auto ident : scope.getIdentifiers())
+	{
+		mIdentIndices.emplace(ident, static_cast<uint32_t>(mIdents.size()));
+
+		ASTFileIdent identRecord;
+		identRecord.mName = addText(ident->getName());
+		identRecord.mType = static_cast<uint32_t>(ident->getType());
+		identRecord.mArrayCount = (ident->getArrayCount() == static_cast<size_t>(-1)) ?
+			ASTFileNone : static_cast<uint32_t>(ident->getArrayCount());
+		identRecord.mFunction = ASTFileNone;
+		auto func = mFunctionIndices.find(ident->getFunction());
+		if (func != mFunctionIndices.end())
+		{
+			identRecord.mFunction = func->second;
+		}
+		mIdents.push_back(identRecord);
+	}
+
+	for (auto child : scope.getChildren())
+	{
+		addScope(*child, index);
+	}
+}
+
+ASTFileString ASTWriter::addText(const std::string& text)
+{
+	ASTFileString record;
+	record.mOffset = static_cast<uint32_t>(mText.size());
+	record.mLength = static_cast<uint32_t>(text.size());
+	mText += text;
+	return record;
+}
+
+ASTReader::ASTReader(const char* fileName) noexcept
+: mFileName(fileName)
+, mFile(fileName)
+, mHeader(nullptr)
+{
+	if (mFile.isMapped() && mFile.getSize() >= sizeof(ASTFileHeader))
+	{
+		mHeader = reinterpret_cast<const ASTFileHeader*>(mFile.getData());
+	}
+}
+
+bool ASTReader::isASTFile() const noexcept
+{
+	return mHeader && isASTData(mFile.getData(), mFile.getSize());
+}
+
+bool ASTReader::isASTData(const char* data, size_t size) noexcept
+{
+	return size >= sizeof(ASTFileHeader) && std::memcmp(data, sMagic, sizeof(sMagic)) == 0;
+}
+
+// Rebuilds the AST and symbols in parser
+void ASTReader::read(Parser& parser)
+{
+	if (!isASTFile())
+	{
+		throw BadASTFile("Not an AST file");
+	}
+	if (mHeader->mVersion != ASTFileVersion)
+	{
+		throw BadASTFile("AST file is from a different version of uscc");
+	}
+
+	const char* text = getSection<char>(mHeader->mText);
+	const ASTFileString* strings = getSection<ASTFileString>(mHeader->mStrings);
+	const ASTFileScope* scopes = getSection<ASTFileScope>(mHeader->mScopes);
+	const ASTFileIdent* idents = getSection<ASTFileIdent>(mHeader->mIdents);
+	const ASTFileFunction* functions = getSection<ASTFileFunction>(mHeader->mFunctions);
+	const ASTFileNode* nodes = getSection<ASTFileNode>(mHeader->mNodes);
+	const uint32_t* refs = getSection<uint32_t>(mHeader->mRefs);
+
+	auto getText = [this, text](const ASTFileString& str) -> llvm::StringRef
+	{
+		size_t count = mHeader->mText.mCount;
+		if (str.mLength > count - check(str.mOffset, count + 1))
+		{
+			throw BadASTFile("AST file has a name past the end of the text");
+		}
+		return llvm::StringRef(text + str.mOffset, str.mLength);
+	};
+	auto getType = [](uint32_t type) -> Type
+	{
+		if (type > static_cast<uint32_t>(Type::Function))
+		{
+			throw BadASTFile("AST file has a bad type");
+		}
+		return static_cast<Type>(type);
+	};
+	// Checks that an operator is one the parser makes the node for
+	auto getOp = [](uint32_t op, bool isCmp) -> scan::Token::Tokens
+	{
+		auto token = static_cast<scan::Token::Tokens>(op);
+		bool valid = isCmp ?
+			(token == scan::Token::EqualTo || token == scan::Token::NotEqual ||
+			 token == scan::Token::LessThan || token == scan::Token::GreaterThan) :
+			(token == scan::Token::Plus || token == scan::Token::Minus ||
+			 token == scan::Token::Mult || token == scan::Token::Div ||
+			 token == scan::Token::Mod);
+		if (!valid)
+		{
+			throw BadASTFile("AST file has a bad operator");
+		}
+		return token;
+	};
+	// Checks that a list is in mRefs
+	auto getRefs = [this, refs](uint32_t first, uint32_t count) -> const uint32_t*
+	{
+		size_t numRefs = mHeader->mRefs.mCount;
+		if (count > numRefs - check(first, numRefs + 1))
+		{
+			throw BadASTFile("AST file has a list past the end of the references");
+		}
+		return refs + first;
+	};
+
+	// Add the strings in the same order as the parse did
+	std::vector<ConstStr*> constStrs;
+	for (uint32_t i = 0; i < mHeader->mStrings.mCount; i++)
+	{
+		constStrs.push_back(parser.mStrings.getString(getText(strings[i]).str()));
+	}
+
+	// Rebuild the scopes, entering each one from its parent
+	SymbolTable& symbols = parser.mSymbols;
+	std::vector<SymbolTable::ScopeTable*> scopeTables;
+	std::vector<Identifier*> identifiers;
+	std::vector<uint32_t> entered;
+	for (uint32_t i = 0; i < mHeader->mScopes.mCount; i++)
+	{
+		const ASTFileScope& scope = scopes[i];
+		if (i == 0)
+		{
+			if (scope.mParent != ASTFileNone)
+			{
+				throw BadASTFile("AST file doesn't start with the global scope");
+			}
+			scopeTables.push_back(symbols.getCurrScope());
+		}
+		else
+		{
+			// Exit the scopes until we're in the parent
+			while (!entered.empty() && entered.back() != scope.mParent)
+			{
+				entered.pop_back();
+				if (!entered.empty())
+				{
+					symbols.exitScope();
+				}
+			}
+			if (entered.empty())
+			{
+				throw BadASTFile("AST file has a scope before its parent");
+			}
+			scopeTables.push_back(symbols.enterScope());
+		}
+		entered.push_back(i);
+
+		if (scope.mFirstIdent != identifiers.size() ||
+			scope.mNumIdents > mHeader->mIdents.mCount - identifiers.size())
+		{
+			throw BadASTFile("AST file has identifiers out of order");
+		}
+		for (uint32_t j = 0; j < scope.mNumIdents; j++)
+		{
+			const ASTFileIdent& record = idents[scope.mFirstIdent + j];
+			llvm::StringRef name = getText(record.mName);
+			Identifier* ident = symbols.createIdentifier(name);
+			if (!ident)
+			{
+				// The global scope starts with the built in identifiers
+				ident = symbols.getIdentifier(name);
+				if (i != 0 || (!ident->isDummy() && name != "printf"))
+				{
+					throw BadASTFile("AST file declares an identifier twice");
+				}
+			}
+			ident->setType(getType(record.mType));
+			ident->setArrayCount((record.mArrayCount == ASTFileNone) ?
+								 static_cast<size_t>(-1) : record.mArrayCount);
+			identifiers.push_back(ident);
+		}
+	}
+	while (entered.size() > 1)
+	{
+		entered.pop_back();
+		symbols.exitScope();
+	}
+	if (identifiers.size() != mHeader->mIdents.mCount)
+	{
+		throw BadASTFile("AST file has identifiers that aren't in a scope");
+	}
+
+	// Make the functions before the nodes, since a call's type is
+	// the return type of the function
+	ASTArena& arena = parser.mArena;
+	std::vector<ASTFunction*> funcs;
+	for (uint32_t i = 0; i < mHeader->mFunctions.mCount; i++)
+	{
+		const ASTFileFunction& record = functions[i];
+		Identifier* ident = identifiers[check(record.mIdent, identifiers.size())];
+		SymbolTable::ScopeTable* scope = scopeTables[check(record.mScope, scopeTables.size())];
+		funcs.push_back(arena.make<ASTFunction>(*ident, getType(record.mReturnType), *scope));
+	}
+	for (uint32_t i = 0; i < mHeader->mIdents.mCount; i++)
+	{
+		if (idents[i].mFunction != ASTFileNone)
+		{
+			identifiers[i]->setFunction(funcs[check(idents[i].mFunction, funcs.size())]);
+		}
+	}
+
+	// Each node's children come before it
+	std::vector<ASTNode*> astNodes(mHeader->mNodes.mCount);
+	for (uint32_t i = 0; i < mHeader->mNodes.mCount; i++)
+	{
+		const ASTFileNode& record = nodes[i];
+		auto ident = [&identifiers](uint32_t index) -> Identifier&
+		{
+			return *identifiers[check(index, identifiers.size())];
+		};
+
+		ASTNode* node = nullptr;
+		switch (record.mKind)
+		{
+			case ASTFileKind::ArgDecl:
+				node = arena.make<ASTArgDecl>(ident(record.mA));
+				break;
+			case ASTFileKind::ArraySub:
+				node = arena.make<ASTArraySub>(ident(record.mA),
+											   getNode<ASTExpr>(astNodes, record.mB, i));
+				break;
+			case ASTFileKind::BadExpr:
+				node = arena.make<ASTBadExpr>();
+				break;
+			case ASTFileKind::LogicalAnd:
+			{
+				ASTLogicalAnd* op = arena.make<ASTLogicalAnd>();
+				op->setLHS(getNode<ASTExpr>(astNodes, record.mA, i));
+				op->setRHS(getNode<ASTExpr>(astNodes, record.mB, i));
+				op->finalizeOp();
+				node = op;
+				break;
+			}
+			case ASTFileKind::LogicalOr:
+			{
+				ASTLogicalOr* op = arena.make<ASTLogicalOr>();
+				op->setLHS(getNode<ASTExpr>(astNodes, record.mA, i));
+				op->setRHS(getNode<ASTExpr>(astNodes, record.mB, i));
+				op->finalizeOp();
+				node = op;
+				break;
+			}
+			case ASTFileKind::BinaryCmpOp:
+			{
+				ASTBinaryCmpOp* op = arena.make<ASTBinaryCmpOp>(getOp(record.mOp, true));
+				op->setLHS(getNode<ASTExpr>(astNodes, record.mA, i));
+				op->setRHS(getNode<ASTExpr>(astNodes, record.mB, i));
+				op->finalizeOp();
+				node = op;
+				break;
+			}
+			case ASTFileKind::BinaryMathOp:
+			{
+				ASTBinaryMathOp* op = arena.make<ASTBinaryMathOp>(getOp(record.mOp, false));
+				op->setLHS(getNode<ASTExpr>(astNodes, record.mA, i));
+				op->setRHS(getNode<ASTExpr>(astNodes, record.mB, i));
+				op->finalizeOp();
+				node = op;
+				break;
+			}
+			case ASTFileKind::NotExpr:
+				node = arena.make<ASTNotExpr>(getNode<ASTExpr>(astNodes, record.mA, i));
+				break;
+			case ASTFileKind::ConstantExpr:
+				node = arena.make<ASTConstantExpr>(static_cast<int>(record.mA),
+												   getType(record.mType));
+				break;
+			case ASTFileKind::StringExpr:
+				node = arena.make<ASTStringExpr>(*constStrs[check(record.mA, constStrs.size())]);
+				break;
+			case ASTFileKind::IdentExpr:
+				node = arena.make<ASTIdentExpr>(ident(record.mA));
+				break;
+			case ASTFileKind::ArrayExpr:
+				node = arena.make<ASTArrayExpr>(getNode<ASTArraySub>(astNodes, record.mA, i));
+				break;
+			case ASTFileKind::FuncExpr:
+			{
+				ASTFuncExpr* call = arena.make<ASTFuncExpr>(ident(record.mA));
+				const uint32_t* args = getRefs(record.mB, record.mC);
+				for (uint32_t j = 0; j < record.mC; j++)
+				{
+					call->addArg(arena, getNode<ASTExpr>(astNodes, args[j], i));
+				}
+				node = call;
+				break;
+			}
+			case ASTFileKind::IncExpr:
+				node = arena.make<ASTIncExpr>(ident(record.mA));
+				break;
+			case ASTFileKind::DecExpr:
+				node = arena.make<ASTDecExpr>(ident(record.mA));
+				break;
+			case ASTFileKind::AddrOfArray:
+				node = arena.make<ASTAddrOfArray>(getNode<ASTArraySub>(astNodes, record.mA, i));
+				break;
+			case ASTFileKind::ToIntExpr:
+				node = arena.make<ASTToIntExpr>(getNode<ASTExpr>(astNodes, record.mA, i));
+				break;
+			case ASTFileKind::ToCharExpr:
+				node = arena.make<ASTToCharExpr>(getNode<ASTExpr>(astNodes, record.mA, i));
+				break;
+			case ASTFileKind::Decl:
+				node = arena.make<ASTDecl>(ident(record.mA),
+										   getNode<ASTExpr>(astNodes, record.mB, i, true));
+				break;
+			case ASTFileKind::CompoundStmt:
+			{
+				ASTCompoundStmt* stmt = arena.make<ASTCompoundStmt>();
+				if (record.mB > ASTFileNone - record.mC)
+				{
+					throw BadASTFile("AST file has too many statements in a block");
+				}
+				const uint32_t* children = getRefs(record.mA, record.mB + record.mC);
+				for (uint32_t j = 0; j < record.mB; j++)
+				{
+					stmt->addDecl(arena, getNode<ASTDecl>(astNodes, children[j], i));
+				}
+				for (uint32_t j = 0; j < record.mC; j++)
+				{
+					stmt->addStmt(arena, getNode<ASTStmt>(astNodes, children[record.mB + j], i));
+				}
+				node = stmt;
+				break;
+			}
+			case ASTFileKind::AssignStmt:
+				node = arena.make<ASTAssignStmt>(ident(record.mA),
+												 getNode<ASTExpr>(astNodes, record.mB, i));
+				break;
+			case ASTFileKind::AssignArrayStmt:
+				node = arena.make<ASTAssignArrayStmt>(getNode<ASTArraySub>(astNodes, record.mA, i),
+													  getNode<ASTExpr>(astNodes, record.mB, i));
+				break;
+			case ASTFileKind::IfStmt:
+				node = arena.make<ASTIfStmt>(getNode<ASTExpr>(astNodes, record.mA, i),
+											 getNode<ASTStmt>(astNodes, record.mB, i),
+											 getNode<ASTStmt>(astNodes, record.mC, i, true));
+				break;
+			case ASTFileKind::WhileStmt:
+				node = arena.make<ASTWhileStmt>(getNode<ASTExpr>(astNodes, record.mA, i),
+												getNode<ASTStmt>(astNodes, record.mB, i));
+				break;
+			case ASTFileKind::ReturnStmt:
+				node = arena.make<ASTReturnStmt>(getNode<ASTExpr>(astNodes, record.mA, i, true));
+				break;
+			case ASTFileKind::ExprStmt:
+				node = arena.make<ASTExprStmt>(getNode<ASTExpr>(astNodes, record.mA, i));
+				break;
+			case ASTFileKind::NullStmt:
+				node = arena.make<ASTNullStmt>();
+				break;
+			default:
+				throw BadASTFile("AST file has a node of an unknown kind");
+		}
+		astNodes[i] = node;
+	}
+
+	// Now the functions can be filled in
+	ASTProgram* program = arena.make<ASTProgram>();
+	uint32_t numNodes = mHeader->mNodes.mCount;
+	for (uint32_t i = 0; i < mHeader->mFunctions.mCount; i++)
+	{
+		const ASTFileFunction& record = functions[i];
+		ASTFunction* func = funcs[i];
+		const uint32_t* args = getRefs(record.mFirstArg, record.mNumArgs);
+		for (uint32_t j = 0; j < record.mNumArgs; j++)
+		{
+			func->addArg(arena, getNode<ASTArgDecl>(astNodes, args[j], numNodes));
+		}
+		const uint32_t* callees = getRefs(record.mFirstCallee, record.mNumCallees);
+		for (uint32_t j = 0; j < record.mNumCallees; j++)
+		{
+			func->addCallee(arena, identifiers[check(callees[j], identifiers.size())]);
+		}
+		func->setBody(getNode<ASTCompoundStmt>(astNodes, record.mBody, numNodes));
+		program->addFunction(arena, func);
+	}
+
+	parser.mNeedPrintf = mHeader->mNeedPrintf != 0;
+	parser.mRoot = program;
+}
+
+// Returns the records of a section, after checking they're in the file
+template <typename T>
+const T* ASTReader::getSection(const ASTFileSection& section) const
+{
+	size_t size = mFile.getSize();
+	if (section.mOffset % alignof(T) != 0 || section.mOffset > size ||
+		section.mCount > (size - section.mOffset) / sizeof(T))
+	{
+		throw BadASTFile("AST file has a section past the end of the file");
+	}
+	return reinterpret_cast<const T*>(mFile.getData() + section.mOffset);
+}
+
+// Checks an index into a section of count records
+uint32_t ASTReader::check(uint32_t index, size_t count)
+{
+	if (index >= count)
+	{
+		throw BadASTFile("AST file has an index past the end of a section");
+	}
+	return index;
+}
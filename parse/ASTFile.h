@@ -0,0 +1,303 @@
+//
+//  ASTFile.h
+//  uscc
+//
+//  Declares the binary format --emit-ast saves a parsed
+//  program in, and the classes that write and read it.
+//
+//  The file is a header followed by sections of fixed size
+//  records, in the byte order of the machine that wrote it.
+//  Records refer to each other by their index in a section,
+//  never by pointer, so a file can be mapped and read in
+//  place. Nodes are written after their children, so they
+//  can be rebuilt in one pass from the start.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ASTWalk.h"
+#include "ParseExcept.h"
+#include "Symbols.h"
+#include "Types.h"
+#include "../scan/MappedFile.h"
+
+namespace uscc
+{
+namespace parse
+{
+
+class ASTNode;
+class ASTFunction;
+class ASTProgram;
+class Parser;
+
+// Bump this whenever the layout of the file changes
+const uint32_t ASTFileVersion = 1;
+
+// Index that means "none" (a null child, or an identifier
+// that isn't a function)
+const uint32_t ASTFileNone = 0xffffffff;
+
+// Where a section is in the file
+struct ASTFileSection
+{
+	// Offset from the start of the file
+	uint32_t mOffset;
+	// Number of records
+	uint32_t mCount;
+};
+
+struct ASTFileHeader
+{
+	// "USCCAST" and a null
+	char mMagic[8];
+	uint32_t mVersion;
+	// Set if the program calls printf
+	uint32_t mNeedPrintf;
+	// Bytes of the names and strings
+	ASTFileSection mText;
+	// ASTFileString records, in the order they were
+	// added to the string table
+	ASTFileSection mStrings;
+	// ASTFileScope records (the global scope first, and then
+	// every other scope before its children)
+	ASTFileSection mScopes;
+	// ASTFileIdent records, grouped by scope
+	ASTFileSection mIdents;
+	// ASTFileFunction records, in the order of the program
+	ASTFileSection mFunctions;
+	// ASTFileNode records
+	ASTFileSection mNodes;
+	// uint32_t indices, for the lists in the other records
+	ASTFileSection mRefs;
+};
+
+struct ASTFileString
+{
+	// Range of the text section
+	uint32_t mOffset;
+	uint32_t mLength;
+};
+
+struct ASTFileScope
+{
+	// Index of the enclosing scope (ASTFileNone for the global one)
+	uint32_t mParent;
+	// The identifiers of this scope, in the order they were declared
+	uint32_t mFirstIdent;
+	uint32_t mNumIdents;
+};
+
+struct ASTFileIdent
+{
+	ASTFileString mName;
+	uint32_t mType;
+	// ASTFileNone if it isn't set
+	uint32_t mArrayCount;
+	// Index of the function, if this names one
+	uint32_t mFunction;
+};
+
+struct ASTFileFunction
+{
+	uint32_t mIdent;
+	uint32_t mReturnType;
+	// The scope of the arguments
+	uint32_t mScope;
+	// Node of the compound statement
+	uint32_t mBody;
+	// Nodes of the ASTArgDecls, in mRefs
+	uint32_t mFirstArg;
+	uint32_t mNumArgs;
+	// Identifiers of the functions it calls, in mRefs
+	uint32_t mFirstCallee;
+	uint32_t mNumCallees;
+};
+
+// Kind of each ASTFileNode
+enum class ASTFileKind : uint8_t
+{
+	ArgDecl,
+	ArraySub,
+	BadExpr,
+	LogicalAnd,
+	LogicalOr,
+	BinaryCmpOp,
+	BinaryMathOp,
+	NotExpr,
+	ConstantExpr,
+	StringExpr,
+	IdentExpr,
+	ArrayExpr,
+	FuncExpr,
+	IncExpr,
+	DecExpr,
+	AddrOfArray,
+	ToIntExpr,
+	ToCharExpr,
+	Decl,
+	CompoundStmt,
+	AssignStmt,
+	AssignArrayStmt,
+	IfStmt,
+	WhileStmt,
+	ReturnStmt,
+	ExprStmt,
+	NullStmt
+};
+
+// A node. What the operands are depends on the kind:
+// an identifier, a node, a string, a constant, or a list
+// in mRefs (see the writeNode of each node).
+struct ASTFileNode
+{
+	ASTFileKind mKind;
+	// The type of an expression
+	uint8_t mType;
+	// The token of an operator
+	uint16_t mOp;
+	uint32_t mA;
+	uint32_t mB;
+	uint32_t mC;
+};
+
+// Thrown when a file isn't an AST this version of uscc wrote
+class BadASTFile : public virtual ParseExcept
+{
+public:
+	BadASTFile(const char* msg)
+	: mMsg(msg)
+	{ }
+
+	virtual const char* what() const noexcept override
+	{
+		return mMsg;
+	}
+
+private:
+	const char* mMsg;
+};
+
+// Saves the AST and symbols of a successful parse
+// (all of the functions have to be this file's, so a file
+// of a whole-program compile can't be saved)
+class ASTWriter : private ASTVisitor
+{
+public:
+	ASTWriter(Parser& parser);
+
+	// Writes the file. Returns false if the stream fails, or if the
+	// program refers to something that isn't in the parser's tables.
+	bool write(std::ostream& output) const;
+
+	// These are for the writeNode functions
+
+	// Adds a node, and returns its index
+	uint32_t addNode(ASTFileKind kind, Type type = Type::Void, uint32_t op = 0,
+					 uint32_t a = ASTFileNone, uint32_t b = ASTFileNone,
+					 uint32_t c = ASTFileNone);
+
+	// Returns the index of node, a child of the node being written
+	// (or ASTFileNone if it's null). The children are written first,
+	// so this has to be called for them in the order of getChild.
+	uint32_t addChild(const ASTNode* node);
+
+	// Adds a list to mRefs, and returns the index of the first
+	uint32_t addRefs(const std::vector<uint32_t>& refs);
+
+	// Adds the record of a function, and returns its index
+	uint32_t addFunction(const ASTFileFunction& func);
+
+	// Index of an identifier, scope or string of the parser
+	uint32_t getIdent(const Identifier& ident);
+	uint32_t getScope(const SymbolTable::ScopeTable& scope);
+	uint32_t getString(const ConstStr& str);
+
+private:
+	// Writes node, once its children are written
+	virtual void leave(const ASTNode& node, int depth) override;
+
+	// Adds scope, and then the scopes under it
+	void addScope(const SymbolTable::ScopeTable& scope, uint32_t parent);
+
+	ASTFileString addText(const std::string& text);
+
+	ASTFileHeader mHeader;
+	std::string mText;
+	std::vector<ASTFileString> mStrings;
+	std::vector<ASTFileScope> mScopes;
+	std::vector<ASTFileIdent> mIdents;
+	std::vector<ASTFileFunction> mFunctions;
+	std::vector<ASTFileNode> mNodes;
+	std::vector<uint32_t> mRefs;
+
+	// The nodes written whose parents haven't been yet, and their indices
+	std::vector<std::pair<const ASTNode*, uint32_t>> mWritten;
+	// The next child addChild returns, in mWritten
+	size_t mNextChild;
+
+	// False if something couldn't be found
+	bool mComplete;
+
+	std::unordered_map<const ASTFunction*, uint32_t> mFunctionIndices;
+	std::unordered_map<const SymbolTable::ScopeTable*, uint32_t> mScopeIndices;
+	std::unordered_map<const Identifier*, uint32_t> mIdentIndices;
+	std::unordered_map<std::string, uint32_t> mStringIndices;
+};
+
+// Maps a file that ASTWriter wrote (see Parser's constructor
+// that takes a reader)
+class ASTReader
+{
+public:
+	ASTReader(const char* fileName) noexcept;
+
+	// Returns true if the file could be mapped, and starts like
+	// an AST file (otherwise it should be parsed as source)
+	bool isASTFile() const noexcept;
+
+	// Returns true if the size bytes of data start like an AST file
+	static bool isASTData(const char* data, size_t size) noexcept;
+
+	const char* getFileName() const noexcept
+	{
+		return mFileName;
+	}
+
+	// Rebuilds the AST and symbols in parser
+	// Throws BadASTFile if the file isn't valid
+	void read(Parser& parser);
+
+private:
+	// Disallow copy/assignment
+	ASTReader(const ASTReader& copy);
+	ASTReader& operator=(const ASTReader& rhs);
+
+	// Returns the records of a section, after checking they're in the file
+	template <typename T>
+	const T* getSection(const ASTFileSection& section) const;
+
+	// Checks an index into a section of count records
+	static uint32_t check(uint32_t index, size_t count);
+
+	const char* mFileName;
+	scan::MappedFile mFile;
+	const ASTFileHeader* mHeader;
+};
+
+} // parse
+} // uscc
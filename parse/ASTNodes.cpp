@@ -14,19 +14,18 @@
 //---------------------------------------------------------
 
 #include "ASTNodes.h"
+#include <algorithm>
 
 using namespace uscc::parse;
-using std::shared_ptr;
-
-void ASTProgram::addFunction(shared_ptr<ASTFunction> func) noexcept
+void ASTProgram::addFunction(ASTArena& arena, ASTFunction* func) noexcept
 {
-	mFuncs.push_back(func);
+	mFuncs.push_back(arena, func);
 }
 
 // Add an argument to this function
-void ASTFunction::addArg(shared_ptr<ASTArgDecl> arg) noexcept
+void ASTFunction::addArg(ASTArena& arena, ASTArgDecl* arg) noexcept
 {
-	mArgs.push_back(arg);
+	mArgs.push_back(arena, arg);
 }
 
 // Returns true if the type passed in matches the argument
@@ -55,8 +54,51 @@ Type ASTFunction::getArgType(unsigned int argNum) const noexcept
 	}
 }
 
+// Records a function this one calls (duplicates are ignored)
+void ASTFunction::addCallee(ASTArena& arena, Identifier* callee) noexcept
+{
+	if (std::find(mCallees.begin(), mCallees.end(), callee) == mCallees.end())
+	{
+		mCallees.push_back(arena, callee);
+	}
+}
+
+// Writes the return and argument types, such as "int f(int, char[])"
+void ASTFunction::printSignature(std::ostream& output) const noexcept
+{
+	static const char* typeNames[] = { "void", "int", "char", "int[]", "char[]", "function" };
+	
+	output << typeNames[static_cast<int>(mReturnType)] << ' ' << mIdent.getName() << '(';
+	for (size_t i = 0; i < mArgs.size(); i++)
+	{
+		if (i != 0)
+		{
+			output << ", ";
+		}
+		output << typeNames[static_cast<int>(mArgs[i]->getType())];
+	}
+	output << ')';
+}
+
+// Writes everything the IR of this function depends on
+void ASTFunction::printStructure(std::ostream& output) const noexcept
+{
+	printNode(output);
+	
+	for (auto callee : mCallees)
+	{
+		// printf isn't a USC function, so its signature never changes
+		if (auto func = callee->getFunction())
+		{
+			output << "Calls: ";
+			func->printSignature(output);
+			output << std::endl;
+		}
+	}
+}
+
 // Set the compound statement body
-void ASTFunction::setBody(shared_ptr<ASTCompoundStmt> body) noexcept
+void ASTFunction::setBody(ASTCompoundStmt* body) noexcept
 {
 	mBody = body;
 }
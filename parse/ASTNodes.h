@@ -6,7 +6,13 @@
 //  by the parser.
 //
 //  Each AST node supports pretty-printing its node
-//  contents as well as generating the LLVM IR.
+//  contents as well as generating the LLVM IR. The
+//  children of a node are listed by getChild, so its
+//  tree can be walked without recursing (see ASTWalk.h).
+//
+//  Nodes are allocated from the parser's ASTArena, which
+//  owns them, so they point at each other with plain
+//  pointers and keep their children in ASTArrays.
 //
 //---------------------------------------------------------
 //  Copyright (c) 2014, Sanjay Madhav
@@ -18,24 +24,27 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <ostream>
 #include <string>
-#include <memory>
-#include <list>
-#include <vector>
-
+#include "ASTArena.h"
 #include "Types.h"
 #include "Symbols.h"
 #include "../scan/Tokens.h"
 
 // Macro so I don't have to copy/paste over and over
 #define AST_DECL_PRINT_EMIT() \
-virtual void printNode(std::ostream& output, int depth = 0) const noexcept override; \
-virtual llvm::Value* emitIR(CodeContext& ctx) noexcept override;
+virtual void printLine(std::ostream& output) const noexcept override; \
+virtual llvm::Value* emitIR(CodeContext& ctx) noexcept override; \
+virtual uint32_t writeNode(ASTWriter& writer) const override; \
+virtual size_t getNumChildren() const noexcept override; \
+virtual const ASTNode* getChild(size_t index) const noexcept override;
 
 namespace llvm
 {
 	class Value;
+	class Function;
 }
 
 namespace uscc
@@ -44,12 +53,23 @@ namespace parse
 {
 
 class CodeContext;
+class ASTWriter;
 	
 class ASTNode
 {
 public:
-	virtual void printNode(std::ostream& output, int depth = 0) const noexcept = 0;
+	// Prints this node and everything under it, indented depth levels
+	void printNode(std::ostream& output, int depth = 0) const noexcept;
+	// Prints the line of just this node, without the indent
+	virtual void printLine(std::ostream& output) const noexcept = 0;
 	virtual llvm::Value* emitIR(CodeContext& ctx) noexcept = 0;
+	// Adds this node to an AST file (in ASTFile.cpp), after its
+	// children have been added, and returns the index of its record
+	virtual uint32_t writeNode(ASTWriter& writer) const = 0;
+	// The children of this node, in the order they're printed
+	// (in ASTWalk.cpp). An optional child that's missing is null.
+	virtual size_t getNumChildren() const noexcept = 0;
+	virtual const ASTNode* getChild(size_t index) const noexcept = 0;
 	virtual ~ASTNode() { }
 protected:
 	ASTNode() { }
@@ -62,10 +82,16 @@ class ASTFunction;
 class ASTProgram : public ASTNode
 {
 public:
-	void addFunction(std::shared_ptr<ASTFunction> func) noexcept;
+	void addFunction(ASTArena& arena, ASTFunction* func) noexcept;
+	
+	const ASTArray<ASTFunction*>& getFunctions() const noexcept
+	{
+		return mFuncs;
+	}
+	
 	AST_DECL_PRINT_EMIT();
 private:
-	std::list<std::shared_ptr<ASTFunction>> mFuncs;
+	ASTArray<ASTFunction*> mFuncs;
 };
 	
 // Function AST Nodes
@@ -83,10 +109,10 @@ public:
 	{ }
 	
 	// Add an argument to this function
-	void addArg(std::shared_ptr<ASTArgDecl> arg) noexcept;
+	void addArg(ASTArena& arena, ASTArgDecl* arg) noexcept;
 		
 	// Set the compound statement body
-	void setBody(std::shared_ptr<ASTCompoundStmt> body) noexcept;
+	void setBody(ASTCompoundStmt* body) noexcept;
 	
 	Type getReturnType() const noexcept
 	{
@@ -105,10 +131,34 @@ public:
 	
 	Type getArgType(unsigned int argNum) const noexcept;
 	
+	Identifier& getIdent() noexcept
+	{
+		return mIdent;
+	}
+	
+	// Records a function this one calls (duplicates are ignored)
+	void addCallee(ASTArena& arena, Identifier* callee) noexcept;
+	
+	// Writes the return and argument types, such as "int f(int, char[])"
+	void printSignature(std::ostream& output) const noexcept;
+	
+	// Writes everything the IR of this function depends on:
+	// its AST, and the signatures of the functions it calls.
+	// If this text doesn't change, neither does the IR.
+	void printStructure(std::ostream& output) const noexcept;
+	
+	// Only emits the declaration of this function, for when its
+	// body comes from somewhere else (in ASTEmit.cpp).
+	// Maps ident to the declaration, or this function's own
+	// identifier if ident is null.
+	llvm::Function* emitDecl(CodeContext& ctx, Identifier* ident = nullptr) noexcept;
+	
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTCompoundStmt> mBody;
-	std::vector<std::shared_ptr<ASTArgDecl>> mArgs;
+	ASTCompoundStmt* mBody;
+	ASTArray<ASTArgDecl*> mArgs;
+	// Functions called from this function's body
+	ASTArray<Identifier*> mCallees;
 	Identifier& mIdent;
 	SymbolTable::ScopeTable& mScopeTable;
 	Type mReturnType;
@@ -158,7 +208,7 @@ protected:
 class ASTArraySub : public ASTNode
 {
 public:
-	ASTArraySub(Identifier& ident, std::shared_ptr<ASTExpr> expr) noexcept
+	ASTArraySub(Identifier& ident, ASTExpr* expr) noexcept
 	: mIdent(ident)
 	, mExpr(expr)
 	{ }
@@ -171,7 +221,7 @@ public:
 	AST_DECL_PRINT_EMIT();
 private:
 	Identifier& mIdent;
-	std::shared_ptr<ASTExpr> mExpr;
+	ASTExpr* mExpr;
 };
 
 // "Bad" expr is returned if a () subexpr fails, so at least
@@ -186,11 +236,11 @@ class ASTLogicalAnd : public ASTExpr
 {
 public:
 	// We need to be able to manually set the lhs/rhs
-	void setLHS(std::shared_ptr<ASTExpr> lhs) noexcept
+	void setLHS(ASTExpr* lhs) noexcept
 	{
 		mLHS = lhs;
 	}
-	void setRHS(std::shared_ptr<ASTExpr> rhs) noexcept
+	void setRHS(ASTExpr* rhs) noexcept
 	{
 		mRHS = rhs;
 	}
@@ -203,19 +253,19 @@ public:
 	
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTExpr> mLHS;
-	std::shared_ptr<ASTExpr> mRHS;
+	ASTExpr* mLHS;
+	ASTExpr* mRHS;
 };
 
 class ASTLogicalOr : public ASTExpr
 {
 public:
 	// We need to be able to manually set the lhs/rhs
-	void setLHS(std::shared_ptr<ASTExpr> lhs) noexcept
+	void setLHS(ASTExpr* lhs) noexcept
 	{
 		mLHS = lhs;
 	}
-	void setRHS(std::shared_ptr<ASTExpr> rhs) noexcept
+	void setRHS(ASTExpr* rhs) noexcept
 	{
 		mRHS = rhs;
 	}
@@ -228,8 +278,8 @@ public:
 	
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTExpr> mLHS;
-	std::shared_ptr<ASTExpr> mRHS;
+	ASTExpr* mLHS;
+	ASTExpr* mRHS;
 };
 
 class ASTBinaryCmpOp : public ASTExpr
@@ -240,11 +290,11 @@ public:
 	{ }
 	
 	// We need to be able to manually set the lhs/rhs
-	void setLHS(std::shared_ptr<ASTExpr> lhs) noexcept
+	void setLHS(ASTExpr* lhs) noexcept
 	{
 		mLHS = lhs;
 	}
-	void setRHS(std::shared_ptr<ASTExpr> rhs) noexcept
+	void setRHS(ASTExpr* rhs) noexcept
 	{
 		mRHS = rhs;
 	}
@@ -258,8 +308,8 @@ public:
 	AST_DECL_PRINT_EMIT();
 private:
 	scan::Token::Tokens mOp;
-	std::shared_ptr<ASTExpr> mLHS;
-	std::shared_ptr<ASTExpr> mRHS;
+	ASTExpr* mLHS;
+	ASTExpr* mRHS;
 };
 	
 class ASTBinaryMathOp : public ASTExpr
@@ -270,11 +320,11 @@ public:
 	{ }
 	
 	// We need to be able to manually set the lhs/rhs
-	void setLHS(std::shared_ptr<ASTExpr> lhs) noexcept
+	void setLHS(ASTExpr* lhs) noexcept
 	{
 		mLHS = lhs;
 	}
-	void setRHS(std::shared_ptr<ASTExpr> rhs) noexcept
+	void setRHS(ASTExpr* rhs) noexcept
 	{
 		mRHS = rhs;
 	}
@@ -288,8 +338,8 @@ public:
 	AST_DECL_PRINT_EMIT();
 private:
 	scan::Token::Tokens mOp;
-	std::shared_ptr<ASTExpr> mLHS;
-	std::shared_ptr<ASTExpr> mRHS;
+	ASTExpr* mLHS;
+	ASTExpr* mRHS;
 };
 
 // Value -->
@@ -298,14 +348,14 @@ private:
 class ASTNotExpr : public ASTExpr
 {
 public:
-	ASTNotExpr(std::shared_ptr<ASTExpr> expr) noexcept
+	ASTNotExpr(ASTExpr* expr) noexcept
 	: mExpr(expr)
 	{
 		mType = mExpr->getType();
 	}
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTExpr> mExpr;
+	ASTExpr* mExpr;
 };
 	
 // Factor -->
@@ -313,7 +363,16 @@ private:
 class ASTConstantExpr : public ASTExpr
 {
 public:
-	ASTConstantExpr(const std::string& constStr);
+	// constStr is the constant's token text
+	ASTConstantExpr(llvm::StringRef constStr);
+	
+	// For a constant that's already been parsed (see ASTReader)
+	ASTConstantExpr(int value, Type type) noexcept
+	: mValue(value)
+	{
+		mType = type;
+	}
+	
 	int getValue() const noexcept
 	{
 		return mValue;
@@ -337,7 +396,16 @@ private:
 class ASTStringExpr : public ASTExpr
 {
 public:
-	ASTStringExpr(const std::string& str, StringTable& tbl);
+	// str is the string's token text (with the quotes)
+	ASTStringExpr(llvm::StringRef str, StringTable& tbl);
+	
+	// For a string that's already in the table (see ASTReader)
+	ASTStringExpr(ConstStr& str) noexcept
+	: mString(&str)
+	{
+		mType = Type::CharArray;
+	}
+	
 	size_t getLength() const noexcept
 	{
 		return mString->getText().size();
@@ -365,7 +433,7 @@ private:
 class ASTArrayExpr : public ASTExpr
 {
 public:
-	ASTArrayExpr(std::shared_ptr<ASTArraySub> array) noexcept
+	ASTArrayExpr(ASTArraySub* array) noexcept
 	: mArray(array)
 	{
 		if (mArray->getType() == Type::IntArray)
@@ -379,7 +447,7 @@ public:
 	}
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTArraySub> mArray;
+	ASTArraySub* mArray;
 };
 
 // id ( FuncCallArgs )
@@ -399,7 +467,7 @@ public:
 		}
 	}
 	
-	void addArg(std::shared_ptr<ASTExpr> arg) noexcept;
+	void addArg(ASTArena& arena, ASTExpr* arg) noexcept;
 	size_t getNumArgs() const noexcept
 	{
 		return mArgs.size();
@@ -408,7 +476,7 @@ public:
 	AST_DECL_PRINT_EMIT();
 private:
 	Identifier& mIdent;
-	std::list<std::shared_ptr<ASTExpr>> mArgs;
+	ASTArray<ASTExpr*> mArgs;
 };
 
 // ++ id
@@ -442,68 +510,68 @@ private:
 class ASTAddrOfArray : public ASTExpr
 {
 public:
-	ASTAddrOfArray(std::shared_ptr<ASTArraySub> array) noexcept
+	ASTAddrOfArray(ASTArraySub* array) noexcept
 	: mArray(array)
 	{
 		mType = mArray->getType();
 	}
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTArraySub> mArray;
+	ASTArraySub* mArray;
 };
 
 // Used for type conversion from char to int
 class ASTToIntExpr : public ASTExpr
 {
 public:
-	ASTToIntExpr(std::shared_ptr<ASTExpr> expr) noexcept
+	ASTToIntExpr(ASTExpr* expr) noexcept
 	: mExpr(expr)
 	{
 		mType = Type::Int;
 	}
 	
-	std::shared_ptr<ASTExpr> getChild() noexcept
+	ASTExpr* getChild() noexcept
 	{
 		return mExpr;
 	}
 	
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTExpr> mExpr;
+	ASTExpr* mExpr;
 };
 
 // Used for type conversion from int to char
 class ASTToCharExpr : public ASTExpr
 {
 public:
-	ASTToCharExpr(std::shared_ptr<ASTExpr> expr) noexcept
+	ASTToCharExpr(ASTExpr* expr) noexcept
 	: mExpr(expr)
 	{
 		mType = Type::Char;
 	}
 	
-	std::shared_ptr<ASTExpr> getChild() noexcept
+	ASTExpr* getChild() noexcept
 	{
 		return mExpr;
 	}
 	
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTExpr> mExpr;
+	ASTExpr* mExpr;
 };
 
 // Declaration Node
 class ASTDecl : public ASTNode
 {
 public:
-	ASTDecl(Identifier& ident, std::shared_ptr<ASTExpr> expr = nullptr) noexcept
+	ASTDecl(Identifier& ident, ASTExpr* expr = nullptr) noexcept
 	: mIdent(ident)
 	, mExpr(expr)
 	{ }
 	AST_DECL_PRINT_EMIT();
 private:
 	Identifier& mIdent;
-	std::shared_ptr<ASTExpr> mExpr;
+	ASTExpr* mExpr;
 };
 	
 // Statement AST Nodes
@@ -516,90 +584,90 @@ class ASTCompoundStmt : public ASTStmt
 {
 public:
 	AST_DECL_PRINT_EMIT();
-	void addDecl(std::shared_ptr<ASTDecl> decl) noexcept;
-	void addStmt(std::shared_ptr<ASTStmt> stmt) noexcept;
-	std::shared_ptr<ASTStmt> getLastStmt() noexcept;
+	void addDecl(ASTArena& arena, ASTDecl* decl) noexcept;
+	void addStmt(ASTArena& arena, ASTStmt* stmt) noexcept;
+	ASTStmt* getLastStmt() noexcept;
 private:
-	std::list<std::shared_ptr<ASTDecl>> mDecls;
-	std::list<std::shared_ptr<ASTStmt>> mStmts;
+	ASTArray<ASTDecl*> mDecls;
+	ASTArray<ASTStmt*> mStmts;
 };
 
 class ASTAssignStmt : public ASTStmt
 {
 public:
-	ASTAssignStmt(Identifier& ident, std::shared_ptr<ASTExpr> expr) noexcept
+	ASTAssignStmt(Identifier& ident, ASTExpr* expr) noexcept
 	: mIdent(ident)
 	, mExpr(expr)
 	{ }
 	AST_DECL_PRINT_EMIT();
 private:
 	Identifier& mIdent;
-	std::shared_ptr<ASTExpr> mExpr;
+	ASTExpr* mExpr;
 };
 	
 class ASTAssignArrayStmt : public ASTStmt
 {
 public:
-	ASTAssignArrayStmt(std::shared_ptr<ASTArraySub> array,
-					   std::shared_ptr<ASTExpr> expr) noexcept
+	ASTAssignArrayStmt(ASTArraySub* array,
+					   ASTExpr* expr) noexcept
 	: mArray(array)
 	, mExpr(expr)
 	{ }
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTArraySub> mArray;
-	std::shared_ptr<ASTExpr> mExpr;
+	ASTArraySub* mArray;
+	ASTExpr* mExpr;
 };
 
 class ASTIfStmt : public ASTStmt
 {
 public:
-	ASTIfStmt(std::shared_ptr<ASTExpr> expr, std::shared_ptr<ASTStmt> thenStmt,
-			  std::shared_ptr<ASTStmt> elseStmt = nullptr) noexcept
+	ASTIfStmt(ASTExpr* expr, ASTStmt* thenStmt,
+			  ASTStmt* elseStmt = nullptr) noexcept
 	: mExpr(expr)
 	, mThenStmt(thenStmt)
 	, mElseStmt(elseStmt)
 	{ }
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTExpr> mExpr;
-	std::shared_ptr<ASTStmt> mThenStmt;
-	std::shared_ptr<ASTStmt> mElseStmt;
+	ASTExpr* mExpr;
+	ASTStmt* mThenStmt;
+	ASTStmt* mElseStmt;
 };
 
 class ASTWhileStmt : public ASTStmt
 {
 public:
-	ASTWhileStmt(std::shared_ptr<ASTExpr> expr, std::shared_ptr<ASTStmt> loopStmt) noexcept
+	ASTWhileStmt(ASTExpr* expr, ASTStmt* loopStmt) noexcept
 	: mExpr(expr)
 	, mLoopStmt(loopStmt)
 	{ }
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTExpr> mExpr;
-	std::shared_ptr<ASTStmt> mLoopStmt;
+	ASTExpr* mExpr;
+	ASTStmt* mLoopStmt;
 };
 	
 class ASTReturnStmt : public ASTStmt
 {
 public:
-	ASTReturnStmt(std::shared_ptr<ASTExpr> expr) noexcept
+	ASTReturnStmt(ASTExpr* expr) noexcept
 	: mExpr(expr)
 	{ }
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTExpr> mExpr;
+	ASTExpr* mExpr;
 };
 
 class ASTExprStmt : public ASTStmt
 {
 public:
-	ASTExprStmt(std::shared_ptr<ASTExpr> expr) noexcept
+	ASTExprStmt(ASTExpr* expr) noexcept
 	: mExpr(expr)
 	{ }
 	AST_DECL_PRINT_EMIT();
 private:
-	std::shared_ptr<ASTExpr> mExpr;
+	ASTExpr* mExpr;
 };
 
 class ASTNullStmt : public ASTStmt
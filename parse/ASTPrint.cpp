@@ -2,7 +2,8 @@
 //  ASTNodes.cpp
 //  uscc
 //
-//  Implements the printNode function for every AST node
+//  Implements the printLine function for every AST node,
+//  and printNode, which prints the tree under a node
 //
 //---------------------------------------------------------
 //  Copyright (c) 2014, Sanjay Madhav
@@ -13,27 +14,52 @@
 //---------------------------------------------------------
 
 #include "ASTNodes.h"
+#include "ASTWalk.h"
 #include "Symbols.h"
 
 using namespace uscc::parse;
 using namespace uscc::scan;
 
-using std::shared_ptr;
+namespace
+{
 
-// DON'T TRY THIS AT HOME
-#define AST_PRINT(a) void a::printNode(std::ostream& output, int depth) const noexcept \
-{ \
-for (int i = 0; i < depth; i++) \
-{ \
-	output << "---"; \
+// Prints each node on a line of its own, indented by its depth
+class ASTPrinter : public ASTVisitor
+{
+public:
+	ASTPrinter(std::ostream& output)
+	: mOutput(output)
+	{ }
+
+	virtual bool enter(const ASTNode& node, int depth) override
+	{
+		for (int i = 0; i < depth; i++)
+		{
+			mOutput << "---";
+		}
+		node.printLine(mOutput);
+		return true;
+	}
+
+private:
+	std::ostream& mOutput;
+};
+
+} // anonymous
+
+void ASTNode::printNode(std::ostream& output, int depth) const noexcept
+{
+	ASTPrinter printer(output);
+	walkAST(*this, printer, depth);
 }
 
+// DON'T TRY THIS AT HOME
+// (The children are printed by ASTPrinter, after the line of the node)
+#define AST_PRINT(a) void a::printLine(std::ostream& output) const noexcept \
+{
+
 AST_PRINT(ASTProgram)
 	output << "Program:" << std::endl;
-	for (auto func : mFuncs)
-	{
-		func->printNode(output, depth + 1);
-	}
 }
 
 AST_PRINT(ASTFunction)
@@ -54,13 +80,6 @@ AST_PRINT(ASTFunction)
 			break;
 	}
 	output << mIdent.getName() << std::endl;
-
-	for (auto arg : mArgs)
-	{
-		arg->printNode(output, depth + 1);
-	}
-	
-	mBody->printNode(output, depth + 1);
 }
 
 AST_PRINT(ASTArgDecl)
@@ -91,7 +110,6 @@ AST_PRINT(ASTArgDecl)
 
 AST_PRINT(ASTArraySub)
 	output << "ArraySub: " << mIdent.getName() << std::endl;
-	mExpr->printNode(output, depth + 1);
 }
 
 // Expressions
@@ -101,32 +119,23 @@ AST_PRINT(ASTBadExpr)
 
 AST_PRINT(ASTLogicalAnd)
 	output << "LogicalAnd: " << std::endl;
-	mLHS->printNode(output, depth + 1);
-	mRHS->printNode(output, depth + 1);
 }
 
 AST_PRINT(ASTLogicalOr)
 	output << "LogicalOr: " << std::endl;
-	mLHS->printNode(output, depth + 1);
-	mRHS->printNode(output, depth + 1);
 }
 
 AST_PRINT(ASTBinaryCmpOp)
 output << "BinaryCmp " << Token::Values[mOp] << ':' << std::endl;
-	mLHS->printNode(output, depth + 1);
-	mRHS->printNode(output, depth + 1);
 }
 
 AST_PRINT(ASTBinaryMathOp)
 	output << "BinaryMath " << Token::Values[mOp] << ':' << std::endl;
-	mLHS->printNode(output, depth + 1);
-	mRHS->printNode(output, depth + 1);
 }
 
 // Value -->
 AST_PRINT(ASTNotExpr)
 	output << "NotExpr:" << std::endl;
-	mExpr->printNode(output, depth + 1);
 }
 
 // Factor -->
@@ -144,15 +153,10 @@ AST_PRINT(ASTIdentExpr)
 
 AST_PRINT(ASTArrayExpr)
 	output << "ArrayExpr: " << std::endl;
-	mArray->printNode(output, depth + 1);
 }
 
 AST_PRINT(ASTFuncExpr)
 output << "FuncExpr: " << mIdent.getName() << std::endl;
-	for (auto arg : mArgs)
-	{
-		arg->printNode(output, depth + 1);
-	}
 }
 
 AST_PRINT(ASTIncExpr)
@@ -165,17 +169,14 @@ AST_PRINT(ASTDecExpr)
 
 AST_PRINT(ASTAddrOfArray)
 	output << "AddrOfArray:" << std::endl;
-	mArray->printNode(output, depth + 1);
 }
 			
 AST_PRINT(ASTToIntExpr)
 	output << "ToIntExpr: " << std::endl;
-	mExpr->printNode(output, depth + 1);
 }
 			
 AST_PRINT(ASTToCharExpr)
 	output << "ToCharExpr: " << std::endl;
-	mExpr->printNode(output, depth + 1);
 }
 
 // Declaration
@@ -203,23 +204,11 @@ AST_PRINT(ASTDecl)
 			break;
 	}
 	output << ' ' << mIdent.getName() << std::endl;
-	if (mExpr)
-	{
-		mExpr->printNode(output, depth + 1);
-	}
 }
 
 // Statements
 AST_PRINT(ASTCompoundStmt)
 	output << "CompoundStmt:" << std::endl;
-	for (auto decl : mDecls)
-	{
-		decl->printNode(output, depth + 1);
-	}
-	for (auto stmt : mStmts)
-	{
-		stmt->printNode(output, depth + 1);
-	}
 }
 
 AST_PRINT(ASTReturnStmt)
@@ -230,40 +219,27 @@ AST_PRINT(ASTReturnStmt)
 	else
 	{
 		output << "ReturnStmt:" << std::endl;
-		mExpr->printNode(output, depth + 1);
 	}
 }
 
 AST_PRINT(ASTAssignStmt)
 	output << "AssignStmt: " << mIdent.getName() << std::endl;
-	mExpr->printNode(output, depth + 1);
 }
 
 AST_PRINT(ASTAssignArrayStmt)
 	output << "AssignArrayStmt:" << std::endl;
-	mArray->printNode(output, depth + 1);
-	mExpr->printNode(output, depth + 1);
 }
 
 AST_PRINT(ASTIfStmt)
 	output << "IfStmt: " << std::endl;
-	mExpr->printNode(output, depth + 1);
-	mThenStmt->printNode(output, depth + 1);
-	if (mElseStmt)
-	{
-		mElseStmt->printNode(output, depth + 1);
-	}
 }
 
 AST_PRINT(ASTWhileStmt)
 	output << "WhileStmt" << std::endl;
-	mExpr->printNode(output, depth + 1);
-	mLoopStmt->printNode(output, depth + 1);
 }
 
 AST_PRINT(ASTExprStmt)
 	output << "ExprStmt" << std::endl;
-	mExpr->printNode(output, depth + 1);
 }
 
 AST_PRINT(ASTNullStmt)
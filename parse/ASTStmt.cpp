@@ -16,19 +16,17 @@
 
 using namespace uscc::parse;
 
-using std::shared_ptr;
-
-void ASTCompoundStmt::addDecl(shared_ptr<ASTDecl> decl) noexcept
+void ASTCompoundStmt::addDecl(ASTArena& arena, ASTDecl* decl) noexcept
 {
-	mDecls.push_back(decl);
+	mDecls.push_back(arena, decl);
 }
 
-void ASTCompoundStmt::addStmt(shared_ptr<ASTStmt> stmt) noexcept
+void ASTCompoundStmt::addStmt(ASTArena& arena, ASTStmt* stmt) noexcept
 {
-	mStmts.push_back(stmt);
+	mStmts.push_back(arena, stmt);
 }
 
-shared_ptr<ASTStmt> ASTCompoundStmt::getLastStmt() noexcept
+ASTStmt* ASTCompoundStmt::getLastStmt() noexcept
 {
 	if (mStmts.size() > 0)
 	{
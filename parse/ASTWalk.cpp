@@ -0,0 +1,279 @@
+//
+//  ASTWalk.cpp
+//  uscc
+//
+//  Implements walkAST, and the getChild function for
+//  every AST node.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "ASTWalk.h"
+#include "ASTNodes.h"
+#include <vector>
+
+using namespace uscc::parse;
+
+namespace
+{
+
+// A node the walk is in, and the next of its children to walk
+struct WalkFrame
+{
+	const ASTNode* mNode;
+	size_t mNext;
+	size_t mNumChildren;
+};
+
+} // anonymous
+
+namespace uscc
+{
+namespace parse
+{
+
+void walkAST(const ASTNode& root, ASTVisitor& visitor, int depth)
+{
+	std::vector<WalkFrame> stack;
+
+	// Enters node, and returns false if its children are skipped
+	// (in which case it's left right away)
+	auto enter = [&stack, &visitor, depth](const ASTNode& node)
+	{
+		int nodeDepth = depth + static_cast<int>(stack.size());
+		if (!visitor.enter(node, nodeDepth))
+		{
+			visitor.leave(node, nodeDepth);
+			return false;
+		}
+
+		WalkFrame frame;
+		frame.mNode = &node;
+		frame.mNext = 0;
+		frame.mNumChildren = node.getNumChildren();
+		stack.push_back(frame);
+		return true;
+	};
+
+	enter(root);
+	while (!stack.empty())
+	{
+		WalkFrame& frame = stack.back();
+		if (frame.mNext < frame.mNumChildren)
+		{
+			const ASTNode* parent = frame.mNode;
+			size_t index = frame.mNext++;
+			const ASTNode* child = parent->getChild(index);
+			if (child && !enter(*child))
+			{
+				visitor.afterChild(*parent, index);
+			}
+			continue;
+		}
+
+		// All of the children are done
+		const ASTNode* node = frame.mNode;
+		stack.pop_back();
+		visitor.leave(*node, depth + static_cast<int>(stack.size()));
+		if (!stack.empty())
+		{
+			visitor.afterChild(*stack.back().mNode, stack.back().mNext - 1);
+		}
+	}
+}
+
+} // parse
+} // uscc
+
+#define AST_NUM_CHILDREN(a, n) size_t a::getNumChildren() const noexcept \
+{ \
+	return n; \
+}
+
+#define AST_CHILD(a) const ASTNode* a::getChild(size_t index) const noexcept
+
+// A node without children
+#define AST_NO_CHILDREN(a) AST_NUM_CHILDREN(a, 0) \
+AST_CHILD(a) \
+{ \
+	return nullptr; \
+}
+
+AST_NUM_CHILDREN(ASTProgram, mFuncs.size())
+AST_CHILD(ASTProgram)
+{
+	return mFuncs[index];
+}
+
+// The arguments, and then the body
+AST_NUM_CHILDREN(ASTFunction, mArgs.size() + 1)
+AST_CHILD(ASTFunction)
+{
+	if (index < mArgs.size())
+	{
+		return mArgs[index];
+	}
+	return mBody;
+}
+
+AST_NO_CHILDREN(ASTArgDecl)
+
+AST_NUM_CHILDREN(ASTArraySub, 1)
+AST_CHILD(ASTArraySub)
+{
+	return mExpr;
+}
+
+// Expressions
+AST_NO_CHILDREN(ASTBadExpr)
+
+AST_NUM_CHILDREN(ASTLogicalAnd, 2)
+AST_CHILD(ASTLogicalAnd)
+{
+	return (index == 0) ? mLHS : mRHS;
+}
+
+AST_NUM_CHILDREN(ASTLogicalOr, 2)
+AST_CHILD(ASTLogicalOr)
+{
+	return (index == 0) ? mLHS : mRHS;
+}
+
+AST_NUM_CHILDREN(ASTBinaryCmpOp, 2)
+AST_CHILD(ASTBinaryCmpOp)
+{
+	return (index == 0) ? mLHS : mRHS;
+}
+
+AST_NUM_CHILDREN(ASTBinaryMathOp, 2)
+AST_CHILD(ASTBinaryMathOp)
+{
+	return (index == 0) ? mLHS : mRHS;
+}
+
+AST_NUM_CHILDREN(ASTNotExpr, 1)
+AST_CHILD(ASTNotExpr)
+{
+	return mExpr;
+}
+
+AST_NO_CHILDREN(ASTConstantExpr)
+
+AST_NO_CHILDREN(ASTStringExpr)
+
+AST_NO_CHILDREN(ASTIdentExpr)
+
+AST_NUM_CHILDREN(ASTArrayExpr, 1)
+AST_CHILD(ASTArrayExpr)
+{
+	return mArray;
+}
+
+AST_NUM_CHILDREN(ASTFuncExpr, mArgs.size())
+AST_CHILD(ASTFuncExpr)
+{
+	return mArgs[index];
+}
+
+AST_NO_CHILDREN(ASTIncExpr)
+
+AST_NO_CHILDREN(ASTDecExpr)
+
+AST_NUM_CHILDREN(ASTAddrOfArray, 1)
+AST_CHILD(ASTAddrOfArray)
+{
+	return mArray;
+}
+
+AST_NUM_CHILDREN(ASTToIntExpr, 1)
+AST_CHILD(ASTToIntExpr)
+{
+	return mExpr;
+}
+
+AST_NUM_CHILDREN(ASTToCharExpr, 1)
+AST_CHILD(ASTToCharExpr)
+{
+	return mExpr;
+}
+
+// Declaration (the expression is optional)
+AST_NUM_CHILDREN(ASTDecl, 1)
+AST_CHILD(ASTDecl)
+{
+	return mExpr;
+}
+
+// Statements
+
+// The declarations, and then the statements
+AST_NUM_CHILDREN(ASTCompoundStmt, mDecls.size() + mStmts.size())
+AST_CHILD(ASTCompoundStmt)
+{
+	if (index < mDecls.size())
+	{
+		return mDecls[index];
+	}
+	return mStmts[index - mDecls.size()];
+}
+
+AST_NUM_CHILDREN(ASTAssignStmt, 1)
+AST_CHILD(ASTAssignStmt)
+{
+	return mExpr;
+}
+
+AST_NUM_CHILDREN(ASTAssignArrayStmt, 2)
+AST_CHILD(ASTAssignArrayStmt)
+{
+	if (index == 0)
+	{
+		return mArray;
+	}
+	return mExpr;
+}
+
+// The else is optional
+AST_NUM_CHILDREN(ASTIfStmt, 3)
+AST_CHILD(ASTIfStmt)
+{
+	switch (index)
+	{
+		case 0:
+			return mExpr;
+		case 1:
+			return mThenStmt;
+		default:
+			return mElseStmt;
+	}
+}
+
+AST_NUM_CHILDREN(ASTWhileStmt, 2)
+AST_CHILD(ASTWhileStmt)
+{
+	if (index == 0)
+	{
+		return mExpr;
+	}
+	return mLoopStmt;
+}
+
+// The expression is optional
+AST_NUM_CHILDREN(ASTReturnStmt, 1)
+AST_CHILD(ASTReturnStmt)
+{
+	return mExpr;
+}
+
+AST_NUM_CHILDREN(ASTExprStmt, 1)
+AST_CHILD(ASTExprStmt)
+{
+	return mExpr;
+}
+
+AST_NO_CHILDREN(ASTNullStmt)
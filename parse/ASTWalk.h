@@ -0,0 +1,58 @@
+//
+//  ASTWalk.h
+//  uscc
+//
+//  Declares the visitor that walks an AST without recursing.
+//
+//  An expression with thousands of terms is a tree thousands
+//  of nodes deep, so a walk that calls itself for each child
+//  can run out of stack. walkAST keeps the nodes it's in on a
+//  stack of its own, and calls the visitor as it enters and
+//  leaves each one (printing, writing AST files, and any new
+//  analysis should be written as a visitor).
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+
+namespace uscc
+{
+namespace parse
+{
+
+class ASTNode;
+
+class ASTVisitor
+{
+public:
+	virtual ~ASTVisitor() { }
+
+	// Called before the children of node, which is depth levels
+	// below the root. Returns false to skip its children.
+	virtual bool enter(const ASTNode& node, int depth)
+	{
+		return true;
+	}
+
+	// Called after the walk of child index of node (a null child,
+	// such as a missing else, isn't walked)
+	virtual void afterChild(const ASTNode& node, size_t index) { }
+
+	// Called after the children of node
+	virtual void leave(const ASTNode& node, int depth) { }
+};
+
+// Walks root and everything under it, with the children of each
+// node in the order getChild gives them. (depth is the root's.)
+void walkAST(const ASTNode& root, ASTVisitor& visitor, int depth = 0);
+
+} // parse
+} // uscc
@@ -20,6 +20,7 @@
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
 #include <llvm/IR/Value.h>
+#include <llvm/IR/Module.h>
 #include <llvm/PassManager.h>
 #include <llvm/IR/IRPrintingPasses.h>
 #include <llvm/IR/LegacyPassManager.h>
@@ -41,14 +42,204 @@
 #include <llvm/Support//FileSystem.h>
 #include <llvm/Support/SourceMgr.h>
 #include <llvm/MC/SubtargetFeature.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/CodeGen/LinkAllCodegenComponents.h>
+#include <llvm/CodeGen/RegAllocRegistry.h>
 #include "../opt/Passes.h"
 #pragma clang diagnostic pop
+#include "../support/Parallel.h"
+#include "../support/Timing.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sstream>
 
 using namespace uscc::parse;
+using namespace uscc::support;
 using namespace llvm;
 
-CodeContext::CodeContext(StringTable& strings)
-: mGlobal(getGlobalContext())
+namespace
+{
+
+// Returns the function cache key for this function
+std::string functionKey(const ASTFunction& func)
+{
+	std::ostringstream structure;
+	func.printStructure(structure);
+	
+	MD5 hash;
+	hash.update(structure.str());
+	MD5::MD5Result result;
+	hash.final(result);
+	
+	SmallString<32> hex;
+	MD5::stringifyResult(result, hex);
+	return hex.str().str();
+}
+
+// uscc only links in the x86 code generator
+std::once_flag sInitTarget;
+
+void initializeTarget()
+{
+	std::call_once(sInitTarget, []()
+	{
+		LLVMInitializeX86TargetInfo();
+		LLVMInitializeX86Target();
+		LLVMInitializeX86TargetMC();
+		LLVMInitializeX86AsmPrinter();
+	});
+}
+
+// Erases the globals nothing uses anymore
+void eraseUnusedGlobals(Module& module)
+{
+	for (auto iter = module.global_begin(); iter != module.global_end(); )
+	{
+		GlobalVariable& global = *iter++;
+		if (global.use_empty())
+		{
+			global.eraseFromParent();
+		}
+	}
+}
+
+// Returns a module (in the same context) with a copy of func, along
+// with declarations of the functions and copies of the globals it uses.
+// Only func itself is walked, so splitting up a module this way takes
+// time linear in its size.
+std::unique_ptr<Module> extractFunction(const Function& func)
+{
+	const Module& source = *func.getParent();
+	std::unique_ptr<Module> single(new Module(source.getModuleIdentifier(), func.getContext()));
+	single->setDataLayout(source.getDataLayout());
+	single->setTargetTriple(source.getTargetTriple());
+	
+	// Find the globals func uses, including the ones only constant
+	// expressions (like the GEP of a string) or initializers use
+	std::vector<const GlobalValue*> used;
+	SmallPtrSet<const Value*, 32> seen;
+	std::vector<const Value*> work;
+	for (const BasicBlock& block : func)
+	{
+		for (const Instruction& inst : block)
+		{
+			for (auto op = inst.op_begin(); op != inst.op_end(); ++op)
+			{
+				work.push_back(op->get());
+			}
+		}
+	}
+	while (!work.empty())
+	{
+		const Value* value = work.back();
+		work.pop_back();
+		if (!isa<Constant>(value) || seen.count(value))
+		{
+			continue;
+		}
+		seen.insert(value);
+		
+		if (auto global = dyn_cast<GlobalValue>(value))
+		{
+			used.push_back(global);
+			auto var = dyn_cast<GlobalVariable>(global);
+			if (var && var->hasInitializer())
+			{
+				work.push_back(var->getInitializer());
+			}
+		}
+		else
+		{
+			const Constant* constant = cast<Constant>(value);
+			for (auto op = constant->op_begin(); op != constant->op_end(); ++op)
+			{
+				work.push_back(op->get());
+			}
+		}
+	}
+	
+	ValueToValueMapTy vmap;
+	Function* copy = Function::Create(func.getFunctionType(), func.getLinkage(),
+									  func.getName(), single.get());
+	copy->copyAttributesFrom(&func);
+	vmap[&func] = copy;
+	for (const GlobalValue* global : used)
+	{
+		if (global == &func)
+		{
+			continue;
+		}
+		
+		if (auto callee = dyn_cast<Function>(global))
+		{
+			// (Same as deleteBody, which makes the function external)
+			Function* decl = Function::Create(callee->getFunctionType(),
+											  GlobalValue::ExternalLinkage,
+											  callee->getName(), single.get());
+			decl->copyAttributesFrom(callee);
+			vmap[callee] = decl;
+		}
+		else
+		{
+			auto var = cast<GlobalVariable>(global);
+			GlobalVariable* copyVar = new GlobalVariable(*single,
+				var->getType()->getElementType(), var->isConstant(),
+				var->getLinkage(), nullptr, var->getName(), nullptr,
+				var->getThreadLocalMode(), var->getType()->getAddressSpace());
+			copyVar->copyAttributesFrom(var);
+			vmap[var] = copyVar;
+		}
+	}
+	
+	// Initializers can only be mapped once every global has its copy
+	for (const GlobalValue* global : used)
+	{
+		auto var = dyn_cast<GlobalVariable>(global);
+		if (var && var->hasInitializer())
+		{
+			cast<GlobalVariable>(vmap[var])->setInitializer(MapValue(var->getInitializer(), vmap));
+		}
+	}
+	
+	auto arg = copy->arg_begin();
+	for (auto oldArg = func.arg_begin(); oldArg != func.arg_end(); ++oldArg, ++arg)
+	{
+		arg->setName(oldArg->getName());
+		vmap[&*oldArg] = &*arg;
+	}
+	
+	SmallVector<ReturnInst*, 8> returns;
+	CloneFunctionInto(copy, &func, vmap, true, returns);
+	return single;
+}
+
+// Returns the bitcode of a module that only defines func
+// (see extractFunction)
+std::string writeFunction(const Function& func)
+{
+	std::unique_ptr<Module> single(extractFunction(func));
+	
+	std::string bitcode;
+	raw_string_ostream output(bitcode);
+	WriteBitcodeToFile(single.get(), output);
+	output.flush();
+	return bitcode;
+}
+
+} // anonymous
+
+CodeContext::CodeContext(StringTable& strings, LLVMContext& global)
+: mGlobal(global)
 , mModule(nullptr)
 , mBlock(nullptr)
 , mStrings(strings)
@@ -60,13 +251,50 @@ CodeContext::CodeContext(StringTable& strings)
 }
 
 Emitter::Emitter(Parser& parser) noexcept
-: mContext(parser.mStrings)
+: Emitter(parser, getGlobalContext(), nullptr)
+{
+	
+}
+
+Emitter::Emitter(Parser& parser, LLVMContext& context) noexcept
+: Emitter(parser, context, nullptr)
+{
+	
+}
+
+Emitter::Emitter(Parser& parser, LLVMContext& context, FunctionCache* funcCache) noexcept
+: mContext(parser.mStrings, context)
+, mFuncCache(funcCache)
+, mSpliced(false)
+, mOptThreads(0)
+{
+	if (mFuncCache)
+	{
+		loadCachedFunctions(parser);
+	}
+	emitProgram(parser);
+}
+
+Emitter::~Emitter() noexcept
+{
+	for (const auto& cached : mCachedModules)
+	{
+		delete cached.second;
+	}
+	delete mContext.mModule;
+}
+
+void Emitter::emitProgram(Parser& parser) noexcept
 {
+	PhaseScope timeEmit("emit");
+	
 	if (parser.mNeedPrintf)
 	{
 		mContext.mPrintfIdent = parser.mSymbols.getIdentifier("printf");
 	}
 	
+	mContext.mExternFuncs = parser.mExterns;
+	
 	// Initialize zero
 	mContext.mZero = Constant::getNullValue(IntegerType::getInt32Ty(mContext.mGlobal));
 	
@@ -74,38 +302,434 @@ Emitter::Emitter(Parser& parser) noexcept
 	parser.mRoot->emitIR(mContext);
 }
 
-void Emitter::optimize() noexcept
+void Emitter::loadCachedFunctions(Parser& parser) noexcept
 {
-	legacy::PassManager pm;
-	uscc::opt::registerOptPasses(pm);
-	pm.run(*mContext.mModule);
+	PhaseScope timeLoad("emit/function cache");
+	
+	for (auto func : parser.mRoot->getFunctions())
+	{
+		std::string name = func->getIdent().getName();
+		std::string key = functionKey(*func);
+		
+		std::string bitcode;
+		if (mFuncCache->load(key, bitcode))
+		{
+			std::unique_ptr<MemoryBuffer> buffer(MemoryBuffer::getMemBuffer(bitcode, name, false));
+			ErrorOr<Module*> module = parseBitcodeFile(buffer.get(), mContext.mGlobal);
+			
+			// Only use the entry if it really defines this function
+			if (module)
+			{
+				Function* cachedFunc = (*module)->getFunction(name);
+				if (cachedFunc && !cachedFunc->isDeclaration())
+				{
+					mCachedModules.push_back(std::make_pair(key, *module));
+					mContext.mCachedFuncs.insert(func);
+					continue;
+				}
+				delete *module;
+			}
+		}
+		
+		mEmittedFuncs.push_back(std::make_pair(name, key));
+	}
+}
+
+void Emitter::spliceCachedFunctions() noexcept
+{
+	if (!mFuncCache || mSpliced)
+	{
+		return;
+	}
+	mSpliced = true;
+	
+	PhaseScope timeSplice("function cache splice");
+	
+	// Store each function we emitted in a module of its own
+	for (const auto& emitted : mEmittedFuncs)
+	{
+		Function* func = mContext.mModule->getFunction(emitted.first);
+		if (func && !func->isDeclaration())
+		{
+			mFuncCache->store(emitted.second, writeFunction(*func));
+		}
+	}
+	
+	// Now the cached bodies fill in their declarations. If one can't be
+	// linked in, its function is left without a body, so the compile
+	// fails (and the entry is dropped, so the next compile emits it).
+	for (const auto& cached : mCachedModules)
+	{
+		std::string name = cached.second->getModuleIdentifier();
+		std::string err;
+		if (Linker::LinkModules(mContext.mModule, cached.second, Linker::DestroySource, &err))
+		{
+			mFuncCache->remove(cached.first);
+			if (mCacheError.empty())
+			{
+				mCacheError = "Unable to link function " + name +
+					" from the function cache (" + err + ").";
+			}
+		}
+		delete cached.second;
+	}
+	mCachedModules.clear();
+}
+
+void Emitter::setOptThreads(unsigned int numThreads) noexcept
+{
+	mOptThreads = numThreads;
+}
+
+const std::string& Emitter::getSplitError() const noexcept
+{
+	return mSplitError;
+}
+
+const std::string& Emitter::getCacheError() const noexcept
+{
+	return mCacheError;
+}
+
+void Emitter::optimize(unsigned int level) noexcept
+{
+	runOptPasses([level](legacy::PassManager& pm)
+	{
+		uscc::opt::registerOptPasses(pm, level);
+	});
+}
+
+bool Emitter::optimize(const std::string& pipeline, std::string& badName) noexcept
+{
+	// Check the names up front, so adding the passes can't fail
+	if (!uscc::opt::isOptPipeline(pipeline, badName))
+	{
+		return false;
+	}
+	
+	runOptPasses([&pipeline](legacy::PassManager& pm)
+	{
+		std::string unused;
+		uscc::opt::registerOptPipeline(pm, pipeline, unused);
+	});
+	return true;
+}
+
+void Emitter::runOptPasses(const PassAdder& addPasses) noexcept
+{
+	// registerOptPasses also times each pass, as "optimize/<pass>"
+	PhaseScope timeOptimize("optimize");
+	mSplitError.clear();
+	if (mOptThreads == 0 || !runOptPassesSplit(addPasses, mSplitError))
+	{
+		legacy::PassManager pm;
+		addPasses(pm);
+		pm.run(*mContext.mModule);
+	}
+	
+	// Cached functions were optimized before they were stored
+	spliceCachedFunctions();
+}
+
+bool Emitter::runOptPassesSplit(const PassAdder& addPasses, std::string& error) noexcept
+{
+	std::string whole;
+	std::vector<std::string> names;
+	{
+		PhaseScope timeSplit("optimize/split");
+		raw_string_ostream output(whole);
+		WriteBitcodeToFile(mContext.mModule, output);
+		output.flush();
+		for (Function& func : *mContext.mModule)
+		{
+			if (!func.isDeclaration())
+			{
+				names.push_back(func.getName().str());
+			}
+		}
+	}
+	
+	// An LLVMContext can only be used by one thread at a time, so each
+	// group reads the module into a context of its own, then splits its
+	// share of the functions out of that. Every function still gets a
+	// module of its own no matter how many groups there are, so the
+	// output never depends on the thread count.
+	std::vector<std::string> bitcode(names.size());
+	size_t numGroups = std::min<size_t>(mOptThreads, names.size());
+	std::vector<std::string> groupErrors(numGroups);
+	
+	// The passes on each thread are timed on a timer of their own,
+	// which is added to this thread's report once the group is done
+	// (so the per-pass times are summed over the threads)
+	PhaseTimer* parentTimer = PhaseTimer::getActive();
+	std::mutex timerMutex;
+	
+	support::parallelFor(numGroups, mOptThreads, [&](size_t group)
+	{
+		std::unique_ptr<PhaseTimer> timer(parentTimer ? new PhaseTimer() : nullptr);
+		{
+			ActivePhaseTimer activeTimer(timer.get());
+			
+			LLVMContext context;
+			std::unique_ptr<MemoryBuffer> buffer(MemoryBuffer::getMemBuffer(whole, "", false));
+			ErrorOr<Module*> module = parseBitcodeFile(buffer.get(), context);
+			if (!module)
+			{
+				groupErrors[group] = module.getError().message();
+				return;
+			}
+			std::unique_ptr<Module> owned(*module);
+			
+			for (size_t i = group; i < names.size(); i += numGroups)
+			{
+				std::unique_ptr<Module> single(extractFunction(*owned->getFunction(names[i])));
+				
+				legacy::PassManager pm;
+				addPasses(pm);
+				pm.run(*single);
+				
+				raw_string_ostream output(bitcode[i]);
+				WriteBitcodeToFile(single.get(), output);
+				output.flush();
+			}
+		}
+		
+		if (timer)
+		{
+			std::lock_guard<std::mutex> lock(timerMutex);
+			parentTimer->accumulate(*timer);
+		}
+	});
+	for (const auto& groupError : groupErrors)
+	{
+		if (!groupError.empty())
+		{
+			error = groupError;
+			return false;
+		}
+	}
+	
+	// The bodies are replaced in a copy of the module, so if anything
+	// goes wrong, the module is left as it was. The linker appends each
+	// definition, so the functions keep their order.
+	PhaseScope timeJoin("optimize/join");
+	std::unique_ptr<MemoryBuffer> buffer(MemoryBuffer::getMemBuffer(whole,
+		mContext.mModule->getModuleIdentifier(), false));
+	ErrorOr<Module*> joinedOrError = parseBitcodeFile(buffer.get(), mContext.mGlobal);
+	if (!joinedOrError)
+	{
+		error = joinedOrError.getError().message();
+		return false;
+	}
+	std::unique_ptr<Module> joined(*joinedOrError);
+	for (Function& func : *joined)
+	{
+		if (!func.isDeclaration())
+		{
+			func.deleteBody();
+		}
+	}
+	eraseUnusedGlobals(*joined);
+	
+	for (size_t i = 0; i < bitcode.size(); i++)
+	{
+		std::unique_ptr<MemoryBuffer> optimized(MemoryBuffer::getMemBuffer(bitcode[i], names[i], false));
+		ErrorOr<Module*> module = parseBitcodeFile(optimized.get(), mContext.mGlobal);
+		if (!module)
+		{
+			error = names[i] + ": " + module.getError().message();
+			return false;
+		}
+		std::unique_ptr<Module> owned(*module);
+		if (Linker::LinkModules(joined.get(), owned.get(), Linker::DestroySource, &error))
+		{
+			error = names[i] + ": " + error;
+			return false;
+		}
+	}
+	
+	delete mContext.mModule;
+	mContext.mModule = joined.release();
+	return true;
 }
 
 void Emitter::print() noexcept
 {
+	print(outs());
+}
+
+void Emitter::print(raw_ostream& output) noexcept
+{
+	spliceCachedFunctions();
 	legacy::PassManager pm;
-	pm.add(createPrintModulePass(outs()));
+	pm.add(createPrintModulePass(output));
 	pm.run(*mContext.mModule);
 }
 
 void Emitter::writeBitcode(const char* fileName) noexcept
 {
-	legacy::PassManager pm;
 	std::string err;
 	raw_fd_ostream file(fileName, err, sys::fs::F_None);
-	pm.add(createBitcodeWriterPass(file));
+	writeBitcode(file);
+}
+
+void Emitter::writeBitcode(raw_ostream& output) noexcept
+{
+	spliceCachedFunctions();
+	PhaseScope timeWrite("write bitcode");
+	legacy::PassManager pm;
+	pm.add(createBitcodeWriterPass(output));
 	pm.run(*mContext.mModule);
 }
 
 bool Emitter::verify() noexcept
 {
-	return !verifyModule(*mContext.mModule);
+	spliceCachedFunctions();
+	PhaseScope timeVerify("verify");
+	return mCacheError.empty() && !verifyModule(*mContext.mModule);
 }
 
 // This function will take the bitcode emitted by uscc and convert it to assembly
-bool Emitter::writeAsm(const char *fileName) noexcept
+bool Emitter::writeAsm(const char* fileName, const NativeTarget& target,
+					   std::string& error) noexcept
 {
-	// 11/20/2014 - This function removed because it doesn't work with LLVM 3.5.0...
+	return writeNative(fileName, target, true, error);
+}
+
+bool Emitter::writeObject(const char* fileName, const NativeTarget& target,
+						  std::string& error) noexcept
+{
+	return writeNative(fileName, target, false, error);
+}
+
+bool Emitter::writeAsm(raw_ostream& output, const NativeTarget& target,
+					   std::string& error) noexcept
+{
+	return writeNative(output, target, true, error);
+}
+
+bool Emitter::writeObject(raw_ostream& output, const NativeTarget& target,
+						  std::string& error) noexcept
+{
+	return writeNative(output, target, false, error);
+}
+
+bool Emitter::setRegisterAllocator(const std::string& name) noexcept
+{
+	for (RegisterRegAlloc* node = RegisterRegAlloc::getList(); node;
+		 node = node->getNext())
+	{
+		if (name == node->getName())
+		{
+			RegisterRegAlloc::setDefault(
+				reinterpret_cast<RegisterRegAlloc::FunctionPassCtor>(node->getCtor()));
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Emitter::writeNative(const char* fileName, const NativeTarget& target,
+						  bool assembly, std::string& error) noexcept
+{
+	tool_output_file output(fileName, error, sys::fs::F_None);
+	if (!error.empty())
+	{
+		return false;
+	}
+	
+	// The file is deleted unless we keep it
+	if (!writeNative(output.os(), target, assembly, error))
+	{
+		return false;
+	}
 	
+	output.keep();
 	return true;
 }
+
+bool Emitter::writeNative(raw_ostream& output, const NativeTarget& target,
+						  bool assembly, std::string& error) noexcept
+{
+	spliceCachedFunctions();
+	PhaseScope timeCodegen("codegen");
+	initializeTarget();
+	
+	// This is the same setup llc does
+	Triple triple(sys::getDefaultTargetTriple());
+	const Target* theTarget = TargetRegistry::lookupTarget(target.mArch, triple, error);
+	if (!theTarget)
+	{
+		return false;
+	}
+	
+	std::string cpu = target.mCPU;
+	SubtargetFeatures features;
+	if (cpu == "native")
+	{
+		cpu = sys::getHostCPUName();
+		StringMap<bool> hostFeatures;
+		if (sys::getHostCPUFeatures(hostFeatures))
+		{
+			for (auto& feature : hostFeatures)
+			{
+				features.AddFeature(feature.first(), feature.second);
+			}
+		}
+	}
+	
+	TargetOptions targetOptions;
+	std::unique_ptr<TargetMachine> machine(
+		theTarget->createTargetMachine(triple.getTriple(), cpu, features.getString(),
+									   targetOptions, Reloc::Default, CodeModel::Default,
+									   target.mOptimize ? CodeGenOpt::Default : CodeGenOpt::None));
+	if (!machine)
+	{
+		error = "Unable to create a target machine for " + triple.getTriple() + ".";
+		return false;
+	}
+	
+	mContext.mModule->setTargetTriple(triple.getTriple());
+	if (const DataLayout* layout = machine->getSubtargetImpl()->getDataLayout())
+	{
+		mContext.mModule->setDataLayout(layout);
+	}
+	
+	legacy::PassManager pm;
+	pm.add(new TargetLibraryInfo(triple));
+	pm.add(new DataLayoutPass(mContext.mModule));
+	
+	{
+		formatted_raw_ostream formattedOutput(output);
+		TargetMachine::CodeGenFileType fileType = assembly ?
+			TargetMachine::CGFT_AssemblyFile : TargetMachine::CGFT_ObjectFile;
+		if (machine->addPassesToEmitFile(pm, formattedOutput, fileType))
+		{
+			error = "The target can't emit this file type.";
+			return false;
+		}
+		
+		pm.run(*mContext.mModule);
+	}
+	
+	return true;
+}
+
+bool Emitter::link(Emitter& other, std::string& error) noexcept
+{
+	PhaseScope timeLink("link");
+	spliceCachedFunctions();
+	Module* source = other.releaseModule();
+	bool failed = Linker::LinkModules(mContext.mModule, source,
+									  Linker::DestroySource, &error);
+	delete source;
+	return !failed;
+}
+
+Module* Emitter::releaseModule() noexcept
+{
+	spliceCachedFunctions();
+	Module* module = mContext.mModule;
+	mContext.mModule = nullptr;
+	return module;
+}
@@ -22,6 +22,21 @@
 
 #include "Types.h"
 #include "../opt/SSABuilder.h"
+#include <functional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm
+{
+	class raw_ostream;
+	class Module;
+	namespace legacy
+	{
+		class PassManager;
+	}
+}
 
 namespace uscc
 {
@@ -30,15 +45,17 @@ namespace parse
 
 class StringTable;
 class Identifier;
+class ASTFunction;
 
 struct CodeContext
 {
-	CodeContext(StringTable& strings);
+	CodeContext(StringTable& strings, llvm::LLVMContext& global);
 	
 	// Used for our SSA construction algorithm
 	opt::SSABuilder mSSA;
 	
-	// Global context for LLVM
+	// Context for LLVM (the global one, unless the driver
+	// gave us a private context for this compile)
 	llvm::LLVMContext& mGlobal;
 	
 	// Module for this program
@@ -58,21 +75,159 @@ struct CodeContext
 	
 	// stores the current function
 	llvm::Function* mFunc;
+	
+	// Functions whose IR comes from the function cache
+	// (these are only declared)
+	std::set<const ASTFunction*> mCachedFuncs;
+	// Functions defined by the other files of a whole-program
+	// compile, which are only declared in this module
+	std::vector<Identifier*> mExternFuncs;
+};
+
+// Stores the optimized IR of single functions, so functions that
+// haven't changed since the last compile aren't emitted again.
+// Keys are hashes of ASTFunction::printStructure.
+class FunctionCache
+{
+public:
+	virtual ~FunctionCache() { }
+	
+	// If there's an entry for key, sets bitcode and returns true
+	virtual bool load(const std::string& key, std::string& bitcode) = 0;
+	
+	// Adds the bitcode (a module that defines one function) under key
+	virtual void store(const std::string& key, const std::string& bitcode) = 0;
+	
+	// Drops the entry for key (its bitcode couldn't be used)
+	virtual void remove(const std::string& key) = 0;
 };
 
 class Parser;
 
+// Controls native code generation (see Emitter::writeAsm)
+struct NativeTarget
+{
+	NativeTarget()
+	: mOptimize(false)
+	{ }
+	
+	// Architecture, such as "x86-64" (empty for the host's)
+	std::string mArch;
+	// CPU, such as "corei7" (empty for a generic CPU, or
+	// "native" for the host's CPU and its features)
+	std::string mCPU;
+	// Run the code generator's optimizations
+	bool mOptimize;
+};
+
 class Emitter
 {
 public:
+	// Emits into LLVM's global context
 	Emitter(Parser& parser) noexcept;
-	void optimize() noexcept;
+	// Emits into the requested context, so several Emitters can
+	// run on different threads at once
+	Emitter(Parser& parser, llvm::LLVMContext& context) noexcept;
+	// Functions that are in funcCache aren't emitted. Their IR is
+	// linked in once the emitted functions are optimized (or as soon
+	// as the module is printed, verified or written).
+	Emitter(Parser& parser, llvm::LLVMContext& context,
+			FunctionCache* funcCache) noexcept;
+	// Deletes the module (must happen before the context goes away)
+	~Emitter() noexcept;
+	// With a nonzero numThreads, optimize splits each function into a
+	// module (and LLVM context) of its own, runs the passes on the
+	// modules on numThreads threads, then joins them back together.
+	// The result doesn't depend on numThreads.
+	void setOptThreads(unsigned int numThreads) noexcept;
+	// If the last optimize couldn't split the module, this says why
+	// (the module was then optimized as a whole). Empty otherwise.
+	const std::string& getSplitError() const noexcept;
+	// Set if a function from the function cache couldn't be linked in.
+	// It's left as a declaration, so verify fails. Empty otherwise.
+	const std::string& getCacheError() const noexcept;
+	// Runs the passes of an optimization level (1 to 3)
+	void optimize(unsigned int level = 1) noexcept;
+	// Runs the passes named in pipeline (see opt::registerOptPipeline).
+	// Returns false (and sets badName) if a name isn't a known pass.
+	bool optimize(const std::string& pipeline, std::string& badName) noexcept;
 	void print() noexcept;
+	void print(llvm::raw_ostream& output) noexcept;
 	void writeBitcode(const char* fileName) noexcept;
+	void writeBitcode(llvm::raw_ostream& output) noexcept;
 	bool verify() noexcept;
-	bool writeAsm(const char* fileName) noexcept;
+	// Write native assembly or an object file through an LLVM
+	// TargetMachine. Return false and set error on failure.
+	bool writeAsm(const char* fileName, const NativeTarget& target,
+				  std::string& error) noexcept;
+	bool writeObject(const char* fileName, const NativeTarget& target,
+					 std::string& error) noexcept;
+	bool writeAsm(llvm::raw_ostream& output, const NativeTarget& target,
+				  std::string& error) noexcept;
+	bool writeObject(llvm::raw_ostream& output, const NativeTarget& target,
+					 std::string& error) noexcept;
+	// Selects the register allocator used by native code
+	// generation, by the name it's registered under ("uscc",
+	// "basic", "fast", "greedy" or "pbqp"). This is global, so
+	// set it before any compile starts.
+	// Returns false if there's no allocator with this name.
+	static bool setRegisterAllocator(const std::string& name) noexcept;
+	// Links the module of other (which must use the same context)
+	// into this one, for whole-program compiles. other can't be
+	// used after this.
+	// Returns false (and sets error) if the modules conflict.
+	bool link(Emitter& other, std::string& error) noexcept;
+	// Hands ownership of the module to the caller.
+	// The Emitter can't be used after this.
+	llvm::Module* releaseModule() noexcept;
 private:
+	// Disallow copy/assignment
+	Emitter(const Emitter& copy);
+	Emitter& operator=(const Emitter& rhs);
+	
+	// Kicks off the IR generation for the parsed program
+	void emitProgram(Parser& parser) noexcept;
+	
+	// Adds the passes to run to a pass manager
+	typedef std::function<void(llvm::legacy::PassManager&)> PassAdder;
+	
+	// Runs the passes (called by optimize)
+	void runOptPasses(const PassAdder& addPasses) noexcept;
+	
+	// runOptPasses with setOptThreads. Returns false (and sets error)
+	// without changing the module if a function can't be joined back.
+	bool runOptPassesSplit(const PassAdder& addPasses, std::string& error) noexcept;
+	
+	// Shared implementation of writeAsm/writeObject
+	bool writeNative(const char* fileName, const NativeTarget& target,
+					 bool assembly, std::string& error) noexcept;
+	bool writeNative(llvm::raw_ostream& output, const NativeTarget& target,
+					 bool assembly, std::string& error) noexcept;
+	
+	// Looks up every function in the function cache
+	void loadCachedFunctions(Parser& parser) noexcept;
+	
+	// Adds the functions we emitted to the function cache, then
+	// links in the cached ones (only does anything the first time)
+	void spliceCachedFunctions() noexcept;
+	
 	CodeContext mContext;
+	
+	// null if there's no function cache
+	FunctionCache* mFuncCache;
+	// Name and key of each function we emitted
+	std::vector<std::pair<std::string, std::string>> mEmittedFuncs;
+	// Key and module (with the IR) of each cached function
+	std::vector<std::pair<std::string, llvm::Module*>> mCachedModules;
+	// Why a cached function couldn't be linked in
+	std::string mCacheError;
+	// Whether spliceCachedFunctions has run
+	bool mSpliced;
+	
+	// Threads for optimize (0 to optimize the module as a whole)
+	unsigned int mOptThreads;
+	// Why the last optimize couldn't split the module
+	std::string mSplitError;
 };
 
 } // uscc
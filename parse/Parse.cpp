@@ -15,12 +15,15 @@
 //---------------------------------------------------------
 
 #include "Parse.h"
-#include <FlexLexer.h>
+#include "ASTFile.h"
 #include "Symbols.h"
+#include "../scan/TokenPipeline.h"
+#include "../support/Parallel.h"
 
 // Used if you want to see each token
 #define DEBUG_PRINT_TOKENS 0
 #include <sstream>
+#include <unordered_set>
 
 #if DEBUG_PRINT_TOKENS
 #include <iostream>
@@ -28,44 +31,252 @@
 
 using namespace uscc::parse;
 using namespace uscc::scan;
-using std::shared_ptr;
-using std::make_shared;
 
 // Constructor takes in a file name and performs the parse
 Parser::Parser(const char* fileName, std::ostream* errStream,
-			   std::ostream* ASTStream, bool outputSymbols)
-: mCurrToken(Token::Unknown)
+			   std::ostream* ASTStream, bool outputSymbols, bool pipelineScan,
+			   unsigned int parseThreads)
+: mRoot(nullptr)
+, mCurrToken(Token::Unknown)
+, mTokenIndex(0)
+, mNextTokenIndex(0)
+, mTokenEnd(static_cast<size_t>(-1))
+, mTokenTextIndex(static_cast<size_t>(-1))
 , mFileName(fileName)
-, mFileStream(fileName)
+, mSourceBegin(nullptr)
+, mSourceEnd(nullptr)
+, mSourceStream(nullptr)
 , mErrStream(errStream)
 , mASTStream(ASTStream)
+, mCurrFunction(nullptr)
 , mLineNumber(1)
 , mColNumber(1)
-, mUnusedIdent(nullptr)
+, mNumSyntaxErrors(0)
 , mNeedPrintf(false)
 , mCheckSemant(true) // PA2: Change to true
 , mOutputSymbols(outputSymbols)
+, mMode(ParseMode::Full)
+, mPipelineScan(pipelineScan)
+, mParseThreads(parseThreads)
 {
-	if (mFileStream.is_open())
+	// Scanning a mapped file skips the istream (and flex's
+	// buffering), so only fall back to a stream if we have to
+	mMappedFile.reset(new scan::MappedFile(fileName));
+	if (mMappedFile->isMapped())
 	{
-		mLexer = new yyFlexLexer(&mFileStream);
-				
-		try
+		mSourceBegin = mMappedFile->getData();
+		mSourceEnd = mSourceBegin + mMappedFile->getSize();
+	}
+	else
+	{
+		mMappedFile.reset();
+		mFileStream.open(fileName);
+		if (!mFileStream.is_open())
 		{
-			// Get the first token
-			consumeToken();
+			throw FileNotFound();
+		}
+		mSourceStream = &mFileStream;
+	}
+	
+	parse();
+}
+
+// Performs the parse on source that's in memory
+Parser::Parser(const char* fileName, const char* begin, const char* end,
+			   std::ostream* errStream, std::ostream* ASTStream, bool outputSymbols,
+			   bool pipelineScan, unsigned int parseThreads)
+: mRoot(nullptr)
+, mCurrToken(Token::Unknown)
+, mTokenIndex(0)
+, mNextTokenIndex(0)
+, mTokenEnd(static_cast<size_t>(-1))
+, mTokenTextIndex(static_cast<size_t>(-1))
+, mFileName(fileName)
+, mSourceBegin(begin)
+, mSourceEnd(end)
+, mSourceStream(nullptr)
+, mErrStream(errStream)
+, mASTStream(ASTStream)
+, mCurrFunction(nullptr)
+, mLineNumber(1)
+, mColNumber(1)
+, mNumSyntaxErrors(0)
+, mNeedPrintf(false)
+, mCheckSemant(true)
+, mOutputSymbols(outputSymbols)
+, mMode(ParseMode::Full)
+, mPipelineScan(pipelineScan)
+, mParseThreads(parseThreads)
+{
+	parse();
+}
 
-			// Now start the parse
-			mRoot = parseProgram();
+// Performs the parse on source that's already open
+Parser::Parser(const char* fileName, std::istream& source, std::ostream* errStream,
+			   std::ostream* ASTStream, bool outputSymbols)
+: Parser(fileName, source, errStream, ASTStream, outputSymbols, ParseMode::Full,
+		 std::vector<ASTFunction*>())
+{
+	
+}
+
+// Performs the parse of one file of a whole-program compile
+Parser::Parser(const char* fileName, std::istream& source, std::ostream* errStream,
+			   std::ostream* ASTStream, bool outputSymbols, ParseMode mode,
+			   const std::vector<ASTFunction*>& externs)
+: mRoot(nullptr)
+, mCurrToken(Token::Unknown)
+, mTokenIndex(0)
+, mNextTokenIndex(0)
+, mTokenEnd(static_cast<size_t>(-1))
+, mTokenTextIndex(static_cast<size_t>(-1))
+, mFileName(fileName)
+, mSourceBegin(nullptr)
+, mSourceEnd(nullptr)
+, mSourceStream(&source)
+, mErrStream(errStream)
+, mASTStream(ASTStream)
+, mCurrFunction(nullptr)
+, mLineNumber(1)
+, mColNumber(1)
+, mNumSyntaxErrors(0)
+, mNeedPrintf(false)
+, mCheckSemant(mode == ParseMode::Full)
+, mOutputSymbols(outputSymbols)
+, mMode(mode)
+, mPipelineScan(false)
+, mParseThreads(0)
+{
+	declareExterns(externs);
+	parse();
+}
+
+// Parses some of the functions of parent's tokens
+Parser::Parser(const Parser& parent, size_t begin, size_t end, ParseMode mode,
+			   const std::vector<ASTFunction*>& externs)
+: mRoot(nullptr)
+, mTokens(parent.mTokens)
+, mCurrToken(Token::Unknown)
+, mTokenIndex(begin)
+, mNextTokenIndex(begin)
+, mTokenEnd(end)
+, mTokenTextIndex(static_cast<size_t>(-1))
+, mFileName(parent.mFileName)
+, mSourceBegin(nullptr)
+, mSourceEnd(nullptr)
+, mSourceStream(nullptr)
+, mErrStream(nullptr)
+, mASTStream(nullptr)
+, mCurrFunction(nullptr)
+, mLineNumber(1)
+, mColNumber(1)
+, mNumSyntaxErrors(0)
+, mNeedPrintf(false)
+, mCheckSemant(mode == ParseMode::Full)
+, mOutputSymbols(false)
+, mMode(mode)
+, mPipelineScan(false)
+, mParseThreads(0)
+{
+	declareExterns(externs);
+	parseTokens();
+}
+
+// Loads a file saved with --emit-ast
+Parser::Parser(ASTReader& reader, std::ostream* errStream,
+			   std::ostream* ASTStream, bool outputSymbols)
+: mRoot(nullptr)
+, mCurrToken(Token::EndOfFile)
+, mTokenIndex(0)
+, mNextTokenIndex(0)
+, mTokenEnd(static_cast<size_t>(-1))
+, mTokenTextIndex(static_cast<size_t>(-1))
+, mFileName(reader.getFileName())
+, mSourceBegin(nullptr)
+, mSourceEnd(nullptr)
+, mSourceStream(nullptr)
+, mErrStream(errStream)
+, mASTStream(ASTStream)
+, mCurrFunction(nullptr)
+, mLineNumber(1)
+, mColNumber(1)
+, mNumSyntaxErrors(0)
+, mNeedPrintf(false)
+, mCheckSemant(true)
+, mOutputSymbols(outputSymbols)
+, mMode(ParseMode::Full)
+, mPipelineScan(false)
+, mParseThreads(0)
+{
+	{
+		// Loading the file replaces the scan and the parse
+		support::PhaseScope timeLoad("load AST");
+		reader.read(*this);
+	}
+	
+	printProgram();
+}
+
+// Declares the functions other parsers made in the global scope
+void Parser::declareExterns(const std::vector<ASTFunction*>& externs)
+{
+	// The functions of the other files go in the global scope,
+	// just like the functions of this file
+	for (auto func : externs)
+	{
+		Identifier* ident = mSymbols.createIdentifier(func->getIdent().getName());
+		ident->setType(Type::Function);
+		ident->setFunction(func);
+		mExterns.push_back(ident);
+	}
+}
+
+// Runs the parse on the source in memory, or on mSourceStream
+// (called by the constructors)
+void Parser::parse()
+{
+	{
+		// Lex everything up front, so the parser can look ahead
+		// as far as it needs to
+		support::PhaseScope timeScan("scan");
+		if (!mSourceStream && mPipelineScan)
+		{
+			// Or lex on another thread, while the parse runs
+			std::unique_ptr<scan::TokenPipeline> pipeline(
+				new scan::TokenPipeline(mSourceBegin, mSourceEnd));
+			mTokens.reset(new scan::TokenBuffer(std::move(pipeline), mSourceBegin));
 		}
-		catch (ParseExcept& e)
+		else if (!mSourceStream)
 		{
-			reportError(e);
+			scan::MemoryScanner lexer(mSourceBegin, mSourceEnd);
+			mTokens.reset(new scan::TokenBuffer(lexer));
+		}
+		else
+		{
+			scan::FlexScanner lexer(mSourceStream);
+			mTokens.reset(new scan::TokenBuffer(lexer));
 		}
 	}
-	else
+	
 	{
-		throw FileNotFound();
+		// Semantic checks are interleaved with the parse,
+		// so they're included in this phase
+		support::PhaseScope timeParse("parse");
+		if (mParseThreads > 1)
+		{
+			// The functions are split up by their tokens,
+			// so they all have to be lexed first
+			mTokens->finish();
+		}
+		
+		if (mParseThreads <= 1 || !parseInParallel())
+		{
+			parseTokens();
+		}
+		
+		// Wait for a pipelined lexer to finish, so the
+		// lines are there for the diagnostics
+		mTokens->finish();
 	}
 	
 	if (!IsValid())
@@ -74,10 +285,208 @@ Parser::Parser(const char* fileName, std::ostream* errStream,
 	}
 }
 
+// Parses the program from the current token on
+void Parser::parseTokens()
+{
+	try
+	{
+		// Get the first token
+		consumeToken();
+		
+		// Now start the parse
+		mRoot = parseProgram();
+	}
+	catch (ParseExcept& e)
+	{
+		reportError(e);
+	}
+	
+	printProgram();
+}
+
+// Parses groups of functions on mParseThreads threads
+bool Parser::parseInParallel()
+{
+	// Find where each function ends, by matching the braces
+	// (the EndOfFile is left out)
+	size_t numTokens = mTokens->size() - 1;
+	std::vector<size_t> funcEnds;
+	int depth = 0;
+	for (size_t i = 0; i < numTokens; i++)
+	{
+		Token::Tokens token = mTokens->getKind(i);
+		if (token == Token::LBrace)
+		{
+			depth++;
+		}
+		else if (token == Token::RBrace)
+		{
+			depth--;
+			if (depth < 0)
+			{
+				return false;
+			}
+			else if (depth == 0)
+			{
+				funcEnds.push_back(i + 1);
+			}
+		}
+	}
+	
+	if (depth != 0 || funcEnds.size() < 2)
+	{
+		return false;
+	}
+	// Anything after the last function is parsed with it
+	funcEnds.back() = numTokens;
+	
+	// Each group ends at the first function that reaches its
+	// share of the tokens
+	std::vector<size_t> groupEnds;
+	for (size_t end : funcEnds)
+	{
+		size_t share = numTokens * (groupEnds.size() + 1) / mParseThreads;
+		if (end >= share || end == numTokens)
+		{
+			groupEnds.push_back(end);
+		}
+	}
+	
+	size_t numGroups = groupEnds.size();
+	if (numGroups < 2)
+	{
+		return false;
+	}
+	
+	// First find the signatures of each group's functions
+	std::vector<std::unique_ptr<Parser>> signatures(numGroups);
+	support::parallelFor(numGroups, mParseThreads, [&](size_t i)
+	{
+		size_t begin = (i == 0) ? 0 : groupEnds[i - 1];
+		signatures[i].reset(new Parser(*this, begin, groupEnds[i], ParseMode::Signatures,
+									   std::vector<ASTFunction*>()));
+	});
+	
+	// Each group can call the functions of the groups before it.
+	// If a name is defined twice, the first one counts (the later
+	// one is reported as a redeclaration, as usual).
+	std::vector<std::vector<ASTFunction*>> externs(numGroups);
+	std::unordered_set<std::string> names;
+	for (size_t i = 0; i < numGroups; i++)
+	{
+		if (signatures[i]->mNumSyntaxErrors != 0)
+		{
+			return false;
+		}
+		
+		if (i + 1 < numGroups)
+		{
+			externs[i + 1] = externs[i];
+			for (auto func : signatures[i]->GetFunctions())
+			{
+				if (names.insert(func->getIdent().getName()).second)
+				{
+					externs[i + 1].push_back(func);
+				}
+			}
+		}
+	}
+	
+	// Now parse and check the groups for real
+	std::vector<std::unique_ptr<Parser>> groups(numGroups);
+	support::parallelFor(numGroups, mParseThreads, [&](size_t i)
+	{
+		size_t begin = (i == 0) ? 0 : groupEnds[i - 1];
+		groups[i].reset(new Parser(*this, begin, groupEnds[i], ParseMode::Full, externs[i]));
+	});
+	
+	for (auto& group : groups)
+	{
+		if (group->mNumSyntaxErrors != 0)
+		{
+			return false;
+		}
+	}
+	
+	// Merge the groups, in order
+	mRoot = mArena.make<ASTProgram>();
+	for (auto& group : groups)
+	{
+		for (auto func : group->mRoot->getFunctions())
+		{
+			mRoot->addFunction(mArena, func);
+			if (!func->getIdent().isDummy())
+			{
+				mSymbols.importIdentifier(&func->getIdent());
+			}
+		}
+		mSymbols.importScopes(group->mSymbols);
+		mStrings.merge(group->mStrings);
+		mErrors.splice(mErrors.end(), group->mErrors);
+		mNeedPrintf = mNeedPrintf || group->mNeedPrintf;
+	}
+	
+	// The functions a group called from the groups before it were the
+	// ones of the signature parse, so point them at the real ones
+	for (auto& group : groups)
+	{
+		for (auto ident : group->mExterns)
+		{
+			Identifier* func = mSymbols.getIdentifier(ident->getName());
+			ident->setFunction(func->getFunction());
+			ident->setAlias(func);
+		}
+		group->mSymbols.getIdentifier("printf")->setAlias(mSymbols.getIdentifier("printf"));
+	}
+	
+	mChunks = std::move(groups);
+	printProgram();
+	return true;
+}
+
+// Writes out the AST (and symbols) of a successful parse
+void Parser::printProgram() noexcept
+{
+	if (mRoot && IsValid() && mASTStream)
+	{
+		mRoot->printNode((*mASTStream));
+		if (mOutputSymbols)
+		{
+			mSymbols.print((*mASTStream));
+		}
+	}
+}
+
 // Destructor not virtual; I don't expect any inheritance
 Parser::~Parser()
 {
-	delete mLexer;
+	
+}
+
+std::vector<ASTFunction*> Parser::GetFunctions() const noexcept
+{
+	std::vector<ASTFunction*> retVal;
+	if (mRoot)
+	{
+		for (auto func : mRoot->getFunctions())
+		{
+			if (!func->getIdent().isDummy())
+			{
+				retVal.push_back(func);
+			}
+		}
+	}
+	return retVal;
+}
+
+std::string Parser::GetSourceLine(int line) const
+{
+	if (!mTokens || line <= 0)
+	{
+		return std::string();
+	}
+	
+	return mTokens->getLineText(static_cast<size_t>(line));
 }
 
 // Returns the string for the current token's text
@@ -86,12 +495,50 @@ const char* Parser::getTokenTxt() const noexcept
 	const char* retVal = "";
 	if (mCurrToken != Token::Unknown && mCurrToken != Token::EndOfFile)
 	{
-		retVal = mLexer->YYText();
+		retVal = getCurrentText();
 	}
 	
 	return retVal;
 }
 
+// Returns the text of the current token, whatever kind it is
+const char* Parser::getCurrentText() const noexcept
+{
+	// The buffer's text isn't null terminated, so copy it once per token
+	if (mTokenTextIndex != mTokenIndex)
+	{
+		mTokenText = mTokens->getText(mTokenIndex);
+		mTokenTextIndex = mTokenIndex;
+	}
+	
+	return mTokenText.c_str();
+}
+
+// Returns a view of the current token's text in the source
+llvm::StringRef Parser::getTokenRef() const noexcept
+{
+	if (mCurrToken == Token::Unknown || mCurrToken == Token::EndOfFile)
+	{
+		return llvm::StringRef();
+	}
+	
+	return llvm::StringRef(mTokens->getTextStart(mTokenIndex),
+						   mTokens->getLength(mTokenIndex));
+}
+
+// Returns the token ahead tokens after the current one
+// (EndOfFile if that's past the end)
+Token::Tokens Parser::peekToken(size_t ahead) const noexcept
+{
+	size_t index = mTokenIndex + ahead;
+	if (index >= mTokenEnd || !mTokens->has(index))
+	{
+		return Token::EndOfFile;
+	}
+	
+	return mTokens->getKind(index);
+}
+
 // Consumes the current token, and moves to the next
 // token that's not a NewLine or Comment.
 //
@@ -99,64 +546,38 @@ const char* Parser::getTokenTxt() const noexcept
 // if unknownIsExcept is true
 void Parser::consumeToken(bool unknownIsExcept)
 {
-	// Add to the column number once we move past
-	// this token.
-	if (mCurrToken != Token::Unknown)
-	{
-		int len = Token::Lengths[mCurrToken];
-		if (len != -1)
-		{
-			mColNumber += len;
-		}
-		else
-		{
-			mColNumber += mLexer->YYLeng();
-		}
-	}
-	
 	do
 	{
-		mCurrToken = static_cast<Token::Tokens>(mLexer->yylex());
-#if DEBUG_PRINT_TOKENS
-		if (mCurrToken == Token::Comment)
+		// Once we reach the EndOfFile at the end of the buffer
+		// (or mTokenEnd), stay there
+		if (mNextTokenIndex <= mTokenEnd && mTokens->has(mNextTokenIndex))
 		{
-			std::cout << Token::Names[mCurrToken] << ": " << mLexer->YYText();
-		}
-		else if (mCurrToken != Token::Newline && mCurrToken != Token::Space &&
-				 mCurrToken != Token::Tab)
-		{
-			std::cout << Token::Names[mCurrToken] << ": " << mLexer->YYText() << "\n";
+			mTokenIndex = mNextTokenIndex++;
 		}
+		
+		mCurrToken = (mTokenIndex < mTokenEnd) ? mTokens->getKind(mTokenIndex) : Token::EndOfFile;
+		mLineNumber = mTokens->getLine(mTokenIndex);
+		mColNumber = mTokens->getColumn(mTokenIndex);
+#if DEBUG_PRINT_TOKENS
+		std::cout << Token::Names[mCurrToken] << ": " << getCurrentText() << "\n";
 #endif
-		if (mCurrToken == Token::Newline || mCurrToken == Token::Comment)
-		{
-			mLineNumber++;
-			mColNumber = 1;
-		}
-		else if (mCurrToken == Token::Space || mCurrToken == Token::Tab)
-		{
-			mColNumber++;
-		}
-		else if (mCurrToken == Token::Unknown)
+		if (mCurrToken == Token::Unknown)
 		{
 			// We don't want to always throw an exception, in case we are in
 			// error recovery mode.
 			if (unknownIsExcept)
 			{
-				throw UnknownToken(mLexer->YYText(), mColNumber);
+				throw UnknownToken(getCurrentText(), mColNumber);
 			}
 			else
 			{
 				std::string msg("Invalid symbol: ");
-				msg += mLexer->YYText();
+				msg += getCurrentText();
 				reportError(msg);
-				mColNumber++;
 			}
 		}
 	}
-	while(mCurrToken == Token::Newline || mCurrToken == Token::Comment ||
-		  mCurrToken == Token::Space || mCurrToken == Token::Tab ||
-		  mCurrToken == Token::Unknown);
+	while (mCurrToken == Token::Unknown);
 }
 
 // Sees if the token matches the requested.
@@ -238,6 +659,29 @@ void Parser::consumeUntil(Token::Tokens desired) noexcept
 	}
 }
 
+// Consumes a { ... } block, including any nested blocks
+void Parser::skipBlock()
+{
+	matchToken(Token::LBrace);
+	int depth = 1;
+	while (depth > 0)
+	{
+		if (peekToken() == Token::EndOfFile)
+		{
+			throw EOFExcept();
+		}
+		else if (peekToken() == Token::LBrace)
+		{
+			depth++;
+		}
+		else if (peekToken() == Token::RBrace)
+		{
+			depth--;
+		}
+		consumeToken(false);
+	}
+}
+
 // consumeUntil for a list of tokens
 //
 // Throws an exception if next token is Unknown
@@ -269,11 +713,13 @@ void Parser::reportError(const ParseExcept& except) noexcept
 	std::stringstream errStrm;
 	except.printException(errStrm);
 	mErrors.push_back(std::make_shared<Error>(errStrm.str(), mLineNumber, mColNumber));
+	mNumSyntaxErrors++;
 }
 			
 void Parser::reportError(const std::string& msg) noexcept
 {
 	mErrors.push_back(std::make_shared<Error>(msg, mLineNumber, mColNumber));
+	mNumSyntaxErrors++;
 }
 	
 void Parser::reportSemantError(const std::string& msg, int colOverride, int lineOverride) noexcept
@@ -300,7 +746,7 @@ void Parser::reportSemantError(const std::string& msg, int colOverride, int line
 			line = lineOverride;
 		}
 		
-		mErrors.push_back(make_shared<Error>(msg, line, col));
+		mErrors.push_back(std::make_shared<Error>(msg, line, col));
 	}
 }
 
@@ -328,27 +774,22 @@ void Parser::displayErrorMsg(const std::string& line, std::shared_ptr<Error> err
 	
 void Parser::displayErrors() noexcept
 {
+	if (!mErrStream)
+	{
+		return;
+	}
+	
 	// Output errors
-	// Move the filestream back to the start
-	int lineNum = 0;
-	std::string lineTxt;
-	mFileStream.clear();
-	mFileStream.seekg(0, std::ios::beg);
+	// (the lines come from the token buffer's copy of the source)
 	for (auto i = mErrors.begin();
 		 i != mErrors.end();
 		 ++i)
 	{
-		while (lineNum < (*i)->mLineNum)
-		{
-			std::getline(mFileStream, lineTxt);
-			lineNum++;
-		}
-		
-		displayErrorMsg(lineTxt, *i);
+		displayErrorMsg(GetSourceLine((*i)->mLineNum), *i);
 	}
 }
 
-Identifier* Parser::getVariable(const char* name) noexcept
+Identifier* Parser::getVariable(llvm::StringRef name) noexcept
 {
 	// PA2: Implement properly
 	
@@ -386,18 +827,18 @@ const char* Parser::getTypeText(Type type) const noexcept
 // Takes the expression, and if it's a char expression, converts it to an int type
 // expression.
 // Otherwise it doesn't do anything.
-std::shared_ptr<ASTExpr> Parser::charToInt(std::shared_ptr<ASTExpr> expr) noexcept
+ASTExpr* Parser::charToInt(ASTExpr* expr) noexcept
 {
-	std::shared_ptr<ASTExpr> retVal;
-	std::shared_ptr<ASTConstantExpr> constExpr;
-	std::shared_ptr<ASTToIntExpr> toIntExpr;
+	ASTExpr* retVal = nullptr;
+	ASTConstantExpr* constExpr = nullptr;
+	ASTToIntExpr* toIntExpr = nullptr;
 	
-	if ((constExpr = std::dynamic_pointer_cast<ASTConstantExpr>(expr))) {
+	if ((constExpr = dynamic_cast<ASTConstantExpr*>(expr))) {
 		constExpr->changeToInt();
 		retVal = constExpr;
 	} else {
 		if (expr->getType() == Type::Char) {
-			toIntExpr = make_shared<ASTToIntExpr>(expr);
+			toIntExpr = mArena.make<ASTToIntExpr>(expr);
 			retVal = toIntExpr;
 		} else {
 			retVal = expr;
@@ -408,18 +849,18 @@ std::shared_ptr<ASTExpr> Parser::charToInt(std::shared_ptr<ASTExpr> expr) noexce
 }
 
 // Like the above, but in reverse
-std::shared_ptr<ASTExpr> Parser::intToChar(std::shared_ptr<ASTExpr> expr) noexcept
+ASTExpr* Parser::intToChar(ASTExpr* expr) noexcept
 {
-	std::shared_ptr<ASTExpr> retVal;
-	std::shared_ptr<ASTConstantExpr> constExpr;
-	std::shared_ptr<ASTToCharExpr> toCharExpr;
+	ASTExpr* retVal = nullptr;
+	ASTConstantExpr* constExpr = nullptr;
+	ASTToCharExpr* toCharExpr = nullptr;
 	
-	if ((constExpr = std::dynamic_pointer_cast<ASTConstantExpr>(expr))) {
+	if ((constExpr = dynamic_cast<ASTConstantExpr*>(expr))) {
 		constExpr->changeToChar();
 		retVal = constExpr;
 	} else {
 		if (expr->getType() == Type::Int) {
-			toCharExpr = make_shared<ASTToCharExpr>(expr);
+			toCharExpr = mArena.make<ASTToCharExpr>(expr);
 			retVal = toCharExpr;
 		} else {
 			retVal = expr;
@@ -432,16 +873,16 @@ std::shared_ptr<ASTExpr> Parser::intToChar(std::shared_ptr<ASTExpr> expr) noexce
 }
 
 // The entry point for the parser
-shared_ptr<ASTProgram> Parser::parseProgram()
+ASTProgram* Parser::parseProgram()
 {
 	// Create our base program node.
-	shared_ptr<ASTProgram> retVal = make_shared<ASTProgram>();
+	ASTProgram* retVal = mArena.make<ASTProgram>();
 	
-	shared_ptr<ASTFunction> func = parseFunction();
+	ASTFunction* func = parseFunction();
 	
 	while (func)
 	{
-		retVal->addFunction(func);
+		retVal->addFunction(mArena, func);
 		func = parseFunction();
 	}
 	
@@ -450,24 +891,12 @@ shared_ptr<ASTProgram> Parser::parseProgram()
 		reportError("Expected end of file");
 	}
 	
-	if (IsValid())
-	{
-		if (mASTStream)
-		{
-			retVal->printNode((*mASTStream));
-			if (mOutputSymbols)
-			{
-				mSymbols.print((*mASTStream));
-			}
-		}
-	}
-	
 	return retVal;
 }
 	
-shared_ptr<ASTFunction> Parser::parseFunction()
+ASTFunction* Parser::parseFunction()
 {
-	shared_ptr<ASTFunction> retVal;
+	ASTFunction* retVal = nullptr;
 	
 	// Check for a return type
 	if (peekIsOneOf({Token::Key_void, Token::Key_int, Token::Key_char}))
@@ -528,7 +957,7 @@ shared_ptr<ASTFunction> Parser::parseFunction()
 		else
 		{
 			// We're making a new function, see if it's valid to do so
-			if (mSymbols.isDeclaredInScope(getTokenTxt()))
+			if (mSymbols.isDeclaredInScope(getTokenRef()))
 			{
 				// Invalid redeclaration
 				std::string err = "Invalid redeclaration of function '";
@@ -541,7 +970,7 @@ shared_ptr<ASTFunction> Parser::parseFunction()
 			}
 			else
 			{
-				ident = mSymbols.createIdentifier(getTokenTxt());
+				ident = mSymbols.createIdentifier(getTokenRef());
 				ident->setType(Type::Function);
 				
 				if (ident->getName() == "main" && retType != Type::Int)
@@ -557,7 +986,8 @@ shared_ptr<ASTFunction> Parser::parseFunction()
 		// since arguments count as the function's main body scope
 		SymbolTable::ScopeTable* table = mSymbols.enterScope();
 		
-		retVal = make_shared<ASTFunction>(*ident, retType, *table);
+		retVal = mArena.make<ASTFunction>(*ident, retType, *table);
+		mCurrFunction = retVal;
 		
 		// If this isn't the dummy function, hook up the node
 		if (!ident->isDummy())
@@ -569,10 +999,10 @@ shared_ptr<ASTFunction> Parser::parseFunction()
 		{
 			try
 			{
-				shared_ptr<ASTArgDecl> arg = parseArgDecl();
+				ASTArgDecl* arg = parseArgDecl();
 				while (arg)
 				{
-					retVal->addArg(arg);
+					retVal->addArg(mArena, arg);
 					if (peekAndConsume(Token::Comma))
 					{
 						arg = parseArgDecl();
@@ -617,10 +1047,19 @@ shared_ptr<ASTFunction> Parser::parseFunction()
 		}
 		
 		// Grab the compound statement for this function
-		shared_ptr<ASTCompoundStmt> funcCompoundStmt;
+		ASTCompoundStmt* funcCompoundStmt = nullptr;
 		try
 		{
-			funcCompoundStmt = parseCompoundStmt(true);
+			if (mMode == ParseMode::Signatures)
+			{
+				// Only the signature matters, so leave the body empty
+				skipBlock();
+				funcCompoundStmt = mArena.make<ASTCompoundStmt>();
+			}
+			else
+			{
+				funcCompoundStmt = parseCompoundStmt(true);
+			}
 		}
 		catch (ParseExcept& e)
 		{
@@ -651,9 +1090,9 @@ shared_ptr<ASTFunction> Parser::parseFunction()
 	return retVal;
 }
 	
-shared_ptr<ASTArgDecl> Parser::parseArgDecl()
+ASTArgDecl* Parser::parseArgDecl()
 {
-	shared_ptr<ASTArgDecl> retVal;
+	ASTArgDecl* retVal = nullptr;
 	
 	if (peekIsOneOf({Token::Key_int, Token::Key_char}))
 	{
@@ -682,7 +1121,7 @@ shared_ptr<ASTArgDecl> Parser::parseArgDecl()
 		// For now, set it to the default "error" until we see if this is a new
 		// identifier
 		Identifier* ident = mSymbols.getIdentifier("@@variable");
-		if (mSymbols.isDeclaredInScope(getTokenTxt()))
+		if (mSymbols.isDeclaredInScope(getTokenRef()))
 		{
 			std::string errMsg("Invalid redeclaration of argument '");
 			errMsg += getTokenTxt();
@@ -691,7 +1130,7 @@ shared_ptr<ASTArgDecl> Parser::parseArgDecl()
 		}
 		else
 		{
-			ident = mSymbols.createIdentifier(getTokenTxt());
+			ident = mSymbols.createIdentifier(getTokenRef());
 		}
 		
 		consumeToken();
@@ -711,7 +1150,7 @@ shared_ptr<ASTArgDecl> Parser::parseArgDecl()
 		}
 		ident->setType(varType);
 		
-		retVal = make_shared<ASTArgDecl>(*ident);
+		retVal = mArena.make<ASTArgDecl>(*ident);
 	}
 	
 	return retVal;
@@ -24,12 +24,16 @@
 #include <initializer_list>
 #include <fstream>
 #include <memory>
+#include <string>
 #include <list>
+#include <vector>
 #include "ASTNodes.h"
 #include "ParseExcept.h"
 #include "Symbols.h"
-
-class FlexLexer;
+#include "../support/Timing.h"
+#include "../scan/Lexer.h"
+#include "../scan/MappedFile.h"
+#include "../scan/TokenBuffer.h"
 
 namespace uscc
 {
@@ -37,13 +41,60 @@ namespace parse
 {
 	
 class Identifier;
+class ASTReader;
+
+// What a parse is for
+enum class ParseMode
+{
+	// Parse and check the whole file
+	Full,
+	// Only parse the function signatures, and skip the bodies.
+	// Used to find the functions each file of a whole-program
+	// compile defines.
+	Signatures
+};
 
 class Parser
 {
 	friend class Emitter;
+	friend class ASTWriter;
+	friend class ASTReader;
 public:
-	// Constructor takes in a file name and performs the parse
+	// Constructor takes in a file name and performs the parse.
+	// If pipelineScan is true, the file is lexed on another thread
+	// while the parse runs (unless the file can't be mapped).
+	// If parseThreads is more than 1, the functions are parsed and
+	// checked on up to that many threads (see parseInParallel).
 	Parser(const char* fileName, std::ostream* errStream,
+		   std::ostream* ASTStream, bool outputSymbols, bool pipelineScan = false,
+		   unsigned int parseThreads = 0);
+	
+	// Performs the parse on source that's already in memory, from begin
+	// up to end, the same way as a mapped file. The source has to outlive
+	// the Parser. The file name is only used for diagnostics.
+	Parser(const char* fileName, const char* begin, const char* end,
+		   std::ostream* errStream, std::ostream* ASTStream, bool outputSymbols,
+		   bool pipelineScan = false, unsigned int parseThreads = 0);
+	
+	// Performs the parse on source that's already open (for example, source
+	// that's in memory, or stdin). The file name is only used for diagnostics.
+	// The stream doesn't have to seek, since the lines with errors are
+	// shown from the lexed copy of the source.
+	Parser(const char* fileName, std::istream& source, std::ostream* errStream,
+		   std::ostream* ASTStream, bool outputSymbols);
+	
+	// As above, but externs are functions defined by the other files of a
+	// whole-program compile. They're declared before the parse starts, so
+	// this file can call them. (The parsers that made them must
+	// outlive this one.)
+	Parser(const char* fileName, std::istream& source, std::ostream* errStream,
+		   std::ostream* ASTStream, bool outputSymbols, ParseMode mode,
+		   const std::vector<ASTFunction*>& externs);
+	
+	// Loads the AST and symbols of a file saved with --emit-ast,
+	// instead of parsing source (see ASTFile.h).
+	// Throws BadASTFile if it isn't a valid AST file.
+	Parser(ASTReader& reader, std::ostream* errStream,
 		   std::ostream* ASTStream, bool outputSymbols);
 	
 	// Destructor not virtual; I don't expect any inheritance
@@ -60,18 +111,91 @@ public:
 		return mErrors.size();
 	}
 	
+	// Struct used to store an error
+	struct Error
+	{
+		Error(const std::string& msg, int lineNum, int colNum)
+		: mMsg(msg)
+		, mLineNum(lineNum)
+		, mColNum(colNum)
+		{ }
+		
+		std::string mMsg;
+		int mLineNum;
+		int mColNum;
+	};
+	
+	// Returns the errors in the order they were reported, so callers
+	// can inspect them without parsing the error stream
+	const std::list<std::shared_ptr<Error>>& GetErrors() const noexcept
+	{
+		return mErrors;
+	}
+	
+	// Returns the text of the line (from 1) of the source, without
+	// the newline, or an empty string if there's no such line
+	std::string GetSourceLine(int line) const;
+	
+	// Returns the functions this file defines
+	// (the dummy functions of bad declarations are left out)
+	std::vector<ASTFunction*> GetFunctions() const noexcept;
+	
 protected:
 	// Various helper functions
 	
+	// Parses the tokens from begin up to end of parent's token buffer,
+	// which have to be whole functions, after declaring externs.
+	// Nothing is written to a stream. (Used by parseInParallel.)
+	Parser(const Parser& parent, size_t begin, size_t end, ParseMode mode,
+		   const std::vector<ASTFunction*>& externs);
+	
+	// Runs the parse on the source in memory, or on mSourceStream
+	// (called by the constructors)
+	void parse();
+	
+	// Declares the functions other parsers made in the global scope
+	// (called by the constructors)
+	void declareExterns(const std::vector<ASTFunction*>& externs);
+	
+	// Parses the program from the current token on
+	void parseTokens();
+	
+	// Splits the functions into a group per thread, and parses and checks
+	// the groups at the same time. Each group's parser is first told the
+	// signatures of the functions before it, so the calls resolve just as
+	// they would in one parse. The groups are then merged into this parser,
+	// with their errors in source order.
+	// Returns false, having changed nothing, if the functions couldn't be
+	// split or there's a syntax error (since how a parse recovers from one
+	// depends on what came before it). The file should then be parsed
+	// the usual way.
+	bool parseInParallel();
+	
+	// Writes out the AST (and symbols) if the parse was successful
+	// and there's an AST stream
+	void printProgram() noexcept;
+	
 	// Returns the current token
 	scan::Token::Tokens peekToken() const noexcept
 	{
 		return mCurrToken;
 	}
 	
+	// Returns the token ahead tokens after the current one
+	// (EndOfFile if that's past the end)
+	scan::Token::Tokens peekToken(size_t ahead) const noexcept;
+	
 	// Returns the string for the current token's text
 	const char* getTokenTxt() const noexcept;
 	
+	// Returns the text of the current token, even if it's Unknown
+	const char* getCurrentText() const noexcept;
+	
+	// Returns a view of the current token's text in the source,
+	// without copying it (empty like getTokenTxt for Unknown and
+	// EndOfFile). The view is valid for the life of the parse.
+	llvm::StringRef getTokenRef() const noexcept;
+	
 	// Consumes the current token, and moves to the next
 	// token that's not a NewLine or Comment.
 	//
@@ -115,6 +239,10 @@ protected:
 	// Consumes tokens until either a match or EOF is found
 	void consumeUntil(scan::Token::Tokens desired) noexcept;
 	
+	// Consumes a { ... } block, including any nested blocks
+	// (used to skip function bodies in ParseMode::Signatures)
+	void skipBlock();
+	
 	// consumeUntil for a list of tokens
 	void consumeUntil(const std::initializer_list<scan::Token::Tokens>& list) noexcept;
 	
@@ -127,29 +255,16 @@ protected:
 	void reportSemantError(const std::string& msg, int colOverride = -1,
 						   int lineOverride = -1) noexcept;
 	
-	// Struct used to store an error
-	struct Error
-	{
-		Error(const std::string& msg, int lineNum, int colNum)
-		: mMsg(msg)
-		, mLineNum(lineNum)
-		, mColNum(colNum)
-		{ }
-		
-		std::string mMsg;
-		int mLineNum;
-		int mColNum;
-	};
-	
 	// Write an error message to the error stream
 	void displayErrorMsg(const std::string& line, std::shared_ptr<Error> error) noexcept;
 	
 	// Writes out all the error messages
+	// (Does nothing if there's no error stream)
 	void displayErrors() noexcept;
 	
 	// Gets the variable, if it exists. Otherwise
 	// reports a semant error and returns @@variable
-	Identifier* getVariable(const char* name) noexcept;
+	Identifier* getVariable(llvm::StringRef name) noexcept;
 	
 	// Returns a char* that contains the type name
 	const char* getTypeText(Type type) const noexcept;
@@ -157,95 +272,126 @@ protected:
 	// Takes the expression, and if it's an char expression, converts it to an int type
 	// expression.
 	// Otherwise it doesn't do anything.
-	std::shared_ptr<ASTExpr> charToInt(std::shared_ptr<ASTExpr> expr) noexcept;
+	ASTExpr* charToInt(ASTExpr* expr) noexcept;
 	
 	// Like the above, but in reverse
-	std::shared_ptr<ASTExpr> intToChar(std::shared_ptr<ASTExpr> expr) noexcept;
+	ASTExpr* intToChar(ASTExpr* expr) noexcept;
 	
 protected:
 	// These are all the mutually recursive parse functions
 	
 	// The entry point for the parser (in Parse.cpp)
-	std::shared_ptr<ASTProgram> parseProgram();
+	ASTProgram* parseProgram();
 	
 	// Functions (in Parse.cpp)
-	std::shared_ptr<ASTFunction> parseFunction();
-	std::shared_ptr<ASTArgDecl> parseArgDecl();
+	ASTFunction* parseFunction();
+	ASTArgDecl* parseArgDecl();
 	
 	// Declaration (in ParseStmt.cpp)
-	std::shared_ptr<ASTDecl> parseDecl();
+	ASTDecl* parseDecl();
 	
 	// Statements (in ParseStmt.cpp)
-	std::shared_ptr<ASTStmt> parseStmt();
+	ASTStmt* parseStmt();
 	// If the compound statement is a function body, then the symbol table scope
 	// change will happen at a higher level, so it shouldn't happen in
 	// parseCompoundStmt.
-	std::shared_ptr<ASTCompoundStmt> parseCompoundStmt(bool isFuncBody = false);
-	std::shared_ptr<ASTStmt> parseAssignStmt();
-	std::shared_ptr<ASTIfStmt> parseIfStmt();
-	std::shared_ptr<ASTWhileStmt> parseWhileStmt();
-	std::shared_ptr<ASTReturnStmt> parseReturnStmt();
-	std::shared_ptr<ASTExprStmt> parseExprStmt();
-	std::shared_ptr<ASTNullStmt> parseNullStmt();
+	ASTCompoundStmt* parseCompoundStmt(bool isFuncBody = false);
+	ASTStmt* parseAssignStmt();
+	// Returns true if the identifier at the current token starts an
+	// AssignStmt (id = or id [ ... ] =) rather than an ExprStmt
+	bool isAssignAhead() const noexcept;
+	ASTIfStmt* parseIfStmt();
+	ASTWhileStmt* parseWhileStmt();
+	ASTReturnStmt* parseReturnStmt();
+	ASTExprStmt* parseExprStmt();
+	ASTNullStmt* parseNullStmt();
 	
 	// Expressions (in ParseExpr.cpp)
-	std::shared_ptr<ASTExpr> parseExpr();
-	std::shared_ptr<ASTLogicalOr> parseExprPrime(std::shared_ptr<ASTExpr> lhs);
+	ASTExpr* parseExpr();
+	ASTLogicalOr* parseExprPrime(ASTExpr* lhs);
 	
 	// AndTerm (in ParseExpr.cpp)
-	std::shared_ptr<ASTExpr> parseAndTerm();
-	std::shared_ptr<ASTLogicalAnd> parseAndTermPrime(std::shared_ptr<ASTExpr> lhs);
+	ASTExpr* parseAndTerm();
+	ASTLogicalAnd* parseAndTermPrime(ASTExpr* lhs);
 	
 	// RelExpr (in ParseExpr.cpp)
-	std::shared_ptr<ASTExpr> parseRelExpr();
-	std::shared_ptr<ASTBinaryCmpOp> parseRelExprPrime(std::shared_ptr<ASTExpr> lhs);
+	ASTExpr* parseRelExpr();
+	ASTBinaryCmpOp* parseRelExprPrime(ASTExpr* lhs);
 	
 	// NumExpr (in ParseExpr.cpp)
-	std::shared_ptr<ASTExpr> parseNumExpr();
-	std::shared_ptr<ASTBinaryMathOp> parseNumExprPrime(std::shared_ptr<ASTExpr> lhs);
+	ASTExpr* parseNumExpr();
+	ASTBinaryMathOp* parseNumExprPrime(ASTExpr* lhs);
 	
 	// Term (in ParseExpr.cpp)
-	std::shared_ptr<ASTExpr> parseTerm();
-	std::shared_ptr<ASTBinaryMathOp> parseTermPrime(std::shared_ptr<ASTExpr> lhs);
+	ASTExpr* parseTerm();
+	ASTBinaryMathOp* parseTermPrime(ASTExpr* lhs);
 	
 	// Value (in ParseExpr.cpp)
-	std::shared_ptr<ASTExpr> parseValue();
+	ASTExpr* parseValue();
 	
 	// Factor (in ParseExpr.cpp)
-	std::shared_ptr<ASTExpr> parseFactor();
-	std::shared_ptr<ASTExpr> parseParenFactor();
-	std::shared_ptr<ASTConstantExpr> parseConstantFactor();
-	std::shared_ptr<ASTStringExpr> parseStringFactor();
+	ASTExpr* parseFactor();
+	ASTExpr* parseParenFactor();
+	ASTConstantExpr* parseConstantFactor();
+	ASTStringExpr* parseStringFactor();
 	// parseIdentFactor parses id, id [Expr], and id (FunCallArgs)
-	std::shared_ptr<ASTExpr> parseIdentFactor();
-	std::shared_ptr<ASTExpr> parseIncFactor();
-	std::shared_ptr<ASTExpr> parseDecFactor();
-	std::shared_ptr<ASTExpr> parseAddrOfArrayFactor();
+	ASTExpr* parseIdentFactor();
+	ASTExpr* parseIncFactor();
+	ASTExpr* parseDecFactor();
+	ASTExpr* parseAddrOfArrayFactor();
 	
 private:
 	// Disallow copy/assignment
 	Parser(const Parser& copy) { }
 	Parser& operator=(const Parser& rhs) { return *this; }
 	
-	// Pointer to the root of our AST root
-	std::shared_ptr<ASTProgram> mRoot;
+	// Every node of the AST is allocated from here, and they're
+	// all freed at once with the parser
+	ASTArena mArena;
 	
-	// Used to resolve AsisgnStmt/Factor ambiguity
-	Identifier* mUnusedIdent;
-	std::shared_ptr<ASTArraySub> mUnusedArray;
+	// Pointer to the root of our AST root
+	ASTProgram* mRoot;
 	
 	// Symbol table corresponding to the parsed file
 	SymbolTable mSymbols;
+	// Identifiers of the functions in other files
+	// (see the whole-program constructor)
+	std::vector<Identifier*> mExterns;
 	// String table for this file
 	StringTable mStrings;
 	
-	// Flex wrapper class
-	FlexLexer* mLexer;
+	// Every token of the source (lexed by a MemoryScanner if the
+	// source is in memory, otherwise by a FlexScanner over
+	// mSourceStream). With mPipelineScan, it's
+	// filled by a TokenPipeline as the parse goes.
+	// (The parsers of parseInParallel share it.)
+	std::shared_ptr<scan::TokenBuffer> mTokens;
+	// Index of the current token in mTokens, and of the one
+	// consumeToken moves to
+	size_t mTokenIndex;
+	size_t mNextTokenIndex;
+	// The token at this index is read as the EndOfFile
+	// (only a parser of parseInParallel stops before the end)
+	size_t mTokenEnd;
+	// Null terminated copy of the current token's text
+	// (see getCurrentText)
+	mutable std::string mTokenText;
+	mutable size_t mTokenTextIndex;
 
 	// Name of the file we're parsing
 	const char* mFileName;
-	// File stream that we use to process the file
+	// The source, if it's in memory (the mapped file, or the
+	// buffer passed to the constructor)
+	const char* mSourceBegin;
+	const char* mSourceEnd;
+	// The file we're parsing, if it could be mapped
+	std::unique_ptr<scan::MappedFile> mMappedFile;
+	// File stream that we use to process the file, if it
+	// couldn't be mapped
 	std::ifstream mFileStream;
+	// Stream the source is actually read from, if it isn't in memory
+	// (either mFileStream or the stream passed to the constructor)
+	std::istream* mSourceStream;
 	// Ostream exceptions should be output to
 	std::ostream* mErrStream;
 	// Ostream for AST output
@@ -253,6 +399,8 @@ private:
 	
 	// Tracks the return type of the current function
 	Type mCurrReturnType;
+	// The function being parsed (used to record its callees)
+	ASTFunction* mCurrFunction;
 	
 	// Current active token
 	uscc::scan::Token::Tokens mCurrToken;
@@ -264,6 +412,8 @@ private:
 	
 	// List used to store all of the errors
 	std::list<std::shared_ptr<Error>> mErrors;
+	// How many of them are syntax errors
+	size_t mNumSyntaxErrors;
 	
 	// Track whether we need printf
 	bool mNeedPrintf;
@@ -273,6 +423,19 @@ private:
 
 	// Do we want to output the symbol table?
 	bool mOutputSymbols;
+	
+	// What this parse is for
+	ParseMode mMode;
+	
+	// Lex on another thread? (see the file name constructor)
+	bool mPipelineScan;
+	
+	// Number of threads to parse on (see parseInParallel)
+	unsigned int mParseThreads;
+	
+	// The parsers of parseInParallel. The AST and symbols
+	// merged into this one point into them.
+	std::vector<std::unique_ptr<Parser>> mChunks;
 };
 
 } // parse
@@ -19,12 +19,10 @@
 using namespace uscc::parse;
 using namespace uscc::scan;
 
-using std::shared_ptr;
-using std::make_shared;
 
-shared_ptr<ASTDecl> Parser::parseDecl()
+ASTDecl* Parser::parseDecl()
 {
-	shared_ptr<ASTDecl> retVal;
+	ASTDecl* retVal = nullptr;
 	// A decl MUST start with int or char
 	if (peekIsOneOf({Token::Key_int, Token::Key_char}))
 	{
@@ -52,8 +50,8 @@ shared_ptr<ASTDecl> Parser::parseDecl()
 				throw ParseExceptMsg("Type must be followed by identifier");
 			}
 			
-			if (!mSymbols.isDeclaredInScope(getTokenTxt())) {
-				ident = mSymbols.createIdentifier(getTokenTxt());
+			if (!mSymbols.isDeclaredInScope(getTokenRef())) {
+				ident = mSymbols.createIdentifier(getTokenRef());
 			} else {
 				std::string err = "Invalid redeclaration of identifier '";
 				err += getTokenTxt();
@@ -67,7 +65,7 @@ shared_ptr<ASTDecl> Parser::parseDecl()
 			// Is this an array declaration?
 			if (peekAndConsume(Token::LBracket))
 			{
-				shared_ptr<ASTConstantExpr> constExpr;
+				ASTConstantExpr* constExpr = nullptr;
 				if (declType == Type::Int)
 				{
 					declType = Type::IntArray;
@@ -122,7 +120,7 @@ shared_ptr<ASTDecl> Parser::parseDecl()
 			
 			ident->setType(declType);
 			
-			shared_ptr<ASTExpr> assignExpr;
+			ASTExpr* assignExpr = nullptr;
 			
 			// Optionally, this decl may have an assignment
 			int col = mColNumber;
@@ -159,7 +157,7 @@ shared_ptr<ASTDecl> Parser::parseDecl()
 				// If this is a character array, we need to do extra checks
 				if (ident->getType() == Type::CharArray)
 				{
-					ASTStringExpr* strExpr = dynamic_cast<ASTStringExpr*>(assignExpr.get());
+					ASTStringExpr* strExpr = dynamic_cast<ASTStringExpr*>(assignExpr);
 					if (strExpr != nullptr)
 					{
 						// If we have a declared size, we need to make sure
@@ -183,7 +181,7 @@ shared_ptr<ASTDecl> Parser::parseDecl()
 			
 			matchToken(Token::SemiColon);
 			
-			retVal = make_shared<ASTDecl>(*ident, assignExpr);
+			retVal = mArena.make<ASTDecl>(*ident, assignExpr);
 		}
 		catch (ParseExcept& e)
 		{
@@ -203,16 +201,16 @@ shared_ptr<ASTDecl> Parser::parseDecl()
 			// Put in a decl here with the bogus identifier
 			// "@@error". This is so the parse will continue to the
 			// next decl, if there is one.
-			retVal = make_shared<ASTDecl>(*(ident));
+			retVal = mArena.make<ASTDecl>(*(ident));
 		}
 	}
 	
 	return retVal;
 }
 
-shared_ptr<ASTStmt> Parser::parseStmt()
+ASTStmt* Parser::parseStmt()
 {
-	shared_ptr<ASTStmt> retVal;
+	ASTStmt* retVal = nullptr;
 	try
 	{
 		// NOTE: AssignStmt HAS to go before ExprStmt!!
@@ -255,7 +253,7 @@ shared_ptr<ASTStmt> Parser::parseStmt()
 		
 		// Put in a null statement here
 		// so we can try to continue.
-		retVal = make_shared<ASTNullStmt>();
+		retVal = mArena.make<ASTNullStmt>();
 	}
 	
 	return retVal;
@@ -264,10 +262,10 @@ shared_ptr<ASTStmt> Parser::parseStmt()
 // If the compound statement is a function body, then the symbol table scope
 // change will happen at a higher level, so it shouldn't happen in
 // parseCompoundStmt.
-shared_ptr<ASTCompoundStmt> Parser::parseCompoundStmt(bool isFuncBody)
+ASTCompoundStmt* Parser::parseCompoundStmt(bool isFuncBody)
 {
-	shared_ptr<ASTCompoundStmt> retVal;
-	shared_ptr<ASTReturnStmt> retStmt;
+	ASTCompoundStmt* retVal = nullptr;
+	ASTReturnStmt* retStmt = nullptr;
 	SymbolTable::ScopeTable* table;
 	
 	// PA1: Implement
@@ -276,27 +274,28 @@ shared_ptr<ASTCompoundStmt> Parser::parseCompoundStmt(bool isFuncBody)
 		if (!isFuncBody) {
 			table = mSymbols.enterScope();
 		}
-		retVal = make_shared<ASTCompoundStmt>();
-		shared_ptr<ASTDecl> decl;
+		retVal = mArena.make<ASTCompoundStmt>();
+		ASTDecl* decl = nullptr;
 		decl = parseDecl();
 		while (decl != nullptr)
 		{
-			retVal->addDecl(decl);
+			retVal->addDecl(mArena, decl);
 			decl = parseDecl();
 		}
 
-		shared_ptr<ASTStmt> stmt, lastStmt; // preserve the last statment for check
+		ASTStmt* stmt = nullptr;
+		ASTStmt* lastStmt = nullptr; // preserve the last statment for check
 		stmt = parseStmt();
 		while (stmt != nullptr)
 		{
-			retVal->addStmt(stmt);
+			retVal->addStmt(mArena, stmt);
 			lastStmt = stmt;
 			stmt = parseStmt();
 		}
-		if (isFuncBody && !(retStmt = std::dynamic_pointer_cast<ASTReturnStmt>(lastStmt))) {
+		if (isFuncBody && !(retStmt = dynamic_cast<ASTReturnStmt*>(lastStmt))) {
 			if (mCurrReturnType == Type::Void) {
-				retStmt = make_shared<ASTReturnStmt>(nullptr);
-				retVal->addStmt(retStmt);
+				retStmt = mArena.make<ASTReturnStmt>(nullptr);
+				retVal->addStmt(mArena, retStmt);
 			} else {
 				reportSemantError("USC requires non-void functions to end with a return");
 			}
@@ -313,14 +312,22 @@ shared_ptr<ASTCompoundStmt> Parser::parseCompoundStmt(bool isFuncBody)
 	return retVal;
 }
 
-shared_ptr<ASTStmt> Parser::parseAssignStmt()
+ASTStmt* Parser::parseAssignStmt()
 {
-	shared_ptr<ASTStmt> retVal;
-	shared_ptr<ASTArraySub> arraySub;
+	ASTStmt* retVal = nullptr;
+	ASTArraySub* arraySub = nullptr;
 	
-	if (peekToken() == Token::Identifier)
+	// Just because we got an identifier DOES NOT necessarily mean
+	// this is an assign statement.
+	// This is because there is a common left prefix between
+	// AssignStmt and an ExprStmt with statements like:
+	// id ;
+	// id [ Expr ] ;
+	// id ( FuncCallArgs ) ;
+	// So we look ahead for the =, and leave everything else to ExprStmt
+	if (peekToken() == Token::Identifier && isAssignAhead())
 	{
-		Identifier* ident = getVariable(getTokenTxt());
+		Identifier* ident = getVariable(getTokenRef());
 		
 		consumeToken();
 
@@ -338,13 +345,13 @@ shared_ptr<ASTStmt> Parser::parseAssignStmt()
 			}
 			try
 			{
-				shared_ptr<ASTExpr> expr = parseExpr();
+				ASTExpr* expr = parseExpr();
 				if (!expr)
 				{
 					throw ParseExceptMsg("Valid expression required inside [ ].");
 				}
 				
-				arraySub = make_shared<ASTArraySub>(*ident, expr);
+				arraySub = mArena.make<ASTArraySub>(*ident, expr);
 			}
 			catch (ParseExcept& e)
 			{
@@ -360,102 +367,111 @@ shared_ptr<ASTStmt> Parser::parseAssignStmt()
 			matchToken(Token::RBracket);
 		}
 		
-		// Just because we got an identifier DOES NOT necessarily mean
-		// this is an assign statement.
-		// This is because there is a common left prefix between
-		// AssignStmt and an ExprStmt with statements like:
-		// id ;
-		// id [ Expr ] ;
-		// id ( FuncCallArgs ) ;
-		
-		// So... We see if the next token is a =. If it is, then this is
-		// an AssignStmt. Otherwise, we set the "unused" variables
-		// so parseFactor will later find it and be able to match
 		col = mColNumber;
-		if (peekAndConsume(Token::Assign))
+		matchToken(Token::Assign);
+		
+		ASTExpr* expr = parseExpr();
+		
+		if (!expr)
 		{
-			shared_ptr<ASTExpr> expr = parseExpr();
-			
-			if (!expr)
+			throw ParseExceptMsg("= must be followed by an expression");
+		}
+		
+		// If we matched an array, we want to make an array assign stmt
+		if (arraySub)
+		{
+			// Make sure the type of this expression matches the declared type
+			Type subType;
+			if (arraySub->getType() == Type::IntArray)
 			{
-				throw ParseExceptMsg("= must be followed by an expression");
+				subType = Type::Int;
 			}
-			
-			// If we matched an array, we want to make an array assign stmt
-			if (arraySub)
+			else
 			{
-				// Make sure the type of this expression matches the declared type
-				Type subType;
-				if (arraySub->getType() == Type::IntArray)
+				subType = Type::Char;
+			}
+			if (mCheckSemant && subType != expr->getType())
+			{
+				// We can do a conversion if it's from int to char
+				if (subType == Type::Char &&
+					expr->getType() == Type::Int)
 				{
-					subType = Type::Int;
+					expr = intToChar(expr);
 				}
 				else
 				{
-					subType = Type::Char;
-				}
-				if (mCheckSemant && subType != expr->getType())
-				{
-					// We can do a conversion if it's from int to char
-					if (subType == Type::Char &&
-						expr->getType() == Type::Int)
-					{
-						expr = intToChar(expr);
-					}
-					else
-					{
-						std::string err("Cannot assign an expression of type ");
-						err += getTypeText(expr->getType());
-						err += " to ";
-						err += getTypeText(subType);
-						reportSemantError(err, col);
-					}
-				}
-				retVal = make_shared<ASTAssignArrayStmt>(arraySub, expr);
-			}
-			else
-			{
-				// PA2: Check for semantic errors
-				Type expectT = ident->getType();
-				Type exprT = expr->getType();
-				if (expectT == Type::Char && exprT == Type::Int) {
-					expr = intToChar(expr);
-				} else if (!(expectT == Type::Int && exprT == Type::Char) && expectT != exprT) {
-					std::string err = "Cannot assign an expression of type ";
-					err += getTypeText(exprT);
+					std::string err("Cannot assign an expression of type ");
+					err += getTypeText(expr->getType());
 					err += " to ";
-					err += getTypeText(expectT);
+					err += getTypeText(subType);
 					reportSemantError(err, col);
 				}
-
-				if (ident->isArray()) {
-					reportSemantError("Reassignment of arrays is not allowed", col);
-				}
-				retVal = make_shared<ASTAssignStmt>(*ident, expr);
 			}
-			
-			matchToken(Token::SemiColon);
+			retVal = mArena.make<ASTAssignArrayStmt>(arraySub, expr);
 		}
 		else
 		{
-			// We either have an unused array, or an unused ident
-			if (arraySub)
-			{
-				mUnusedArray = arraySub;
+			// PA2: Check for semantic errors
+			Type expectT = ident->getType();
+			Type exprT = expr->getType();
+			if (expectT == Type::Char && exprT == Type::Int) {
+				expr = intToChar(expr);
+			} else if (!(expectT == Type::Int && exprT == Type::Char) && expectT != exprT) {
+				std::string err = "Cannot assign an expression of type ";
+				err += getTypeText(exprT);
+				err += " to ";
+				err += getTypeText(expectT);
+				reportSemantError(err, col);
 			}
-			else
-			{
-				mUnusedIdent = ident;
+
+			if (ident->isArray()) {
+				reportSemantError("Reassignment of arrays is not allowed", col);
 			}
+			retVal = mArena.make<ASTAssignStmt>(*ident, expr);
 		}
+		
+		matchToken(Token::SemiColon);
 	}
 	
 	return retVal;
 }
 
-shared_ptr<ASTIfStmt> Parser::parseIfStmt()
+bool Parser::isAssignAhead() const noexcept
+{
+	size_t ahead = 1;
+	if (peekToken(ahead) == Token::LBracket)
+	{
+		// Skip to the matching ], without leaving the statement
+		int depth = 0;
+		do
+		{
+			switch (peekToken(ahead))
+			{
+				case Token::LBracket:
+					depth++;
+					break;
+				case Token::RBracket:
+					depth--;
+					break;
+				case Token::SemiColon:
+				case Token::LBrace:
+				case Token::RBrace:
+				case Token::EndOfFile:
+					return false;
+				default:
+					break;
+			}
+			ahead++;
+		}
+		while (depth > 0);
+	}
+	
+	return peekToken(ahead) == Token::Assign;
+}
+
+ASTIfStmt* Parser::parseIfStmt()
 {
-	shared_ptr<ASTIfStmt> retVal;
+	ASTIfStmt* retVal = nullptr;
 	
 	// PA1: Implement
 	if (peekAndConsume(Token::Key_if))
@@ -467,24 +483,24 @@ shared_ptr<ASTIfStmt> Parser::parseIfStmt()
 		matchToken(Token::RParen);
 
 		auto stmt = parseStmt();
-		shared_ptr<ASTStmt> elseStmt;
+		ASTStmt* elseStmt = nullptr;
 		if (peekAndConsume(Token::Key_else))
 			elseStmt = parseStmt();
-		retVal = make_shared<ASTIfStmt>(expr, stmt, elseStmt);
+		retVal = mArena.make<ASTIfStmt>(expr, stmt, elseStmt);
 	}
 	
 	return retVal;
 }
 
-shared_ptr<ASTWhileStmt> Parser::parseWhileStmt()
+ASTWhileStmt* Parser::parseWhileStmt()
 {
-	shared_ptr<ASTWhileStmt> retVal;
+	ASTWhileStmt* retVal = nullptr;
 	
 	// PA1: Implement
 	if (peekAndConsume(Token::Key_while))
 	{
-		shared_ptr<ASTExpr> expr;
-		shared_ptr<ASTStmt> stmt;
+		ASTExpr* expr = nullptr;
+		ASTStmt* stmt = nullptr;
 		matchToken(Token::LParen);
 		expr = parseExpr();
 		if (!expr)
@@ -492,15 +508,15 @@ shared_ptr<ASTWhileStmt> Parser::parseWhileStmt()
 		matchToken(Token::RParen);
 
 		stmt = parseStmt();
-		retVal = make_shared<ASTWhileStmt>(expr, stmt);
+		retVal = mArena.make<ASTWhileStmt>(expr, stmt);
 	}
 	
 	return retVal;
 }
 
-shared_ptr<ASTReturnStmt> Parser::parseReturnStmt()
+ASTReturnStmt* Parser::parseReturnStmt()
 {
-	shared_ptr<ASTReturnStmt> retVal;
+	ASTReturnStmt* retVal = nullptr;
 	
 	// PA1: Implement
 	if (peekAndConsume(Token::Key_return))
@@ -510,7 +526,7 @@ shared_ptr<ASTReturnStmt> Parser::parseReturnStmt()
 			if (mCurrReturnType != Type::Void) {
 				reportSemantError("Invalid empty return in non-void function");
 			}
-			retVal = make_shared<ASTReturnStmt>(nullptr);
+			retVal = mArena.make<ASTReturnStmt>(nullptr);
 			consumeToken();
 		}
 		else
@@ -526,7 +542,7 @@ shared_ptr<ASTReturnStmt> Parser::parseReturnStmt()
 					err += " in return statement";
 					reportSemantError(err, col);
 			}
-			retVal = make_shared<ASTReturnStmt>(expr);
+			retVal = mArena.make<ASTReturnStmt>(expr);
 			matchToken(Token::SemiColon);
 		}
 	}
@@ -534,28 +550,28 @@ shared_ptr<ASTReturnStmt> Parser::parseReturnStmt()
 	return retVal;
 }
 
-shared_ptr<ASTExprStmt> Parser::parseExprStmt()
+ASTExprStmt* Parser::parseExprStmt()
 {
-	shared_ptr<ASTExprStmt> retVal;
+	ASTExprStmt* retVal = nullptr;
 	
 	// PA1: Implement
 	auto e = parseExpr();
 	if (e)
 	{
-		retVal = make_shared<ASTExprStmt>(e);
+		retVal = mArena.make<ASTExprStmt>(e);
 		matchToken(Token::SemiColon);
 	}
 	
 	return retVal;
 }
 
-shared_ptr<ASTNullStmt> Parser::parseNullStmt()
+ASTNullStmt* Parser::parseNullStmt()
 {
-	shared_ptr<ASTNullStmt> retVal;
+	ASTNullStmt* retVal = nullptr;
 	
 	// PA1: Implement
 	if (peekAndConsume(Token::SemiColon))
-		retVal = make_shared<ASTNullStmt>();
+		retVal = mArena.make<ASTNullStmt>();
 	
 	return retVal;
 }
@@ -33,10 +33,10 @@
 
 using namespace uscc::parse;
 
-llvm::Type* Identifier::llvmType(bool treatArrayAsPtr /* = true */) noexcept
+llvm::Type* Identifier::llvmType(llvm::LLVMContext& context,
+								 bool treatArrayAsPtr /* = true */) noexcept
 {
 	llvm::Type* type = nullptr;
-	llvm::LLVMContext& context = llvm::getGlobalContext();
 	switch (mType)
 	{
 		case Type::Char:
@@ -112,85 +112,120 @@ void Identifier::writeTo(CodeContext& ctx, llvm::Value* value) noexcept
 }
 
 SymbolTable::SymbolTable() noexcept
+: mDepth(0)
+, mVisible(1, nullptr)
 {
 	// PA2: Implement
 	Identifier* ident;
-	ScopeTable* scope;
 
-	scope = new ScopeTable(nullptr);
+	mScopes.emplace_back(nullptr);
+	mCurrScope = &mScopes.back();
 
-	ident = new Identifier("@@function");
+	ident = createIdentifier("@@function");
 	ident->setType(Type::Function);
-	scope->addIdentifier(ident);
 
-	ident = new Identifier("@@variable");
+	ident = createIdentifier("@@variable");
 	ident->setType(Type::Int);
-	scope->addIdentifier(ident);
 
-	ident = new Identifier("printf");
+	ident = createIdentifier("printf");
 	ident->setType(Type::Function);
-	scope->addIdentifier(ident);
-
-	mCurrScope = scope;
 }
 
 SymbolTable::~SymbolTable() noexcept
 {
-	// PA2: Implement
-	ScopeTable* scope;
-
-	scope = mCurrScope;
-	while(scope->getParent() != nullptr) {
-		scope = scope->getParent();
-	}
-	delete scope;
-	mCurrScope = nullptr;
+	// The pools free every identifier and scope table
 }
 
 // Returns true if this variable is already declared
 // in this scope (ignoring parent scopes).
 // Used to prevent redeclaration in the same scope,
 // which is disallowed.
-bool SymbolTable::isDeclaredInScope(const char* name) const noexcept
+bool SymbolTable::isDeclaredInScope(llvm::StringRef name) const noexcept
 {
 	// PA2: Implement
-	return mCurrScope->searchInScope(name) != nullptr;
+	// The visible identifier is in the current scope or an enclosing
+	// one, so it's in this one if it's nested as deeply
+	Identifier* ident = findVisible(name);
+	return ident != nullptr && ident->mDepth == mDepth;
 }
 
 // Creates the requested identifier, and returns a pointer
 // to it.
 // NOTE: If the identifier already exists, nothing will happen.
 // This means you should first check with isDeclaredInScope.
-Identifier* SymbolTable::createIdentifier(const char* name)
+Identifier* SymbolTable::createIdentifier(llvm::StringRef name)
 {
 	if (isDeclaredInScope(name)) {
 		return nullptr;
 	}
 
-	Identifier* ident;
-	ident = new Identifier(name);
-	mCurrScope->addIdentifier(ident);
+	mIdentifiers.push_back(Identifier(name));
+	Identifier* ident = &mIdentifiers.back();
+	declare(ident);
 	
 	return ident;
 }
 
+// Declares an identifier of another symbol table in the current scope
+void SymbolTable::importIdentifier(Identifier* ident)
+{
+	declare(ident);
+}
+
+// Imports the scopes under the current scope of other
+void SymbolTable::importScopes(SymbolTable& other)
+{
+	for (auto child : other.mCurrScope->getChildren())
+	{
+		mCurrScope->addChild(child);
+	}
+}
+
+// Makes ident visible, and adds it to the current scope
+void SymbolTable::declare(Identifier* ident)
+{
+	// Intern the name, if this is the first time it's declared
+	uint32_t& id = mNameIds[ident->getName()];
+	if (id == 0)
+	{
+		id = static_cast<uint32_t>(mVisible.size());
+		mVisible.push_back(nullptr);
+	}
+	
+	ident->mNameId = id;
+	ident->mDepth = mDepth;
+	ident->mShadowed = mVisible[id];
+	mVisible[id] = ident;
+	mCurrScope->addIdentifier(ident);
+}
+
 // Returns a pointer to the identifier, if it's found
 // Otherwise returns nullptr
-Identifier* SymbolTable::getIdentifier(const char* name)
+Identifier* SymbolTable::getIdentifier(llvm::StringRef name)
 {
 	// PA2: Implement properly
-	return mCurrScope->search(name);
+	return findVisible(name);
+}
+
+Identifier* SymbolTable::findVisible(llvm::StringRef name) const noexcept
+{
+	auto iter = mNameIds.find(name);
+	if (iter == mNameIds.end())
+	{
+		return nullptr;
+	}
+	
+	return mVisible[iter->getValue()];
 }
 
 // Enters a new scope, and returns a pointer to this scope table
 SymbolTable::ScopeTable* SymbolTable::enterScope()
 {
 	// PA2: Implement
-	ScopeTable* scope;
-	
-	scope = new ScopeTable(mCurrScope);
-	mCurrScope = scope;
-	return scope;
+	mScopes.emplace_back(mCurrScope);
+	mCurrScope = &mScopes.back();
+	mDepth++;
+	return mCurrScope;
 }
 
 // Prints the symbol table to the specified stream
@@ -207,74 +242,52 @@ void SymbolTable::print(std::ostream& output) const noexcept
 // the previous scope table.
 void SymbolTable::exitScope()
 {
+	// Whatever the scope's identifiers hid is visible again
+	for (auto ident : mCurrScope->getIdentifiers())
+	{
+		mVisible[ident->mNameId] = ident->mShadowed;
+	}
+	
 	mCurrScope = mCurrScope->getParent();
+	mDepth--;
 }
 
 SymbolTable::ScopeTable::ScopeTable(ScopeTable* parent) noexcept
 : mParent(parent)
 {
 	// PA2: Implement
-	mSymbols = std::unordered_map<std::string, Identifier*>();
-	mChildren = std::list<ScopeTable*>();
 	if (parent) {
 		parent->mChildren.push_back(this);
 	}
 }
 
-SymbolTable::ScopeTable::~ScopeTable() noexcept
-{
-	// PA2: Implement
-	for (ScopeTable* sc : mChildren) {
-		delete sc;
-	}
-	for (auto& pair : mSymbols) {
-        delete pair.second;
-    }
-}
-
 // Adds the requested identifier to the table
 void SymbolTable::ScopeTable::addIdentifier(Identifier* ident)
 {
 	// PA2: Implement
-	mSymbols[ident->getName()] = ident;
+	mIdents.push_back(ident);
 }
 
-// Searches this scope for an identifier with
-// the requested name. Returns nullptr if not found.
-Identifier* SymbolTable::ScopeTable::searchInScope(const char* name) noexcept
+// Makes child (of another table) a child of this scope
+void SymbolTable::ScopeTable::addChild(ScopeTable* child)
 {
-	// PA2: Implement
-	auto it = mSymbols.find(name);
-	if (it == mSymbols.end()) {
-		return nullptr;
-	}
-	return it->second;
-}
-
-// Searches this scope first, and if not found searches
-// through parent scopes. Returns nullptr if not found.
-Identifier* SymbolTable::ScopeTable::search(const char* name) noexcept
-{
-	Identifier* ident;
-	ScopeTable* scope;
-
-	ident = searchInScope(name);
-	if (ident) {
-		return ident;
-	}
-	scope = getParent();
-	if (scope) {
-		return scope->search(name);
-	}
-	
-	return nullptr;
+	child->mParent = this;
+	mChildren.push_back(child);
 }
 
 void SymbolTable::ScopeTable::emitIR(CodeContext& ctx)
 {
 	// The ONLY thing we should alloca now are arrays of a specified size
-	// First emit all the symbols in this scope
-	for (auto sym : mSymbols)
+	// First emit all the symbols in this scope.
+	// They're emitted in the order a hash table of their names
+	// iterates in, since that's how the scope used to store them,
+	// and the IR shouldn't change because of how they're stored.
+	std::unordered_map<std::string, Identifier*> symbols;
+	for (auto ident : mIdents)
+	{
+		symbols[ident->getName()] = ident;
+	}
+	for (auto sym : symbols)
 	{
 		Identifier* ident = sym.second;
 		llvm::IRBuilder<> build(ctx.mBlock);
@@ -287,7 +300,7 @@ void SymbolTable::ScopeTable::emitIR(CodeContext& ctx)
 		// in which case we don't allocate it
 		if (ident->isArray() && ident->getArrayCount() != -1)
 		{
-			llvm::Type* type = ident->llvmType(false);
+			llvm::Type* type = ident->llvmType(ctx.mGlobal, false);
 			// Note we pass in "nullptr" for the array size because that's
 			// handled by the type
 			decl = build.CreateAlloca(type, nullptr, name);
@@ -325,12 +338,7 @@ void SymbolTable::ScopeTable::emitIR(CodeContext& ctx)
 // Prints the scope table to the specified stream
 void SymbolTable::ScopeTable::print(std::ostream& output, int depth) const noexcept
 {
-	std::vector<Identifier*> idents;
-	for (const auto& sym : mSymbols)
-	{
-		idents.push_back(sym.second);
-	}
-
+	std::vector<Identifier*> idents(mIdents);
 	std::sort(idents.begin(), idents.end(), [](Identifier* a, Identifier* b) {
 		return a->getName() < b->getName();
 	});
@@ -393,12 +401,16 @@ StringTable::~StringTable() noexcept
 	{
 		delete i.second;
 	}
+	for (auto dup : mDuplicates)
+	{
+		delete dup.first;
+	}
 }
 
 // Looks up the requested string in the string table
 // If it exists, returns the corresponding ConstStr
 // Otherwise, constructs a new ConstStr and returns that
-ConstStr* StringTable::getString(std::string& val) noexcept
+ConstStr* StringTable::getString(const std::string& val) noexcept
 {
 	auto iter = mStrings.find(val);
 	if (iter != mStrings.end())
@@ -409,10 +421,37 @@ ConstStr* StringTable::getString(std::string& val) noexcept
 	{
 		ConstStr* newStr = new ConstStr(val);
 		mStrings.emplace(val, newStr);
+		mAdded.push_back(newStr);
 		return newStr;
 	}
 }
 
+// Moves the strings of other into this table
+void StringTable::merge(StringTable& other) noexcept
+{
+	// Add them in the same order as one parse would, since
+	// the strings are emitted in the hash table's order
+	for (auto str : other.mAdded)
+	{
+		auto iter = mStrings.find(str->mText);
+		if (iter != mStrings.end())
+		{
+			mDuplicates.push_back(std::make_pair(str, iter->second));
+		}
+		else
+		{
+			mStrings.emplace(str->mText, str);
+			mAdded.push_back(str);
+		}
+	}
+	
+	// This table owns them now
+	mDuplicates.insert(mDuplicates.end(), other.mDuplicates.begin(), other.mDuplicates.end());
+	other.mStrings.clear();
+	other.mAdded.clear();
+	other.mDuplicates.clear();
+}
+
 void StringTable::emitIR(CodeContext& ctx) noexcept
 {
 	for (auto s : mStrings)
@@ -437,4 +476,9 @@ void StringTable::emitIR(CodeContext& ctx) noexcept
 		
 		str->mValue = globVal;
 	}
+	
+	for (auto dup : mDuplicates)
+	{
+		dup.first->mValue = dup.second->mValue;
+	}
 }
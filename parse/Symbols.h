@@ -14,10 +14,18 @@
 //---------------------------------------------------------
 
 #pragma once
+#include <cstdint>
+#include <deque>
 #include <string>
-#include <memory>
 #include <unordered_map>
-#include <list>
+#include <utility>
+#include <vector>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#pragma clang diagnostic pop
 
 #include "Types.h"
 
@@ -25,6 +33,7 @@ namespace llvm
 {
 	class Value;
 	class Type;
+	class LLVMContext;
 }
 
 namespace uscc
@@ -75,12 +84,13 @@ public:
 		return mType == Type::Function;
 	}
 	
-	std::shared_ptr<ASTFunction> getFunction() const noexcept
+	ASTFunction* getFunction() const noexcept
 	{
 		return mFunctionNode;
 	}
 	
-	void setFunction(std::shared_ptr<ASTFunction> func) noexcept
+	// (func is owned by the ASTArena of the parser that made it)
+	void setFunction(ASTFunction* func) noexcept
 	{
 		mFunctionNode = func;
 	}
@@ -92,7 +102,7 @@ public:
 	
 	llvm::Value* getAddress() noexcept
 	{
-		return mAddress;
+		return mAlias ? mAlias->getAddress() : mAddress;
 	}
 	
 	void setAddress(llvm::Value* value) noexcept
@@ -100,7 +110,19 @@ public:
 		mAddress = value;
 	}
 	
-	llvm::Type* llvmType(bool treatArrayAsPtr = true) noexcept;
+	// Makes this identifier use the address of ident, which is the
+	// same function in another symbol table (see Parser::parseInParallel)
+	void setAlias(Identifier* ident) noexcept
+	{
+		mAlias = ident;
+	}
+	
+	Identifier* getAlias() const noexcept
+	{
+		return mAlias;
+	}
+	
+	llvm::Type* llvmType(llvm::LLVMContext& context, bool treatArrayAsPtr = true) noexcept;
 	
 	llvm::Value* readFrom(CodeContext& ctx) noexcept;
 	
@@ -108,17 +130,30 @@ public:
 	
 private:
 	// Private constructor so only the symbol table can create
-	Identifier(const char* name)
-	: mName(name)
+	// (the name is copied, since it has to outlive the source)
+	Identifier(llvm::StringRef name)
+	: mName(name.data(), name.size())
+	, mNameId(0)
+	, mDepth(0)
+	, mShadowed(nullptr)
 	, mFunctionNode(nullptr)
 	, mAddress(nullptr)
+	, mAlias(nullptr)
 	, mType(Type::Void)
 	, mArrayCount(-1)
 	{ }
 	
 	std::string mName;
-	std::shared_ptr<ASTFunction> mFunctionNode;
+	// Set by the symbol table: the ID the name is interned as, how
+	// deeply nested the scope this is declared in is, and the
+	// identifier with the same name in an enclosing scope that this
+	// one hides (if any)
+	uint32_t mNameId;
+	uint32_t mDepth;
+	Identifier* mShadowed;
+	ASTFunction* mFunctionNode;
 	llvm::Value* mAddress;
+	Identifier* mAlias;
 	Type mType;
 	size_t mArrayCount;
 };
@@ -126,6 +161,12 @@ private:
 // NOTE: I don't use shared_ptrs for the symbol table
 // because the idea is the symbol table won't be deleted
 // until program execution ends.
+//
+// Each name is interned into an integer ID the first time it's
+// declared. For each ID, the table keeps the identifier that's
+// visible from the current scope, and each identifier points at the
+// one it hides, so a lookup doesn't depend on how deeply the scopes
+// are nested. Exiting a scope puts back whatever its identifiers hid.
 class SymbolTable
 {
 public:
@@ -138,21 +179,38 @@ public:
 	// in this scope (ignoring parent scopes).
 	// Used to prevent redeclaration in the same scope,
 	// which is disallowed.
-	bool isDeclaredInScope(const char* name) const noexcept;
+	// (The names are views, usually of the token text in the
+	// source, so none of these copy the name unless it's new.)
+	bool isDeclaredInScope(llvm::StringRef name) const noexcept;
 	
 	// Creates the requested identifier, and returns a pointer
 	// to it.
 	// NOTE: If the identifier already exists, nothing will happen.
 	// This means you should first check with isDeclaredInScope.
-	Identifier* createIdentifier(const char* name);
+	Identifier* createIdentifier(llvm::StringRef name);
 	
 	// Returns a pointer to the identifier, if it's found
 	// Otherwise returns nullptr
-	Identifier* getIdentifier(const char* name);
+	Identifier* getIdentifier(llvm::StringRef name);
+	
+	// Declares an identifier of another symbol table in the current
+	// scope, and imports the scopes under the current scope of other
+	// as children of the current scope. Used to merge the tables of
+	// the functions that were parsed on their own. (The identifiers
+	// and scopes still belong to the other table, so it has to
+	// outlive this one.)
+	void importIdentifier(Identifier* ident);
+	void importScopes(SymbolTable& other);
 	
 	// Enters a new scope, and returns a pointer to this scope table
 	ScopeTable* enterScope();
 	
+	// Returns the current scope table (after a parse, the global one)
+	ScopeTable* getCurrScope() const noexcept
+	{
+		return mCurrScope;
+	}
+	
 	// Exits the current scope and moves the current scope back to
 	// the previous scope table.
 	void exitScope();
@@ -165,18 +223,25 @@ public:
 	{
 	public:
 		ScopeTable(ScopeTable* parent) noexcept;
-		~ScopeTable() noexcept;
 		
 		// Adds the requested identifier to the table
+		// (the symbol table does the lookups)
 		void addIdentifier(Identifier* ident);
 		
-		// Searches this scope for an identifier with
-		// the requested name. Returns nullptr if not found.
-		Identifier* searchInScope(const char* name) noexcept;
+		// Makes child (of another table) a child of this scope
+		void addChild(ScopeTable* child);
 		
-		// Searches this scope first, and if not found searches
-		// through parent scopes. Returns nullptr if not found.
-		Identifier* search(const char* name) noexcept;
+		const std::vector<ScopeTable*>& getChildren() const noexcept
+		{
+			return mChildren;
+		}
+		
+		// Returns the identifiers of this scope, in the order
+		// they were declared
+		const std::vector<Identifier*>& getIdentifiers() const noexcept
+		{
+			return mIdents;
+		}
 		
 		// Emits declarations for ALL non-function symbols
 		// in this scope. Used to front-load all stack-based variables
@@ -191,19 +256,42 @@ public:
 			return mParent;
 		}
 	private:
-		// Hash table contains all the identifiers in this scope
-		std::unordered_map<std::string, Identifier*> mSymbols;
+		// All the identifiers in this scope
+		std::vector<Identifier*> mIdents;
 		
 		// List of the child tables
-		std::list<ScopeTable*> mChildren;
+		std::vector<ScopeTable*> mChildren;
 		
 		// Points to parent ScopeTable
 		ScopeTable* mParent;
 	};
 	
 private:
-	// Pointer to the current scope table
+	// Disallow copy/assignment
+	SymbolTable(const SymbolTable& copy);
+	SymbolTable& operator=(const SymbolTable& rhs);
+	
+	// Returns the identifier named name that's visible
+	// from the current scope, or nullptr if there isn't one
+	Identifier* findVisible(llvm::StringRef name) const noexcept;
+	
+	// Makes ident visible, and adds it to the current scope
+	void declare(Identifier* ident);
+	
+	// Pointer to the current scope table, and how deeply it's
+	// nested (the global scope is 0)
 	ScopeTable* mCurrScope;
+	uint32_t mDepth;
+	
+	// ID of each name that's been declared (IDs start at 1)
+	llvm::StringMap<uint32_t> mNameIds;
+	// The identifier visible from the current scope, for each ID
+	std::vector<Identifier*> mVisible;
+	
+	// Every identifier and scope table, which are freed with the table
+	// (a deque never moves its elements)
+	std::deque<Identifier> mIdentifiers;
+	std::deque<ScopeTable> mScopes;
 };
 	
 // Used to store/reference constant strings
@@ -211,7 +299,7 @@ class ConstStr
 {
 	friend class StringTable;
 public:
-	ConstStr(std::string& text)
+	ConstStr(const std::string& text)
 	: mText(text)
 	, mValue(nullptr)
 	{
@@ -241,12 +329,33 @@ public:
 	// Looks up the requested string in the string table
 	// If it exists, returns the corresponding ConstStr
 	// Otherwise, constructs a new ConstStr and returns that
-	ConstStr* getString(std::string& val) noexcept;
+	ConstStr* getString(const std::string& val) noexcept;
+	
+	// Moves the strings of other into this table, in the order they
+	// were added to it. If this table already has one, the one from
+	// other is kept (since the AST points at it), and gets the same
+	// value as this table's when it's emitted.
+	void merge(StringTable& other) noexcept;
+	
+	// Returns the strings in the order they were added
+	const std::vector<ConstStr*>& getStrings() const noexcept
+	{
+		return mAdded;
+	}
 	
 	// Emit this table to the IR contstants
 	void emitIR(CodeContext& ctx) noexcept;
 private:
+	// Disallow copy/assignment
+	StringTable(const StringTable& copy);
+	StringTable& operator=(const StringTable& rhs);
+	
 	std::unordered_map<std::string, ConstStr*> mStrings;
+	// The strings in the order they were added
+	std::vector<ConstStr*> mAdded;
+	// Strings merged from another table that this one already had,
+	// and the string of this table each one has the value of
+	std::vector<std::pair<ConstStr*, ConstStr*>> mDuplicates;
 };
 
 } // uscc
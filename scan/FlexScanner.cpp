@@ -0,0 +1,45 @@
+//
+//  FlexScanner.cpp
+//  uscc
+//
+//  Implements the Lexer interface over the flex
+//  generated scanner.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "Lexer.h"
+#include <FlexLexer.h>
+
+using namespace uscc::scan;
+
+FlexScanner::FlexScanner(std::istream* input)
+: mLexer(new yyFlexLexer(input))
+{
+
+}
+
+FlexScanner::~FlexScanner()
+{
+	delete mLexer;
+}
+
+Token::Tokens FlexScanner::nextToken()
+{
+	return static_cast<Token::Tokens>(mLexer->yylex());
+}
+
+const char* FlexScanner::getText() const noexcept
+{
+	return mLexer->YYText();
+}
+
+int FlexScanner::getLength() const noexcept
+{
+	return mLexer->YYLeng();
+}
@@ -0,0 +1,132 @@
+//
+//  Lexer.h
+//  uscc
+//
+//  Declares the interface the parser uses to get tokens,
+//  and the scanners that implement it:
+//
+//  MemoryScanner is a hand-written scanner over source
+//  that's already in memory (usually a mapped file). It
+//  can also skip white space and comments a run at a time.
+//  FlexScanner wraps the flex generated scanner in usc.l,
+//  and is used for streams that can't be mapped.
+//
+//  Both recognize exactly the same tokens.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include "Tokens.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+
+class yyFlexLexer;
+
+namespace uscc
+{
+namespace scan
+{
+
+class Lexer
+{
+public:
+	virtual ~Lexer() { }
+
+	// Scans the next token. Returns EndOfFile once the
+	// source runs out.
+	virtual Token::Tokens nextToken() = 0;
+
+	// Returns the text of the last token
+	virtual const char* getText() const = 0;
+
+	// Returns the length of the text of the last token
+	virtual int getLength() const = 0;
+};
+
+// Scans the source in [begin, end), which must stay valid
+// for the life of the scanner
+class MemoryScanner : public Lexer
+{
+public:
+	MemoryScanner(const char* begin, const char* end) noexcept;
+
+	Token::Tokens nextToken() noexcept override;
+	const char* getText() const noexcept override;
+	int getLength() const noexcept override;
+
+	// Skips any spaces, tabs, newlines and comments in one pass,
+	// then scans the next token like nextToken. lines is set to the
+	// number of newlines skipped (a comment ends with one), and
+	// columns to the number of spaces and tabs after the last of
+	// them (or all of them, if lines is 0).
+	Token::Tokens nextSignificantToken(uint32_t& lines, uint32_t& columns) noexcept;
+
+	const char* getSource() const noexcept
+	{
+		return mBegin;
+	}
+
+	// Byte offset of the last token from the start of the source
+	size_t getOffset() const noexcept
+	{
+		return static_cast<size_t>(mTokenStart - mBegin);
+	}
+
+private:
+	// Disallow copy/assignment
+	MemoryScanner(const MemoryScanner& copy);
+	MemoryScanner& operator=(const MemoryScanner& rhs);
+
+	// Each of these scans a token that starts at mPos
+	// (called by nextToken)
+	Token::Tokens scanIdentifier() noexcept;
+	Token::Tokens scanNumber() noexcept;
+	Token::Tokens scanCharConstant() noexcept;
+	Token::Tokens scanString() noexcept;
+	Token::Tokens scanSlash() noexcept;
+
+	// Ends the token at mPos + length, and returns token
+	Token::Tokens accept(Token::Tokens token, ptrdiff_t length) noexcept;
+
+	// Start of the source, and the next character to scan
+	const char* mBegin;
+	const char* mPos;
+	const char* mEnd;
+	// Text of the last token. The source isn't null
+	// terminated, so getText copies it to mText.
+	const char* mTokenStart;
+	int mTokenLength;
+	mutable std::string mText;
+	mutable bool mTextValid;
+};
+
+// Scans a stream with the flex scanner
+class FlexScanner : public Lexer
+{
+public:
+	FlexScanner(std::istream* input);
+	~FlexScanner();
+
+	Token::Tokens nextToken() override;
+	const char* getText() const noexcept override;
+	int getLength() const noexcept override;
+
+private:
+	// Disallow copy/assignment
+	FlexScanner(const FlexScanner& copy);
+	FlexScanner& operator=(const FlexScanner& rhs);
+
+	yyFlexLexer* mLexer;
+};
+
+} // scan
+} // uscc
@@ -0,0 +1,75 @@
+//
+//  MappedFile.cpp
+//  uscc
+//
+//  Implements the read-only source file mapping.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace uscc::scan;
+
+MappedFile::MappedFile(const char* fileName) noexcept
+: mData(nullptr)
+, mSize(0)
+, mMapped(false)
+{
+	int fd = ::open(fileName, O_RDONLY);
+	if (fd == -1)
+	{
+		return;
+	}
+
+	// Pipes and devices have to be read as streams
+	struct stat info;
+	if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		::close(fd);
+		return;
+	}
+
+	mSize = static_cast<size_t>(info.st_size);
+	if (mSize == 0)
+	{
+		// mmap can't map nothing
+		mMapped = true;
+	}
+	else
+	{
+		void* data = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			// The scanner reads the file from start to end
+			::madvise(data, mSize, MADV_SEQUENTIAL);
+			mData = static_cast<const char*>(data);
+			mMapped = true;
+		}
+		else
+		{
+			mSize = 0;
+		}
+	}
+
+	// The mapping stays valid after the file is closed
+	::close(fd);
+}
+
+MappedFile::~MappedFile() noexcept
+{
+	if (mData)
+	{
+		::munmap(const_cast<char*>(mData), mSize);
+	}
+}
@@ -0,0 +1,63 @@
+//
+//  MappedFile.h
+//  uscc
+//
+//  Declares a read-only memory mapping of a source file,
+//  so the scanner can read it without copying it through
+//  an istream.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+
+namespace uscc
+{
+namespace scan
+{
+
+class MappedFile
+{
+public:
+	// Maps the file. Check isMapped to see if it worked
+	// (it won't for files that don't exist, or for pipes
+	// and other files that can't be mapped).
+	MappedFile(const char* fileName) noexcept;
+	~MappedFile() noexcept;
+
+	bool isMapped() const noexcept
+	{
+		return mMapped;
+	}
+
+	// The contents of the file. An empty file is mapped,
+	// but has no data.
+	const char* getData() const noexcept
+	{
+		return mData;
+	}
+
+	size_t getSize() const noexcept
+	{
+		return mSize;
+	}
+
+private:
+	// Disallow copy/assignment
+	MappedFile(const MappedFile& copy);
+	MappedFile& operator=(const MappedFile& rhs);
+
+	const char* mData;
+	size_t mSize;
+	bool mMapped;
+};
+
+} // scan
+} // uscc
@@ -0,0 +1,421 @@
+//
+//  MemoryScanner.cpp
+//  uscc
+//
+//  Implements the hand-written scanner. Each token is
+//  matched the same way the flex rules in usc.l match it:
+//  the longest match wins, and a keyword wins over an
+//  identifier of the same length.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "Lexer.h"
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace uscc::scan;
+
+namespace
+{
+
+constexpr const char* sValues[] =
+{
+	#define TOKEN(a,b,c) b,
+	#include "Tokens.def"
+	#undef TOKEN
+};
+
+constexpr int sLengths[] =
+{
+	#define TOKEN(a,b,c) c,
+	#include "Tokens.def"
+	#undef TOKEN
+};
+
+const unsigned int sKeywordSlots = 16;
+
+// The first two characters and the length are enough to
+// tell the keywords apart
+constexpr unsigned int keywordHash(char first, char second, int length)
+{
+	return (static_cast<unsigned char>(first) + static_cast<unsigned char>(second) +
+			static_cast<unsigned int>(length)) & (sKeywordSlots - 1);
+}
+
+constexpr unsigned int keywordHash(int token)
+{
+	return keywordHash(sValues[token][0], sValues[token][1], sLengths[token]);
+}
+
+// Returns the keyword that hashes to slot, or Unknown
+constexpr Token::Tokens keywordInSlot(unsigned int slot, int token = Token::Key_char)
+{
+	return token > Token::Key_while ? Token::Unknown :
+		keywordHash(token) == slot ? static_cast<Token::Tokens>(token) :
+		keywordInSlot(slot, token + 1);
+}
+
+// Returns how many keywords hash to slot
+constexpr int keywordsInSlot(unsigned int slot, int token = Token::Key_char)
+{
+	return token > Token::Key_while ? 0 :
+		(keywordHash(token) == slot ? 1 : 0) + keywordsInSlot(slot, token + 1);
+}
+
+constexpr bool isPerfectHash(unsigned int slot = 0)
+{
+	return slot == sKeywordSlots ||
+		(keywordsInSlot(slot) <= 1 && isPerfectHash(slot + 1));
+}
+
+static_assert(isPerfectHash(), "Two keywords hash to the same slot, so keywordHash must change");
+
+const Token::Tokens sKeywords[sKeywordSlots] =
+{
+	keywordInSlot(0), keywordInSlot(1), keywordInSlot(2), keywordInSlot(3),
+	keywordInSlot(4), keywordInSlot(5), keywordInSlot(6), keywordInSlot(7),
+	keywordInSlot(8), keywordInSlot(9), keywordInSlot(10), keywordInSlot(11),
+	keywordInSlot(12), keywordInSlot(13), keywordInSlot(14), keywordInSlot(15),
+};
+
+inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+inline bool isIdentStart(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+inline bool isIdentChar(char c)
+{
+	return isIdentStart(c) || isDigit(c);
+}
+
+inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+// Returns the end of the run of spaces and tabs that starts at p
+inline const char* skipBlanks(const char* p, const char* end)
+{
+	// Most runs are the single space between two tokens
+	++p;
+	if (p == end || !isBlank(*p))
+	{
+		return p;
+	}
+
+#ifdef __SSE2__
+	// Indentation is long enough to be worth checking 16 bytes at once
+	const __m128i spaces = _mm_set1_epi8(' ');
+	const __m128i tabs = _mm_set1_epi8('\t');
+	while (end - p >= 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i blanks = _mm_or_si128(_mm_cmpeq_epi8(chunk, spaces),
+									  _mm_cmpeq_epi8(chunk, tabs));
+		unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(blanks));
+		if (mask != 0xFFFF)
+		{
+			// The first byte that isn't blank
+			return p + __builtin_ctz(~mask);
+		}
+		p += 16;
+	}
+#endif
+
+	while (p < end && isBlank(*p))
+	{
+		++p;
+	}
+	return p;
+}
+
+} // anonymous
+
+MemoryScanner::MemoryScanner(const char* begin, const char* end) noexcept
+: mBegin(begin)
+, mPos(begin)
+, mEnd(end)
+, mTokenStart(begin)
+, mTokenLength(0)
+, mTextValid(false)
+{
+
+}
+
+Token::Tokens MemoryScanner::nextToken() noexcept
+{
+	mTokenStart = mPos;
+	mTextValid = false;
+	if (mPos == mEnd)
+	{
+		mTokenLength = 0;
+		return Token::EndOfFile;
+	}
+
+	// The character after this one, or 0 at the end
+	char next = (mPos + 1 < mEnd) ? mPos[1] : '\0';
+	switch (*mPos)
+	{
+		// White space
+		case ' ':
+			return accept(Token::Space, 1);
+		case '\t':
+			return accept(Token::Tab, 1);
+		case '\n':
+			return accept(Token::Newline, 1);
+		case '\r':
+			// A \r on its own isn't a newline
+			return (next == '\n') ? accept(Token::Newline, 2) : accept(Token::Unknown, 1);
+
+		// Expression operators
+		case '=':
+			return (next == '=') ? accept(Token::EqualTo, 2) : accept(Token::Assign, 1);
+		case '+':
+			return (next == '+') ? accept(Token::Inc, 2) : accept(Token::Plus, 1);
+		case '-':
+			if (next == '-')
+			{
+				return accept(Token::Dec, 2);
+			}
+			// A minus sign followed by digits is a negative constant
+			return isDigit(next) ? scanNumber() : accept(Token::Minus, 1);
+		case '*':
+			return accept(Token::Mult, 1);
+		case '/':
+			return scanSlash();
+		case '%':
+			return accept(Token::Mod, 1);
+		case '[':
+			return accept(Token::LBracket, 1);
+		case ']':
+			return accept(Token::RBracket, 1);
+		case '!':
+			return (next == '=') ? accept(Token::NotEqual, 2) : accept(Token::Not, 1);
+		case '|':
+			return (next == '|') ? accept(Token::Or, 2) : accept(Token::Unknown, 1);
+		case '&':
+			return (next == '&') ? accept(Token::And, 2) : accept(Token::Addr, 1);
+		case '<':
+			return accept(Token::LessThan, 1);
+		case '>':
+			return accept(Token::GreaterThan, 1);
+		case '(':
+			return accept(Token::LParen, 1);
+		case ')':
+			return accept(Token::RParen, 1);
+
+		// Other
+		case ';':
+			return accept(Token::SemiColon, 1);
+		case '{':
+			return accept(Token::LBrace, 1);
+		case '}':
+			return accept(Token::RBrace, 1);
+		case ',':
+			return accept(Token::Comma, 1);
+
+		// Values
+		case '\'':
+			return scanCharConstant();
+		case '"':
+			return scanString();
+
+		default:
+			if (isDigit(*mPos))
+			{
+				return scanNumber();
+			}
+			if (isIdentStart(*mPos))
+			{
+				return scanIdentifier();
+			}
+			return accept(Token::Unknown, 1);
+	}
+}
+
+Token::Tokens MemoryScanner::nextSignificantToken(uint32_t& lines, uint32_t& columns) noexcept
+{
+	lines = 0;
+	const char* lineStart = mPos;
+	while (mPos < mEnd)
+	{
+		char c = *mPos;
+		if (isBlank(c))
+		{
+			mPos = skipBlanks(mPos, mEnd);
+		}
+		else if (c == '\n')
+		{
+			lines++;
+			lineStart = ++mPos;
+		}
+		else if (c == '\r' && mPos + 1 < mEnd && mPos[1] == '\n')
+		{
+			lines++;
+			mPos += 2;
+			lineStart = mPos;
+		}
+		else if (c == '/' && mPos + 1 < mEnd && mPos[1] == '/')
+		{
+			// Without a newline at the end, it's not a comment (see scanSlash)
+			const void* newline = std::memchr(mPos + 2, '\n', static_cast<size_t>(mEnd - mPos - 2));
+			if (!newline)
+			{
+				break;
+			}
+			lines++;
+			lineStart = mPos = static_cast<const char*>(newline) + 1;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	// Everything since the last newline is a space or tab
+	columns = static_cast<uint32_t>(mPos - lineStart);
+	return nextToken();
+}
+
+const char* MemoryScanner::getText() const noexcept
+{
+	if (!mTextValid)
+	{
+		mText.assign(mTokenStart, static_cast<size_t>(mTokenLength));
+		mTextValid = true;
+	}
+	return mText.c_str();
+}
+
+int MemoryScanner::getLength() const noexcept
+{
+	return mTokenLength;
+}
+
+// [a-zA-Z_][a-zA-Z0-9_]*, unless it's a keyword
+Token::Tokens MemoryScanner::scanIdentifier() noexcept
+{
+	const char* p = mPos + 1;
+	while (p < mEnd && isIdentChar(*p))
+	{
+		++p;
+	}
+
+	int length = static_cast<int>(p - mPos);
+	if (length >= 2)
+	{
+		Token::Tokens keyword = sKeywords[keywordHash(mPos[0], mPos[1], length)];
+		if (keyword != Token::Unknown && sLengths[keyword] == length &&
+			std::memcmp(sValues[keyword], mPos, static_cast<size_t>(length)) == 0)
+		{
+			return accept(keyword, length);
+		}
+	}
+
+	return accept(Token::Identifier, length);
+}
+
+// "-"?(0|([1-9][0-9]*))
+Token::Tokens MemoryScanner::scanNumber() noexcept
+{
+	const char* p = mPos;
+	if (*p == '-')
+	{
+		++p;
+	}
+
+	// A leading 0 is a constant on its own
+	if (*p++ != '0')
+	{
+		while (p < mEnd && isDigit(*p))
+		{
+			++p;
+		}
+	}
+
+	return accept(Token::Constant, p - mPos);
+}
+
+// "\'"("\\t"|"\\n"|.)"\'"
+Token::Tokens MemoryScanner::scanCharConstant() noexcept
+{
+	ptrdiff_t left = mEnd - mPos;
+	if (left >= 4 && mPos[1] == '\\' && (mPos[2] == 't' || mPos[2] == 'n') &&
+		mPos[3] == '\'')
+	{
+		return accept(Token::Constant, 4);
+	}
+
+	if (left >= 3 && mPos[1] != '\n' && mPos[2] == '\'')
+	{
+		return accept(Token::Constant, 3);
+	}
+
+	return accept(Token::Unknown, 1);
+}
+
+// \"([^\\\"]|\\n|\\t)*\"
+Token::Tokens MemoryScanner::scanString() noexcept
+{
+	const char* p = mPos + 1;
+	while (p < mEnd)
+	{
+		if (*p == '"')
+		{
+			return accept(Token::String, p + 1 - mPos);
+		}
+
+		if (*p == '\\')
+		{
+			// Only \n and \t are allowed
+			if (p + 1 < mEnd && (p[1] == 'n' || p[1] == 't'))
+			{
+				p += 2;
+				continue;
+			}
+			break;
+		}
+
+		++p;
+	}
+
+	// Without a valid string, the quote is just an unknown character
+	return accept(Token::Unknown, 1);
+}
+
+// A comment is "//".*(\n|"\r\n"), so one without
+// a newline at the end is just two divides
+Token::Tokens MemoryScanner::scanSlash() noexcept
+{
+	if (mPos + 1 < mEnd && mPos[1] == '/')
+	{
+		const void* newline = std::memchr(mPos + 2, '\n', static_cast<size_t>(mEnd - mPos - 2));
+		if (newline)
+		{
+			return accept(Token::Comment, static_cast<const char*>(newline) + 1 - mPos);
+		}
+	}
+
+	return accept(Token::Div, 1);
+}
+
+Token::Tokens MemoryScanner::accept(Token::Tokens token, ptrdiff_t length) noexcept
+{
+	mPos += length;
+	mTokenLength = static_cast<int>(length);
+	return token;
+}
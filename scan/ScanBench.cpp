@@ -0,0 +1,474 @@
+//
+//  ScanBench.cpp
+//  uscc
+//
+//  Measures the throughput of the hand-written scanner
+//  against the flex scanner, and checks that both return
+//  the same tokens.
+//
+//  scanbench [--size <MB>] [--iterations <n>] <file> ...
+//      Repeats the files until the input is at least the
+//      requested size (8 MB by default), then scans it with
+//      each scanner (and with the hand-written one skipping
+//      white space) and writes the best MB/s of each.
+//      It then times filling a token buffer and reading it
+//      back like the parser does, once lexing everything up
+//      front and once with the lexer on a thread of its own.
+//
+//  scanbench --check <file> ...
+//      Scans each file with both scanners, and fails if
+//      they return different tokens, if skipping white space
+//      puts a token on a different line or column, or if the
+//      pipelined lexer fills a token buffer differently.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "Lexer.h"
+#include "MappedFile.h"
+#include "TokenBuffer.h"
+#include "TokenPipeline.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace uscc::scan;
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+// Total length of the token text scanAll has fetched
+// (so the fetches can't be optimized away)
+size_t sTextBytes = 0;
+
+// Reads all of fileName into contents. Returns false if it can't be opened.
+bool readFile(const char* fileName, std::string& contents)
+{
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	std::ostringstream buffer;
+	buffer << file.rdbuf();
+	contents = buffer.str();
+	return true;
+}
+
+// Scans until the end of the source, fetching the text of the
+// tokens the parser needs the text of. Returns the number of tokens.
+size_t scanAll(Lexer& lexer)
+{
+	size_t count = 0;
+	for (Token::Tokens token = lexer.nextToken(); token != Token::EndOfFile;
+		 token = lexer.nextToken())
+	{
+		if (token == Token::Identifier || token == Token::Constant ||
+			token == Token::String)
+		{
+			sTextBytes += std::strlen(lexer.getText());
+		}
+		count++;
+	}
+	return count;
+}
+
+// As scanAll, but skips white space and comments a run at a time.
+// Returns the number of tokens that aren't white space or comments.
+size_t scanSignificant(MemoryScanner& lexer)
+{
+	size_t count = 0;
+	uint32_t lines = 0;
+	uint32_t columns = 0;
+	for (Token::Tokens token = lexer.nextSignificantToken(lines, columns);
+		 token != Token::EndOfFile; token = lexer.nextSignificantToken(lines, columns))
+	{
+		if (token == Token::Identifier || token == Token::Constant ||
+			token == Token::String)
+		{
+			sTextBytes += std::strlen(lexer.getText());
+		}
+		count++;
+	}
+	return count;
+}
+
+// Reads every token of tokens the way the parser does, fetching
+// the text of the tokens it needs the text of. Returns the number
+// of tokens.
+size_t readAll(TokenBuffer& tokens)
+{
+	size_t index = 0;
+	for (; tokens.has(index); index++)
+	{
+		Token::Tokens token = tokens.getKind(index);
+		if (token == Token::Identifier || token == Token::Constant ||
+			token == Token::String)
+		{
+			sTextBytes += tokens.getText(index).size();
+		}
+	}
+	return index;
+}
+
+bool isTrivia(Token::Tokens token)
+{
+	return token == Token::Space || token == Token::Tab ||
+		token == Token::Newline || token == Token::Comment;
+}
+
+// Scans contents with both scanners. Writes the first token they
+// disagree on to std::cerr, and returns false if there is one.
+bool checkFile(const char* fileName, const std::string& contents)
+{
+	MemoryScanner memory(contents.data(), contents.data() + contents.size());
+	std::istringstream stream(contents);
+	FlexScanner flex(&stream);
+
+	int line = 1;
+	size_t count = 0;
+	while (true)
+	{
+		Token::Tokens expected = flex.nextToken();
+		Token::Tokens actual = memory.nextToken();
+		if (expected != actual ||
+			(expected != Token::EndOfFile &&
+			 std::strcmp(flex.getText(), memory.getText()) != 0))
+		{
+			std::cerr << fileName << ":" << line << ": error: flex scanned "
+				<< Token::Names[expected] << " '" << flex.getText()
+				<< "', but the hand-written scanner scanned "
+				<< Token::Names[actual] << " '" << memory.getText() << "'" << std::endl;
+			return false;
+		}
+
+		if (expected == Token::EndOfFile)
+		{
+			break;
+		}
+		if (expected == Token::Newline || expected == Token::Comment)
+		{
+			line++;
+		}
+		count++;
+	}
+
+	std::cout << fileName << ": " << count << " tokens match" << std::endl;
+	return true;
+}
+
+// Scans contents a token at a time with flex, and skipping white
+// space with the hand-written scanner. Writes the first token they
+// put in different places to std::cerr, and returns false if there is one.
+bool checkSkipping(const char* fileName, const std::string& contents)
+{
+	MemoryScanner memory(contents.data(), contents.data() + contents.size());
+	std::istringstream stream(contents);
+	FlexScanner flex(&stream);
+
+	uint32_t expectedLine = 1;
+	uint32_t expectedColumn = 1;
+	uint32_t actualLine = 1;
+	uint32_t actualColumn = 1;
+	while (true)
+	{
+		Token::Tokens expected = flex.nextToken();
+		if (expected == Token::Newline || expected == Token::Comment)
+		{
+			expectedLine++;
+			expectedColumn = 1;
+			continue;
+		}
+		if (isTrivia(expected))
+		{
+			expectedColumn++;
+			continue;
+		}
+
+		uint32_t lines = 0;
+		uint32_t columns = 0;
+		Token::Tokens actual = memory.nextSignificantToken(lines, columns);
+		if (lines != 0)
+		{
+			actualLine += lines;
+			actualColumn = 1;
+		}
+		actualColumn += columns;
+
+		if (expected != actual || expectedLine != actualLine ||
+			expectedColumn != actualColumn)
+		{
+			std::cerr << fileName << ":" << expectedLine << ":" << expectedColumn
+				<< ": error: flex scanned " << Token::Names[expected]
+				<< ", but skipping white space scanned " << Token::Names[actual]
+				<< " at " << actualLine << ":" << actualColumn << std::endl;
+			return false;
+		}
+
+		if (expected == Token::EndOfFile)
+		{
+			break;
+		}
+		expectedColumn += static_cast<uint32_t>(flex.getLength());
+		actualColumn += static_cast<uint32_t>(memory.getLength());
+	}
+
+	return true;
+}
+
+// Fills a token buffer up front and with a pipeline. Writes the
+// first token or line they differ on to std::cerr, and returns
+// false if there is one.
+bool checkPipeline(const char* fileName, const std::string& contents)
+{
+	const char* begin = contents.data();
+	const char* end = begin + contents.size();
+	MemoryScanner memory(begin, end);
+	TokenBuffer expected(memory);
+	std::unique_ptr<TokenPipeline> pipeline(new TokenPipeline(begin, end));
+	TokenBuffer actual(std::move(pipeline), begin);
+	actual.finish();
+
+	if (expected.size() != actual.size())
+	{
+		std::cerr << fileName << ": error: the pipeline lexed " << actual.size()
+			<< " tokens, instead of " << expected.size() << std::endl;
+		return false;
+	}
+
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		if (expected.getKind(i) != actual.getKind(i) ||
+			expected.getOffset(i) != actual.getOffset(i) ||
+			expected.getLength(i) != actual.getLength(i) ||
+			expected.getLine(i) != actual.getLine(i) ||
+			expected.getColumn(i) != actual.getColumn(i))
+		{
+			std::cerr << fileName << ":" << expected.getLine(i) << ":"
+				<< expected.getColumn(i) << ": error: the pipeline lexed "
+				<< Token::Names[actual.getKind(i)] << " at " << actual.getLine(i)
+				<< ":" << actual.getColumn(i) << ", instead of "
+				<< Token::Names[expected.getKind(i)] << std::endl;
+			return false;
+		}
+	}
+
+	for (size_t line = 1; line <= expected.getLineCount() + 1; line++)
+	{
+		if (expected.getLineText(line) != actual.getLineText(line))
+		{
+			std::cerr << fileName << ":" << line
+				<< ": error: the pipeline recorded the line differently" << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Returns the best time of iterations runs of scan
+double bestSeconds(int iterations, size_t& tokens, const std::function<size_t()>& scan)
+{
+	double best = 0.0;
+	for (int i = 0; i < iterations; i++)
+	{
+		Clock::time_point start = Clock::now();
+		tokens = scan();
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		if (i == 0 || seconds < best)
+		{
+			best = seconds;
+		}
+	}
+	return best;
+}
+
+void printResult(const char* name, double seconds, size_t bytes, size_t tokens)
+{
+	double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+	std::cout << std::left << std::setw(14) << name << std::right
+		<< std::fixed << std::setprecision(1)
+		<< std::setw(10) << megabytes / seconds << " MB/s"
+		<< std::setw(12) << tokens << " tokens"
+		<< std::setprecision(2) << std::setw(10) << seconds * 1000.0 << " ms" << std::endl;
+}
+
+} // anonymous
+
+int main(int argc, const char* argv[])
+{
+	bool check = false;
+	double megabytes = 8.0;
+	int iterations = 5;
+	std::vector<const char*> fileNames;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--check") == 0)
+		{
+			check = true;
+		}
+		else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+		{
+			megabytes = std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+		{
+			iterations = std::atoi(argv[++i]);
+		}
+		else
+		{
+			fileNames.push_back(argv[i]);
+		}
+	}
+
+	if (fileNames.empty() || megabytes <= 0.0 || iterations <= 0)
+	{
+		std::cerr << "usage: scanbench [--check] [--size <MB>] [--iterations <n>] <file> ..."
+			<< std::endl;
+		return 1;
+	}
+
+	std::vector<std::string> sources;
+	for (auto fileName : fileNames)
+	{
+		std::string contents;
+		if (!readFile(fileName, contents))
+		{
+			std::cerr << "scanbench: error: Input file " << fileName << " not found." << std::endl;
+			return 1;
+		}
+		sources.push_back(contents);
+	}
+
+	if (check)
+	{
+		bool matched = true;
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			matched = checkFile(fileNames[i], sources[i]) &&
+				checkSkipping(fileNames[i], sources[i]) &&
+				checkPipeline(fileNames[i], sources[i]) && matched;
+		}
+		return matched ? 0 : 1;
+	}
+
+	// Repeat the files until the input is big enough. Each copy
+	// starts on a new line, so tokens never join across files.
+	size_t target = static_cast<size_t>(megabytes * 1024.0 * 1024.0);
+	std::string input;
+	while (input.size() < target)
+	{
+		for (const auto& source : sources)
+		{
+			input += source;
+			input += '\n';
+		}
+	}
+
+	// The scanners are timed on a real file, since that's what
+	// the mapping is for
+	char tempName[] = "/tmp/scanbench.XXXXXX";
+	int fd = ::mkstemp(tempName);
+	if (fd == -1)
+	{
+		std::cerr << "scanbench: error: Unable to create a temporary file." << std::endl;
+		return 1;
+	}
+	bool written = ::write(fd, input.data(), input.size()) == static_cast<ssize_t>(input.size());
+	::close(fd);
+	if (!written)
+	{
+		std::remove(tempName);
+		std::cerr << "scanbench: error: Unable to write " << tempName << "." << std::endl;
+		return 1;
+	}
+
+	size_t memoryTokens = 0;
+	double memorySeconds = bestSeconds(iterations, memoryTokens, [&]()
+	{
+		MappedFile file(tempName);
+		MemoryScanner lexer(file.getData(), file.getData() + file.getSize());
+		return scanAll(lexer);
+	});
+
+	size_t skippingTokens = 0;
+	double skippingSeconds = bestSeconds(iterations, skippingTokens, [&]()
+	{
+		MappedFile file(tempName);
+		MemoryScanner lexer(file.getData(), file.getData() + file.getSize());
+		return scanSignificant(lexer);
+	});
+
+	size_t flexTokens = 0;
+	double flexSeconds = bestSeconds(iterations, flexTokens, [&]()
+	{
+		std::ifstream file(tempName);
+		FlexScanner lexer(&file);
+		return scanAll(lexer);
+	});
+
+	size_t bufferedTokens = 0;
+	double bufferedSeconds = bestSeconds(iterations, bufferedTokens, [&]()
+	{
+		MappedFile file(tempName);
+		MemoryScanner lexer(file.getData(), file.getData() + file.getSize());
+		TokenBuffer tokens(lexer);
+		return readAll(tokens);
+	});
+
+	size_t pipelinedTokens = 0;
+	double pipelinedSeconds = bestSeconds(iterations, pipelinedTokens, [&]()
+	{
+		MappedFile file(tempName);
+		std::unique_ptr<TokenPipeline> pipeline(
+			new TokenPipeline(file.getData(), file.getData() + file.getSize()));
+		TokenBuffer tokens(std::move(pipeline), file.getData());
+		size_t count = readAll(tokens);
+		tokens.finish();
+		return count;
+	});
+
+	std::remove(tempName);
+
+	std::cout << "Scanned " << std::fixed << std::setprecision(1)
+		<< static_cast<double>(input.size()) / (1024.0 * 1024.0)
+		<< " MB, best of " << iterations << ":" << std::endl;
+	printResult("hand-written", memorySeconds, input.size(), memoryTokens);
+	printResult("skipping", skippingSeconds, input.size(), skippingTokens);
+	printResult("flex", flexSeconds, input.size(), flexTokens);
+	std::cout << "Speedup: " << std::setprecision(2) << flexSeconds / memorySeconds
+		<< "x (" << flexSeconds / skippingSeconds << "x skipping white space)" << std::endl;
+
+	std::cout << "Filled and read a token buffer:" << std::endl;
+	printResult("buffered", bufferedSeconds, input.size(), bufferedTokens);
+	printResult("pipelined", pipelinedSeconds, input.size(), pipelinedTokens);
+	std::cout << "Speedup: " << std::setprecision(2) << bufferedSeconds / pipelinedSeconds
+		<< "x" << std::endl;
+
+	if (memoryTokens != flexTokens || bufferedTokens != pipelinedTokens)
+	{
+		std::cerr << "scanbench: error: The scanners returned different numbers of tokens."
+			<< std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,133 @@
+//
+//  SpscRing.h
+//  uscc
+//
+//  Declares a bounded, lock-free queue between exactly one
+//  producer thread and one consumer thread.
+//
+//  The producer only writes mTail and the consumer only
+//  writes mHead. Each is padded onto a cache line of its
+//  own (with the copy of the other index its thread keeps),
+//  so the two threads don't keep taking the same line from
+//  each other.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace uscc
+{
+namespace scan
+{
+
+template <typename T>
+class SpscRing
+{
+public:
+	// capacity is rounded up to a power of two
+	explicit SpscRing(size_t capacity)
+	: mHead(0)
+	, mCachedTail(0)
+	, mTail(0)
+	, mCachedHead(0)
+	{
+		size_t size = 2;
+		while (size < capacity)
+		{
+			size *= 2;
+		}
+		mSlots.resize(size);
+		mMask = size - 1;
+	}
+
+	// Adds as many of the count values as fit to the back, and
+	// returns how many that was (0 if the ring is full). They're
+	// published to the consumer all at once.
+	// (Only call this from the producer thread.)
+	size_t tryPush(const T* values, size_t count) noexcept
+	{
+		size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mCachedHead + count > mSlots.size())
+		{
+			// Only look at the consumer's index once the ring seems full
+			mCachedHead = mHead.load(std::memory_order_acquire);
+		}
+
+		size_t space = mSlots.size() - (tail - mCachedHead);
+		if (count > space)
+		{
+			count = space;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			mSlots[(tail + i) & mMask] = values[i];
+		}
+		if (count != 0)
+		{
+			mTail.store(tail + count, std::memory_order_release);
+		}
+		return count;
+	}
+
+	// Removes up to max values from the front into values, and
+	// returns how many that was (0 if the ring is empty).
+	// (Only call this from the consumer thread.)
+	size_t tryPop(T* values, size_t max) noexcept
+	{
+		size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mCachedTail)
+		{
+			// Only look at the producer's index once the ring seems empty
+			mCachedTail = mTail.load(std::memory_order_acquire);
+		}
+
+		size_t count = mCachedTail - head;
+		if (count > max)
+		{
+			count = max;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			values[i] = mSlots[(head + i) & mMask];
+		}
+		if (count != 0)
+		{
+			mHead.store(head + count, std::memory_order_release);
+		}
+		return count;
+	}
+
+private:
+	// Disallow copy/assignment
+	SpscRing(const SpscRing& copy);
+	SpscRing& operator=(const SpscRing& rhs);
+
+	static const size_t sCacheLine = 64;
+
+	std::vector<T> mSlots;
+	size_t mMask;
+	char mPad0[sCacheLine];
+
+	// Written by the consumer
+	std::atomic<size_t> mHead;
+	size_t mCachedTail;
+	char mPad1[sCacheLine];
+
+	// Written by the producer
+	std::atomic<size_t> mTail;
+	size_t mCachedHead;
+	char mPad2[sCacheLine];
+};
+
+} // scan
+} // uscc
@@ -0,0 +1,218 @@
+//
+//  TokenBuffer.cpp
+//  uscc
+//
+//  Implements the buffer of lexed tokens.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "TokenBuffer.h"
+#include "TokenPipeline.h"
+#include <cstring>
+
+using namespace uscc::scan;
+
+static_assert(Token::Identifier < 256, "Token kinds must fit in a byte");
+
+namespace
+{
+
+// Adds the start of each line that begins after a newline in text,
+// which is length bytes at offset in the source, to lineStarts
+void addLineStarts(std::vector<uint32_t>& lineStarts, const char* text,
+				   uint32_t offset, uint32_t length)
+{
+	const char* end = text + length;
+	for (const char* p = text;
+		 (p = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p))));
+		 p++)
+	{
+		lineStarts.push_back(offset + static_cast<uint32_t>(p + 1 - text));
+	}
+}
+
+} // anonymous
+
+TokenScanner::TokenScanner(MemoryScanner& lexer)
+: mLexer(lexer)
+, mEnd(0)
+, mLine(1)
+, mColumn(1)
+, mLineStarts(1, 0)
+{
+
+}
+
+bool TokenScanner::next(TokenRecord& record)
+{
+	// The scanner skips the white space and comments itself,
+	// and says how far they moved the line and column
+	uint32_t lines = 0;
+	uint32_t columns = 0;
+	Token::Tokens token = mLexer.nextSignificantToken(lines, columns);
+	uint32_t offset = static_cast<uint32_t>(mLexer.getOffset());
+	uint32_t length = static_cast<uint32_t>(mLexer.getLength());
+	const char* source = mLexer.getSource();
+	if (lines != 0)
+	{
+		addLineStarts(mLineStarts, source + mEnd, mEnd, offset - mEnd);
+		mLine += lines;
+		mColumn = 1;
+	}
+	mColumn += columns;
+
+	record.mKind = token;
+	record.mOffset = offset;
+	record.mLength = length;
+	record.mLine = mLine;
+	record.mColumn = mColumn;
+	if (token == Token::EndOfFile)
+	{
+		return false;
+	}
+
+	if (token == Token::String)
+	{
+		addLineStarts(mLineStarts, source + offset, offset, length);
+	}
+	mColumn += length;
+	mEnd = offset + length;
+	return true;
+}
+
+TokenBuffer::TokenBuffer(MemoryScanner& lexer)
+: mSource(lexer.getSource())
+, mSourceLength(0)
+{
+	TokenScanner scanner(lexer);
+	TokenRecord record;
+	bool more = true;
+	while (more)
+	{
+		more = scanner.next(record);
+		push(record);
+	}
+
+	mLineStarts = std::move(scanner.getLineStarts());
+}
+
+TokenBuffer::TokenBuffer(Lexer& lexer)
+: mLineStarts(1, 0)
+, mSource(nullptr)
+, mSourceLength(0)
+{
+	uint32_t offset = 0;
+	uint32_t line = 1;
+	uint32_t column = 1;
+	while (true)
+	{
+		Token::Tokens token = lexer.nextToken();
+		uint32_t length = static_cast<uint32_t>(lexer.getLength());
+		const char* text = lexer.getText();
+		mCopiedSource.append(text, length);
+		if (token == Token::Newline || token == Token::Comment ||
+			token == Token::String)
+		{
+			addLineStarts(mLineStarts, text, offset, length);
+		}
+
+		if (token == Token::Newline || token == Token::Comment)
+		{
+			line++;
+			column = 1;
+		}
+		else if (token == Token::Space || token == Token::Tab)
+		{
+			column++;
+		}
+		else
+		{
+			TokenRecord record = { token, offset, length, line, column };
+			push(record);
+			if (token == Token::EndOfFile)
+			{
+				break;
+			}
+			column += length;
+		}
+
+		offset += length;
+	}
+
+	mSource = mCopiedSource.data();
+}
+
+TokenBuffer::TokenBuffer(std::unique_ptr<TokenPipeline> pipeline, const char* source)
+: mLineStarts(1, 0)
+, mSource(source)
+, mSourceLength(0)
+, mPipeline(std::move(pipeline))
+{
+
+}
+
+TokenBuffer::~TokenBuffer()
+{
+
+}
+
+void TokenBuffer::finish()
+{
+	while (mPipeline)
+	{
+		pull();
+	}
+}
+
+void TokenBuffer::push(const TokenRecord& record)
+{
+	mKinds.push_back(static_cast<uint8_t>(record.mKind));
+	mOffsets.push_back(record.mOffset);
+	mLengths.push_back(record.mLength);
+	mLines.push_back(record.mLine);
+	mColumns.push_back(record.mColumn);
+	if (record.mKind == Token::EndOfFile)
+	{
+		mSourceLength = record.mOffset;
+	}
+}
+
+void TokenBuffer::pull()
+{
+	TokenRecord records[256];
+	size_t count = mPipeline->pop(records, sizeof(records) / sizeof(records[0]));
+	for (size_t i = 0; i < count; i++)
+	{
+		push(records[i]);
+	}
+
+	if (records[count - 1].mKind == Token::EndOfFile)
+	{
+		mLineStarts = mPipeline->takeLineStarts();
+		mPipeline.reset();
+	}
+}
+
+std::string TokenBuffer::getText(size_t index) const
+{
+	return std::string(mSource + mOffsets[index], mLengths[index]);
+}
+
+std::string TokenBuffer::getLineText(size_t line) const
+{
+	if (line == 0 || line > mLineStarts.size())
+	{
+		return std::string();
+	}
+
+	// The line ends at the newline before the next line
+	uint32_t start = mLineStarts[line - 1];
+	uint32_t end = (line < mLineStarts.size()) ? mLineStarts[line] - 1 : mSourceLength;
+	return std::string(mSource + start, end - start);
+}
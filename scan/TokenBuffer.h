@@ -0,0 +1,208 @@
+//
+//  TokenBuffer.h
+//  uscc
+//
+//  Declares the buffer the parser reads its tokens from.
+//
+//  The whole source is lexed before the parse starts, and
+//  the tokens are stored as parallel arrays (kind, byte
+//  offset, length, line and column), so the parser's loop
+//  only touches the arrays it needs and can look ahead as
+//  far as it wants.
+//
+//  The offset each line of the source starts at is recorded
+//  too, so diagnostics can show a line without reading the
+//  source again.
+//
+//  A buffer can also be filled by a TokenPipeline, which lexes
+//  on a thread of its own while the parse runs. The tokens are
+//  then moved into the arrays as the parser reaches them.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include "Lexer.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace uscc
+{
+namespace scan
+{
+
+class TokenPipeline;
+
+// A token, and where it is in the source
+struct TokenRecord
+{
+	Token::Tokens mKind;
+	uint32_t mOffset;
+	uint32_t mLength;
+	// Line and column the token starts on (from 1)
+	uint32_t mLine;
+	uint32_t mColumn;
+};
+
+// Scans the tokens that aren't white space or comments out of a
+// MemoryScanner, keeping track of the line and column of each,
+// and of the offset each line of the source starts at
+class TokenScanner
+{
+public:
+	explicit TokenScanner(MemoryScanner& lexer);
+
+	// Scans the next token into record. Returns false once
+	// that token is the EndOfFile.
+	bool next(TokenRecord& record);
+
+	// Offset of the start of each line scanned so far
+	std::vector<uint32_t>& getLineStarts() noexcept
+	{
+		return mLineStarts;
+	}
+
+private:
+	// Disallow copy/assignment
+	TokenScanner(const TokenScanner& copy);
+	TokenScanner& operator=(const TokenScanner& rhs);
+
+	MemoryScanner& mLexer;
+	// Offset of the end of the last token
+	uint32_t mEnd;
+	uint32_t mLine;
+	uint32_t mColumn;
+	std::vector<uint32_t> mLineStarts;
+};
+
+class TokenBuffer
+{
+public:
+	// Lexes everything lexer returns. Spaces, tabs, newlines and
+	// comments only move the line and column, so they aren't stored.
+	// The offsets are into the lexer's source, which must outlive
+	// the buffer.
+	explicit TokenBuffer(MemoryScanner& lexer);
+
+	// As above, but for a lexer with no source in memory, so the
+	// buffer keeps its own copy of the text
+	explicit TokenBuffer(Lexer& lexer);
+
+	// Takes the tokens from pipeline as they're needed (see has).
+	// source is the source the pipeline lexes.
+	TokenBuffer(std::unique_ptr<TokenPipeline> pipeline, const char* source);
+
+	~TokenBuffer();
+
+	// Returns true if there's a token at index. If the buffer is
+	// filled by a pipeline, this waits until the token is lexed.
+	bool has(size_t index)
+	{
+		while (index >= mKinds.size() && mPipeline)
+		{
+			pull();
+		}
+		return index < mKinds.size();
+	}
+
+	// Moves every token that's left out of the pipeline, and waits
+	// for it to finish. (Call this before asking for lines.)
+	void finish();
+
+	// Number of tokens, including the EndOfFile at the end
+	// (only the tokens pulled so far, until finish is called)
+	size_t size() const noexcept
+	{
+		return mKinds.size();
+	}
+
+	Token::Tokens getKind(size_t index) const noexcept
+	{
+		return static_cast<Token::Tokens>(mKinds[index]);
+	}
+
+	// Byte offset of the token in the source
+	uint32_t getOffset(size_t index) const noexcept
+	{
+		return mOffsets[index];
+	}
+
+	uint32_t getLength(size_t index) const noexcept
+	{
+		return mLengths[index];
+	}
+
+	// Line and column the token starts on (from 1)
+	uint32_t getLine(size_t index) const noexcept
+	{
+		return mLines[index];
+	}
+
+	uint32_t getColumn(size_t index) const noexcept
+	{
+		return mColumns[index];
+	}
+
+	// Returns the token's text
+	std::string getText(size_t index) const;
+
+	// Returns a pointer to the token's text in the source (which
+	// isn't null terminated, so use getLength too)
+	const char* getTextStart(size_t index) const noexcept
+	{
+		return mSource + mOffsets[index];
+	}
+
+	// Number of lines in the source. Lines are split at each
+	// newline character (like std::getline), so unlike the line
+	// numbers of the tokens, newlines in strings count too.
+	size_t getLineCount() const noexcept
+	{
+		return mLineStarts.size();
+	}
+
+	// Returns the text of the line (from 1), without the newline.
+	// Returns an empty string if there's no such line.
+	std::string getLineText(size_t line) const;
+
+private:
+	// Disallow copy/assignment
+	TokenBuffer(const TokenBuffer& copy);
+	TokenBuffer& operator=(const TokenBuffer& rhs);
+
+	void push(const TokenRecord& record);
+
+	// Moves the next tokens out of mPipeline (and lets go
+	// of the pipeline after the EndOfFile)
+	void pull();
+
+	std::vector<uint8_t> mKinds;
+	std::vector<uint32_t> mOffsets;
+	std::vector<uint32_t> mLengths;
+	std::vector<uint32_t> mLines;
+	std::vector<uint32_t> mColumns;
+
+	// Offset of the start of each line
+	std::vector<uint32_t> mLineStarts;
+
+	// The source the offsets are into
+	const char* mSource;
+	uint32_t mSourceLength;
+	// Copy of the source, if the lexer read a stream
+	std::string mCopiedSource;
+
+	// Lexes the rest of the tokens, until the EndOfFile is pulled
+	std::unique_ptr<TokenPipeline> mPipeline;
+};
+
+} // scan
+} // uscc
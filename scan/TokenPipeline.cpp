@@ -0,0 +1,113 @@
+//
+//  TokenPipeline.cpp
+//  uscc
+//
+//  Implements the pipelined lexer.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "TokenPipeline.h"
+
+using namespace uscc::scan;
+
+namespace
+{
+
+// Tokens the ring holds. This is enough to keep the lexer ahead
+// of the parser, while the ring stays small enough to fit in the
+// cache the two threads share.
+const size_t sRingSize = 4096;
+
+// Tokens the lexer scans before it publishes them, so the
+// threads don't touch each other's index for every token
+const size_t sBatchSize = 64;
+
+// Times a full or empty ring is checked again before the
+// thread gives up the rest of its time slice
+const int sSpins = 64;
+
+// Called each time a thread finds the ring full or empty
+void backOff(int& spins)
+{
+	if (++spins >= sSpins)
+	{
+		std::this_thread::yield();
+		spins = 0;
+	}
+}
+
+} // anonymous
+
+TokenPipeline::TokenPipeline(const char* begin, const char* end)
+: mLexer(begin, end)
+, mRing(sRingSize)
+, mStop(false)
+{
+	// Start the thread last, once everything it uses is constructed
+	mThread = std::thread(&TokenPipeline::run, this);
+}
+
+TokenPipeline::~TokenPipeline()
+{
+	mStop.store(true, std::memory_order_relaxed);
+	if (mThread.joinable())
+	{
+		mThread.join();
+	}
+}
+
+size_t TokenPipeline::pop(TokenRecord* records, size_t max)
+{
+	int spins = 0;
+	size_t count = 0;
+	while ((count = mRing.tryPop(records, max)) == 0)
+	{
+		backOff(spins);
+	}
+	return count;
+}
+
+std::vector<uint32_t> TokenPipeline::takeLineStarts()
+{
+	if (mThread.joinable())
+	{
+		mThread.join();
+	}
+	return std::move(mLineStarts);
+}
+
+void TokenPipeline::run()
+{
+	TokenScanner scanner(mLexer);
+	TokenRecord batch[sBatchSize];
+	bool more = true;
+	while (more)
+	{
+		size_t count = 0;
+		while (more && count < sBatchSize)
+		{
+			more = scanner.next(batch[count++]);
+		}
+
+		size_t pushed = 0;
+		int spins = 0;
+		while ((pushed += mRing.tryPush(batch + pushed, count - pushed)) < count)
+		{
+			// The consumer stops waiting for tokens if the pipeline
+			// is destroyed before the EndOfFile
+			if (mStop.load(std::memory_order_relaxed))
+			{
+				return;
+			}
+			backOff(spins);
+		}
+	}
+
+	mLineStarts = std::move(scanner.getLineStarts());
+}
@@ -0,0 +1,71 @@
+//
+//  TokenPipeline.h
+//  uscc
+//
+//  Declares the pipelined lexer, which scans source that's
+//  in memory on a thread of its own, and passes the tokens
+//  to the parser's thread through a SpscRing. The parse can
+//  then start before the whole source is lexed.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include "Lexer.h"
+#include "SpscRing.h"
+#include "TokenBuffer.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace uscc
+{
+namespace scan
+{
+
+class TokenPipeline
+{
+public:
+	// Starts lexing [begin, end) on a thread of its own.
+	// The source must outlive the pipeline.
+	TokenPipeline(const char* begin, const char* end);
+
+	// Stops the thread, if it's still lexing
+	~TokenPipeline();
+
+	// Waits for the next tokens, and moves up to max of them into
+	// records. Returns how many it moved. (The last token is the
+	// EndOfFile.)
+	size_t pop(TokenRecord* records, size_t max);
+
+	// Waits for the thread to finish, and returns the offset each
+	// line of the source starts at. Only call this after the
+	// EndOfFile has been popped.
+	std::vector<uint32_t> takeLineStarts();
+
+private:
+	// Disallow copy/assignment
+	TokenPipeline(const TokenPipeline& copy);
+	TokenPipeline& operator=(const TokenPipeline& rhs);
+
+	// Lexes everything into mRing (run by mThread)
+	void run();
+
+	MemoryScanner mLexer;
+	SpscRing<TokenRecord> mRing;
+	// Written by mThread, and only read once it's joined
+	std::vector<uint32_t> mLineStarts;
+	// Set if the consumer stopped before the EndOfFile
+	std::atomic<bool> mStop;
+	std::thread mThread;
+};
+
+} // scan
+} // uscc
@@ -0,0 +1,89 @@
+//
+//  MemoryStats.cpp
+//  uscc
+//
+//  Implements the heap and RSS accounting used by
+//  --mem-report.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "MemoryStats.h"
+#include <atomic>
+#include <sys/resource.h>
+
+using namespace uscc;
+using namespace uscc::support;
+
+namespace
+{
+
+// These are only ever touched by their own thread, and are
+// plain integers so the allocator hooks can use them before
+// anything else is initialized
+thread_local uint64_t tAllocations = 0;
+thread_local uint64_t tAllocatedBytes = 0;
+thread_local uint64_t tFrees = 0;
+thread_local uint64_t tFreedBytes = 0;
+
+std::atomic<bool> sTracked(false);
+std::atomic<bool> sEnabled(false);
+
+} // anonymous
+
+void support::enableAllocationTracking() noexcept
+{
+	sEnabled.store(true, std::memory_order_relaxed);
+}
+
+bool support::allocationTrackingEnabled() noexcept
+{
+	return sEnabled.load(std::memory_order_relaxed);
+}
+
+void support::noteAllocation(size_t bytes) noexcept
+{
+	tAllocations++;
+	tAllocatedBytes += bytes;
+	if (!sTracked.load(std::memory_order_relaxed))
+	{
+		sTracked.store(true, std::memory_order_relaxed);
+	}
+}
+
+void support::noteFree(size_t bytes) noexcept
+{
+	tFrees++;
+	tFreedBytes += bytes;
+}
+
+bool support::allocationsTracked() noexcept
+{
+	return sTracked.load(std::memory_order_relaxed);
+}
+
+MemoryCounts support::readMemoryCounts() noexcept
+{
+	MemoryCounts retVal;
+	retVal.mAllocations = tAllocations;
+	retVal.mAllocatedBytes = tAllocatedBytes;
+	retVal.mFrees = tFrees;
+	retVal.mFreedBytes = tFreedBytes;
+
+	rusage usage;
+	if (::getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#ifdef __APPLE__
+		// Darwin reports bytes rather than kilobytes
+		retVal.mPeakRSS = static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+		retVal.mPeakRSS = static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+	}
+	return retVal;
+}
@@ -0,0 +1,98 @@
+//
+//  MemoryStats.h
+//  uscc
+//
+//  Declares the heap and RSS accounting used by
+//  --mem-report.
+//
+//  Heap allocations are counted per thread by hooks on the
+//  global operator new/delete. The hooks themselves live in
+//  the uscc executable (uscc/MemoryHooks.cpp), so libuscc
+//  never replaces an embedder's allocator. Without the
+//  hooks, the heap counts just stay at zero. The hooks
+//  only count once enableAllocationTracking is called, so
+//  a compile without --mem-report doesn't pay for them.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace uscc
+{
+namespace support
+{
+
+struct MemoryCounts
+{
+	MemoryCounts()
+	: mAllocations(0)
+	, mAllocatedBytes(0)
+	, mFrees(0)
+	, mFreedBytes(0)
+	, mPeakRSS(0)
+	{ }
+
+	// Adds up the heap counts. The peak RSS is the
+	// highest of the two.
+	MemoryCounts& operator+=(const MemoryCounts& rhs)
+	{
+		mAllocations += rhs.mAllocations;
+		mAllocatedBytes += rhs.mAllocatedBytes;
+		mFrees += rhs.mFrees;
+		mFreedBytes += rhs.mFreedBytes;
+		if (rhs.mPeakRSS > mPeakRSS)
+		{
+			mPeakRSS = rhs.mPeakRSS;
+		}
+		return *this;
+	}
+
+	// Returns the heap activity between rhs and this.
+	// The peak RSS is this one's.
+	MemoryCounts operator-(const MemoryCounts& rhs) const
+	{
+		MemoryCounts retVal;
+		retVal.mAllocations = mAllocations - rhs.mAllocations;
+		retVal.mAllocatedBytes = mAllocatedBytes - rhs.mAllocatedBytes;
+		retVal.mFrees = mFrees - rhs.mFrees;
+		retVal.mFreedBytes = mFreedBytes - rhs.mFreedBytes;
+		retVal.mPeakRSS = mPeakRSS;
+		return retVal;
+	}
+
+	uint64_t mAllocations;
+	uint64_t mAllocatedBytes;
+	uint64_t mFrees;
+	uint64_t mFreedBytes;
+	// Peak resident set size of the process, in kilobytes
+	uint64_t mPeakRSS;
+};
+
+// Makes the allocator hooks count from now on
+void enableAllocationTracking() noexcept;
+
+// Returns true if the allocator hooks should count
+bool allocationTrackingEnabled() noexcept;
+
+// Called by the allocator hooks with the usable size of the block
+void noteAllocation(size_t bytes) noexcept;
+void noteFree(size_t bytes) noexcept;
+
+// Returns true once the allocator hooks have seen an allocation
+bool allocationsTracked() noexcept;
+
+// Returns the heap counts for the calling thread, and the peak
+// RSS of the process
+MemoryCounts readMemoryCounts() noexcept;
+
+} // support
+} // uscc
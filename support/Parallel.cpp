@@ -0,0 +1,54 @@
+//
+//  Parallel.cpp
+//  uscc
+//
+//  Implements parallelFor.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "Parallel.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace uscc;
+
+void support::parallelFor(size_t count, unsigned int numThreads,
+						  const std::function<void(size_t)>& body)
+{
+	if (numThreads > count)
+	{
+		numThreads = static_cast<unsigned int>(count);
+	}
+	if (numThreads <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			body(i);
+		}
+		return;
+	}
+	
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < numThreads; i++)
+	{
+		threads.emplace_back([&]()
+		{
+			for (size_t j = next++; j < count; j = next++)
+			{
+				body(j);
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
@@ -0,0 +1,34 @@
+//
+//  Parallel.h
+//  uscc
+//
+//  Declares the helper that spreads independent pieces of
+//  work (files, function groups, modules) over threads.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace uscc
+{
+namespace support
+{
+
+// Runs body for each index below count, on up to numThreads threads.
+// With one thread (or one index), body just runs on the calling thread.
+// Otherwise it only runs on new threads, so none of it lands in the
+// calling thread's phase timer.
+void parallelFor(size_t count, unsigned int numThreads,
+				 const std::function<void(size_t)>& body);
+
+} // support
+} // uscc
@@ -0,0 +1,156 @@
+//
+//  PerfCounters.cpp
+//  uscc
+//
+//  Implements the hardware performance counter wrapper
+//  used by --perf-counters.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace uscc::support;
+
+#ifdef __linux__
+
+namespace
+{
+
+// glibc doesn't wrap this system call
+int openCounter(uint32_t type, uint64_t config, int groupFd)
+{
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	// Only count uscc itself
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// The leader starts disabled, so every counter in the group
+	// starts at the same time
+	attr.disabled = (groupFd == -1) ? 1 : 0;
+
+	return static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+} // anonymous
+
+PerfCounters::PerfCounters() noexcept
+: mLeader(-1)
+{
+	static const struct
+	{
+		uint32_t mType;
+		uint64_t mConfig;
+	} events[NumCounters] =
+	{
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+
+	// A counter the hardware doesn't support just stays at -1
+	for (int i = 0; i < NumCounters; i++)
+	{
+		mFds[i] = openCounter(events[i].mType, events[i].mConfig, mLeader);
+		if (mFds[i] < 0)
+		{
+			mFds[i] = -1;
+		}
+		else if (mLeader == -1)
+		{
+			mLeader = mFds[i];
+		}
+	}
+
+	if (mLeader != -1)
+	{
+		::ioctl(mLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		::ioctl(mLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+}
+
+PerfCounters::~PerfCounters()
+{
+	for (int i = 0; i < NumCounters; i++)
+	{
+		if (mFds[i] != -1)
+		{
+			::close(mFds[i]);
+		}
+	}
+}
+
+PerfCounts PerfCounters::read() const noexcept
+{
+	PerfCounts retVal;
+	if (mLeader == -1)
+	{
+		return retVal;
+	}
+
+	// With PERF_FORMAT_GROUP, a read returns the number of counters
+	// followed by each value, in the order the counters were opened
+	uint64_t buffer[1 + NumCounters];
+	if (::read(mLeader, buffer, sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t)))
+	{
+		return retVal;
+	}
+
+	uint64_t values[NumCounters] = { 0, 0, 0, 0 };
+	uint64_t next = 0;
+	for (int i = 0; i < NumCounters && next < buffer[0]; i++)
+	{
+		if (mFds[i] != -1)
+		{
+			values[i] = buffer[1 + next];
+			next++;
+		}
+	}
+
+	retVal.mInstructions = values[Instructions];
+	retVal.mCycles = values[Cycles];
+	retVal.mCacheMisses = values[CacheMisses];
+	retVal.mBranchMisses = values[BranchMisses];
+	return retVal;
+}
+
+#else
+
+PerfCounters::PerfCounters() noexcept
+: mLeader(-1)
+{
+	for (int i = 0; i < NumCounters; i++)
+	{
+		mFds[i] = -1;
+	}
+}
+
+PerfCounters::~PerfCounters()
+{
+
+}
+
+PerfCounts PerfCounters::read() const noexcept
+{
+	return PerfCounts();
+}
+
+#endif
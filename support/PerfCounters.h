@@ -0,0 +1,103 @@
+//
+//  PerfCounters.h
+//  uscc
+//
+//  Declares a wrapper around the hardware performance
+//  counters used by --perf-counters.
+//
+//  On Linux this uses perf_event_open to count the calling
+//  thread's user-space instructions, cycles, cache misses
+//  and branch misses. Anywhere else (or if the kernel won't
+//  hand out counters), every read returns zeros.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+
+namespace uscc
+{
+namespace support
+{
+
+struct PerfCounts
+{
+	PerfCounts()
+	: mInstructions(0)
+	, mCycles(0)
+	, mCacheMisses(0)
+	, mBranchMisses(0)
+	{ }
+
+	PerfCounts& operator+=(const PerfCounts& rhs)
+	{
+		mInstructions += rhs.mInstructions;
+		mCycles += rhs.mCycles;
+		mCacheMisses += rhs.mCacheMisses;
+		mBranchMisses += rhs.mBranchMisses;
+		return *this;
+	}
+
+	PerfCounts operator-(const PerfCounts& rhs) const
+	{
+		PerfCounts retVal;
+		retVal.mInstructions = mInstructions - rhs.mInstructions;
+		retVal.mCycles = mCycles - rhs.mCycles;
+		retVal.mCacheMisses = mCacheMisses - rhs.mCacheMisses;
+		retVal.mBranchMisses = mBranchMisses - rhs.mBranchMisses;
+		return retVal;
+	}
+
+	uint64_t mInstructions;
+	uint64_t mCycles;
+	uint64_t mCacheMisses;
+	uint64_t mBranchMisses;
+};
+
+class PerfCounters
+{
+public:
+	// Opens the counters for the calling thread.
+	// They only count work done on this thread.
+	PerfCounters() noexcept;
+	~PerfCounters();
+
+	// Returns true if at least one counter could be opened
+	bool isAvailable() const noexcept
+	{
+		return mLeader != -1;
+	}
+
+	// Returns the counts since the counters were opened.
+	// Counters that couldn't be opened read as zero.
+	PerfCounts read() const noexcept;
+
+private:
+	// Disallow copy/assignment
+	PerfCounters(const PerfCounters& copy);
+	PerfCounters& operator=(const PerfCounters& rhs);
+
+	enum Counter
+	{
+		Instructions,
+		Cycles,
+		CacheMisses,
+		BranchMisses,
+		NumCounters
+	};
+
+	// File descriptor for each counter (-1 if it isn't available)
+	int mFds[NumCounters];
+	// The counters are read as a group, through this descriptor
+	int mLeader;
+};
+
+} // support
+} // uscc
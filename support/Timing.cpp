@@ -0,0 +1,293 @@
+//
+//  Timing.cpp
+//  uscc
+//
+//  Implements the phase timer behind -ftime-report and
+//  -ftime-trace.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "Timing.h"
+#include <fstream>
+#include <iomanip>
+
+using namespace uscc::support;
+
+namespace
+{
+
+// Timer for the compile running on this thread
+thread_local PhaseTimer* sActiveTimer = nullptr;
+
+double toMilliseconds(PhaseTimer::Clock::duration time)
+{
+	return std::chrono::duration<double, std::milli>(time).count();
+}
+
+double toMicroseconds(PhaseTimer::Clock::duration time)
+{
+	return std::chrono::duration<double, std::micro>(time).count();
+}
+
+// Writes the string as a JSON string literal
+void writeJSONString(std::ostream& output, const std::string& str)
+{
+	output << '"';
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			output << '\\';
+		}
+		output << c;
+	}
+	output << '"';
+}
+
+} // anonymous
+
+PhaseTimer::PhaseTimer()
+: mStart(Clock::now())
+, mTrackMemory(false)
+{
+
+}
+
+PhaseTimer::~PhaseTimer()
+{
+
+}
+
+void PhaseTimer::enableCounters()
+{
+	mCounters.reset(new PerfCounters());
+}
+
+void PhaseTimer::record(const std::string& name, Clock::time_point start,
+						Clock::time_point end, const PhaseCounts& counts)
+{
+	Event event;
+	event.mName = name;
+	event.mStart = start;
+	event.mEnd = end;
+	event.mCounts = counts;
+	mEvents.push_back(event);
+
+	Total& total = getTotal(name);
+	total.mTime += end - start;
+	total.mCount++;
+	total.mCounts += counts;
+}
+
+void PhaseTimer::accumulate(const std::string& name, Clock::duration time,
+							unsigned int count, const PhaseCounts& counts)
+{
+	Total& total = getTotal(name);
+	total.mTime += time;
+	total.mCount += count;
+	total.mCounts += counts;
+}
+
+void PhaseTimer::accumulate(const PhaseTimer& other)
+{
+	for (const auto& total : other.mTotals)
+	{
+		accumulate(total.mName, total.mTime, total.mCount, total.mCounts);
+	}
+}
+
+PhaseTimer::Total& PhaseTimer::getTotal(const std::string& name)
+{
+	for (auto& total : mTotals)
+	{
+		if (total.mName == name)
+		{
+			return total;
+		}
+	}
+
+	Total total;
+	total.mName = name;
+	total.mTime = Clock::duration::zero();
+	total.mCount = 0;
+	mTotals.push_back(total);
+	return mTotals.back();
+}
+
+void PhaseTimer::printReport(std::ostream& output) const
+{
+	double wallTime = toMilliseconds(Clock::now() - mStart);
+
+	output << "===-------------------------------------------------------===" << std::endl;
+	output << "                  uscc phase timing report" << std::endl;
+	output << "===-------------------------------------------------------===" << std::endl;
+	output << "  Total compile time: " << std::fixed << std::setprecision(3)
+		<< wallTime << " ms" << std::endl;
+
+	if (mCounters && !mCounters->isAvailable())
+	{
+		output << "  (Hardware performance counters are unavailable)" << std::endl;
+	}
+	if (mTrackMemory)
+	{
+		output << "  Peak RSS: " << readMemoryCounts().mPeakRSS << " KB" << std::endl;
+		if (!allocationsTracked())
+		{
+			output << "  (Heap allocations aren't being counted)" << std::endl;
+		}
+	}
+	output << std::endl;
+
+	output << "   Time (ms)    Count   Percent";
+	if (showPerfCounts())
+	{
+		output << "        Instrs        Cycles   Cache miss  Branch miss";
+	}
+	if (mTrackMemory)
+	{
+		output << "     Allocs    Alloc KB      Net KB   Peak RSS KB";
+	}
+	output << "  Phase" << std::endl;
+
+	printPhases(output, "", 0, wallTime);
+}
+
+void PhaseTimer::printPhases(std::ostream& output, const std::string& parent,
+							 size_t depth, double wallTime) const
+{
+	std::string prefix;
+	if (!parent.empty())
+	{
+		prefix = parent + '/';
+	}
+
+	for (const auto& total : mTotals)
+	{
+		// Only phases directly under the parent
+		if (total.mName.compare(0, prefix.size(), prefix) != 0 ||
+			total.mName.find('/', prefix.size()) != std::string::npos)
+		{
+			continue;
+		}
+
+		double time = toMilliseconds(total.mTime);
+		double percent = 0.0;
+		if (wallTime > 0.0)
+		{
+			percent = time / wallTime * 100.0;
+		}
+
+		output << std::setw(12) << std::setprecision(3) << time
+			<< std::setw(9) << total.mCount
+			<< std::setw(9) << std::setprecision(1) << percent << "%";
+		if (showPerfCounts())
+		{
+			const PerfCounts& perf = total.mCounts.mPerf;
+			output << std::setw(14) << perf.mInstructions
+				<< std::setw(14) << perf.mCycles
+				<< std::setw(13) << perf.mCacheMisses
+				<< std::setw(13) << perf.mBranchMisses;
+		}
+		if (mTrackMemory)
+		{
+			// Net is what the phase allocated and didn't free
+			const MemoryCounts& memory = total.mCounts.mMemory;
+			double netBytes = static_cast<double>(memory.mAllocatedBytes) -
+				static_cast<double>(memory.mFreedBytes);
+			output << std::setw(11) << memory.mAllocations
+				<< std::setw(12) << std::setprecision(1) << memory.mAllocatedBytes / 1024.0
+				<< std::setw(12) << netBytes / 1024.0
+				<< std::setw(14) << memory.mPeakRSS;
+		}
+		output << "  " << std::string(depth * 2, ' ') << total.mName.substr(prefix.size())
+			<< std::endl;
+
+		printPhases(output, total.mName, depth + 1, wallTime);
+	}
+}
+
+bool PhaseTimer::writeTrace(const std::string& fileName) const
+{
+	std::ofstream output(fileName);
+	if (!output.is_open())
+	{
+		return false;
+	}
+
+	output << "{\"traceEvents\":[";
+	bool first = true;
+	for (const auto& event : mEvents)
+	{
+		if (!first)
+		{
+			output << ",";
+		}
+		first = false;
+
+		output << "\n{\"name\":";
+		writeJSONString(output, event.mName);
+		output << ",\"cat\":\"uscc\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+			<< std::fixed << std::setprecision(3)
+			<< ",\"ts\":" << toMicroseconds(event.mStart - mStart)
+			<< ",\"dur\":" << toMicroseconds(event.mEnd - event.mStart);
+		if (showPerfCounts() || mTrackMemory)
+		{
+			output << ",\"args\":{";
+			if (showPerfCounts())
+			{
+				const PerfCounts& perf = event.mCounts.mPerf;
+				output << "\"instructions\":" << perf.mInstructions
+					<< ",\"cycles\":" << perf.mCycles
+					<< ",\"cache-misses\":" << perf.mCacheMisses
+					<< ",\"branch-misses\":" << perf.mBranchMisses;
+				if (mTrackMemory)
+				{
+					output << ",";
+				}
+			}
+			if (mTrackMemory)
+			{
+				const MemoryCounts& memory = event.mCounts.mMemory;
+				output << "\"allocations\":" << memory.mAllocations
+					<< ",\"allocated-bytes\":" << memory.mAllocatedBytes
+					<< ",\"freed-bytes\":" << memory.mFreedBytes
+					<< ",\"peak-rss-kb\":" << memory.mPeakRSS;
+			}
+			output << "}";
+		}
+		output << "}";
+	}
+	output << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+	return output.good();
+}
+
+PhaseTimer* PhaseTimer::getActive() noexcept
+{
+	return sActiveTimer;
+}
+
+void PhaseTimer::setActive(PhaseTimer* timer) noexcept
+{
+	sActiveTimer = timer;
+}
+
+extern "C" void* usccBeginPhase(const char* name)
+{
+	if (!PhaseTimer::getActive())
+	{
+		return nullptr;
+	}
+	return new PhaseScope(name);
+}
+
+extern "C" void usccEndPhase(void* phase)
+{
+	delete static_cast<PhaseScope*>(phase);
+}
@@ -0,0 +1,250 @@
+//
+//  Timing.h
+//  uscc
+//
+//  Declares the phase timer behind -ftime-report and
+//  -ftime-trace.
+//
+//  A PhaseTimer is made active on the thread running a
+//  compile, and each phase of the compile wraps itself in
+//  a PhaseScope. When no timer is active, a PhaseScope
+//  does nothing.
+//
+//  Nested phases are named with a '/', for example
+//  "optimize/LICM".
+//
+//  If hardware counters (--perf-counters) or memory
+//  accounting (--mem-report) are enabled, each phase also
+//  records those counts.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include "MemoryStats.h"
+#include "PerfCounters.h"
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace uscc
+{
+namespace support
+{
+
+// Everything a phase samples when it starts and ends
+struct PhaseCounts
+{
+	PhaseCounts& operator+=(const PhaseCounts& rhs)
+	{
+		mPerf += rhs.mPerf;
+		mMemory += rhs.mMemory;
+		return *this;
+	}
+
+	PhaseCounts operator-(const PhaseCounts& rhs) const
+	{
+		PhaseCounts retVal;
+		retVal.mPerf = mPerf - rhs.mPerf;
+		retVal.mMemory = mMemory - rhs.mMemory;
+		return retVal;
+	}
+
+	PerfCounts mPerf;
+	MemoryCounts mMemory;
+};
+
+class PhaseTimer
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	PhaseTimer();
+	~PhaseTimer();
+
+	// Opens hardware counters for the calling thread, so each
+	// phase also records counts (must be called on the thread
+	// that runs the compile)
+	void enableCounters();
+
+	// Records heap and RSS usage for each phase
+	void enableMemoryReport() noexcept
+	{
+		mTrackMemory = true;
+	}
+
+	bool hasCounters() const noexcept
+	{
+		return mCounters != nullptr || mTrackMemory;
+	}
+
+	// Returns the current counts (zeros for anything that's off)
+	PhaseCounts readCounters() const noexcept
+	{
+		PhaseCounts retVal;
+		if (mCounters)
+		{
+			retVal.mPerf = mCounters->read();
+		}
+		if (mTrackMemory)
+		{
+			retVal.mMemory = readMemoryCounts();
+		}
+		return retVal;
+	}
+
+	// Records one run of a phase, with the counts for that run.
+	// These show up in the report and in the trace.
+	void record(const std::string& name, Clock::time_point start,
+				Clock::time_point end, const PhaseCounts& counts = PhaseCounts());
+
+	// Adds time to a phase that runs too often to trace each run
+	// (such as lexing a single token).
+	// These only show up in the report.
+	void accumulate(const std::string& name, Clock::duration time,
+					unsigned int count = 1, const PhaseCounts& counts = PhaseCounts());
+
+	// Adds the totals of every phase other recorded (such as a timer
+	// for a worker thread). These only show up in the report, and the
+	// time of phases that ran at once on several threads is added up.
+	void accumulate(const PhaseTimer& other);
+
+	// Writes a table with the total time of each phase
+	void printReport(std::ostream& output) const;
+
+	// Writes the recorded phases in the Chrome trace event format
+	// (load it in chrome://tracing).
+	// Returns false if the file can't be written.
+	bool writeTrace(const std::string& fileName) const;
+
+	// The timer phases on this thread are recorded to
+	// (null if timing is off)
+	static PhaseTimer* getActive() noexcept;
+	static void setActive(PhaseTimer* timer) noexcept;
+
+private:
+	// Disallow copy/assignment
+	PhaseTimer(const PhaseTimer& copy);
+	PhaseTimer& operator=(const PhaseTimer& rhs);
+
+	// A single run of a phase
+	struct Event
+	{
+		std::string mName;
+		Clock::time_point mStart;
+		Clock::time_point mEnd;
+		PhaseCounts mCounts;
+	};
+
+	// Every run of a phase, added together
+	struct Total
+	{
+		std::string mName;
+		Clock::duration mTime;
+		unsigned int mCount;
+		PhaseCounts mCounts;
+	};
+
+	// Returns the totals for this phase, adding it if it's new
+	Total& getTotal(const std::string& name);
+
+	// Writes the report rows for the phases nested directly
+	// under parent (or the top level phases, if parent is empty)
+	void printPhases(std::ostream& output, const std::string& parent,
+					 size_t depth, double wallTime) const;
+
+	// Returns true if the report/trace should include the hardware counts
+	bool showPerfCounts() const noexcept
+	{
+		return mCounters && mCounters->isAvailable();
+	}
+
+	// When the timer was created
+	Clock::time_point mStart;
+	// Events in the order they finished
+	std::vector<Event> mEvents;
+	// Totals in the order each phase was first seen
+	std::vector<Total> mTotals;
+	// Hardware counters (null unless enableCounters was called)
+	std::unique_ptr<PerfCounters> mCounters;
+	// Whether --mem-report is on
+	bool mTrackMemory;
+};
+
+// Records the time from construction to destruction as a phase
+// on the active timer
+class PhaseScope
+{
+public:
+	PhaseScope(const char* name) noexcept
+	: mTimer(PhaseTimer::getActive())
+	, mName(name)
+	{
+		if (mTimer)
+		{
+			mStartCounts = mTimer->readCounters();
+			mStart = PhaseTimer::Clock::now();
+		}
+	}
+
+	~PhaseScope()
+	{
+		if (mTimer)
+		{
+			PhaseTimer::Clock::time_point end = PhaseTimer::Clock::now();
+			mTimer->record(mName, mStart, end, mTimer->readCounters() - mStartCounts);
+		}
+	}
+
+private:
+	// Disallow copy/assignment
+	PhaseScope(const PhaseScope& copy);
+	PhaseScope& operator=(const PhaseScope& rhs);
+
+	PhaseTimer* mTimer;
+	const char* mName;
+	PhaseTimer::Clock::time_point mStart;
+	PhaseCounts mStartCounts;
+};
+
+// Makes a timer active for as long as it's in scope
+class ActivePhaseTimer
+{
+public:
+	ActivePhaseTimer(PhaseTimer* timer) noexcept
+	: mPrevious(PhaseTimer::getActive())
+	{
+		PhaseTimer::setActive(timer);
+	}
+
+	~ActivePhaseTimer()
+	{
+		PhaseTimer::setActive(mPrevious);
+	}
+
+private:
+	// Disallow copy/assignment
+	ActivePhaseTimer(const ActivePhaseTimer& copy);
+	ActivePhaseTimer& operator=(const ActivePhaseTimer& rhs);
+
+	PhaseTimer* mPrevious;
+};
+
+} // support
+} // uscc
+
+// The same as a PhaseScope, for code that's built outside uscc and
+// can't link against it (the RAUSCC register allocator is built into
+// LLVM's code generator, which llc links too). That code declares
+// these weak, and skips timing when they're missing.
+// usccBeginPhase returns null if there's no active timer.
+extern "C" void* usccBeginPhase(const char* name);
+extern "C" void usccEndPhase(void* phase);
@@ -0,0 +1,152 @@
+#---------------------------------------------------------
+# Copyright (c) 2014, Sanjay Madhav
+# All rights reserved.
+#
+# This file is distributed under the BSD license.
+# See LICENSE.TXT for details.
+#---------------------------------------------------------
+import subprocess
+import os
+import sys
+import shutil
+import tempfile
+
+import unittest
+uscc = "../bin/uscc"
+lli = "../../bin/lli"
+
+__unittest = True
+
+class ASTTests(unittest.TestCase):
+
+	def setUp(self):
+		self.maxDiff = None
+		if not os.path.isfile(uscc):
+			raise Exception("Can't run without uscc")
+		self.tempDir = tempfile.mkdtemp()
+
+	def tearDown(self):
+		shutil.rmtree(self.tempDir)
+
+	def saveAST(self, fileName, extraArgs=[]):
+		astFile = os.path.join(self.tempDir, fileName + ".ast")
+		try:
+			subprocess.check_output([uscc, "--emit-ast", astFile] + extraArgs + [fileName + ".usc"],
+									stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+		return astFile
+
+	def checkAST(self, fileName, extraArgs=[]):
+		# loading the saved AST has to print the same as parsing the source
+		expectFile = open("expected/" + fileName + ".semant.ast", "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		astFile = self.saveAST(fileName, extraArgs)
+		try:
+			resultStr = subprocess.check_output([uscc, "-a", "-l", astFile], stderr=subprocess.STDOUT)
+			self.assertMultiLineEqual(expectedStr, resultStr)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+
+	def test_AST_quicksort(self):
+		self.checkAST("quicksort")
+
+	def test_AST_015(self):
+		self.checkAST("test015")
+
+	def test_AST_parallel(self):
+		self.checkAST("quicksort", ["-fparallel-parse", "4"])
+
+	def test_AST_emit(self):
+		if not os.path.isfile(lli):
+			raise Exception("lli not found at ../../bin/lli")
+		expectFile = open("expected/emit02.output", "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		astFile = self.saveAST("emit02")
+		bcFile = os.path.join(self.tempDir, "emit02.bc")
+		try:
+			subprocess.check_output([uscc, "-o", bcFile, astFile], stderr=subprocess.STDOUT)
+			resultStr = subprocess.check_output([lli, bcFile], stderr=subprocess.STDOUT)
+			self.assertMultiLineEqual(expectedStr, resultStr)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+
+	def test_AST_long(self):
+		# chains of 100,000 terms, saved and then loaded and saved again
+		fileName = os.path.join(self.tempDir, "long")
+		srcFile = open(fileName + ".usc", "w")
+		srcFile.write("int main()\n{\n\tint x;\n")
+		srcFile.write("\tx = " + " + ".join([str(i % 10) for i in range(100000)]) + ";\n")
+		srcFile.write("\tx = " + " * ".join(["x"] * 100000) + ";\n")
+		srcFile.write("\tif (" + " || ".join(["x < " + str(i) for i in range(100000)]) + ")\n")
+		srcFile.write("\t\tx = " + " && ".join(["x == 1"] * 100000) + ";\n")
+		srcFile.write("\treturn x;\n}\n")
+		srcFile.close()
+		astFile = self.saveAST(fileName, ["-l"])
+		reloadFile = os.path.join(self.tempDir, "reload.ast")
+		try:
+			subprocess.check_output([uscc, "--emit-ast", reloadFile, "-l", astFile], stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+		first = open(astFile, "rb")
+		second = open(reloadFile, "rb")
+		self.assertEqual(first.read(), second.read())
+		first.close()
+		second.close()
+
+	def test_AST_longEmit(self):
+		# chains of 100,000 && and || terms, compiled to bitcode and run
+		if not os.path.isfile(lli):
+			raise Exception("lli not found at ../../bin/lli")
+		fileName = os.path.join(self.tempDir, "longEmit")
+		srcFile = open(fileName + ".usc", "w")
+		srcFile.write("int main()\n{\n\tint x;\n\tx = 1;\n")
+		srcFile.write("\tif (" + " && ".join(["x == 1"] * 100000) + ")\n")
+		srcFile.write("\t\tprintf(\"and\\n\");\n")
+		srcFile.write("\tif (" + " || ".join(["x < 0"] * 99999 + ["x == 1"]) + ")\n")
+		srcFile.write("\t\tprintf(\"or\\n\");\n")
+		srcFile.write("\treturn 0;\n}\n")
+		srcFile.close()
+		bcFile = fileName + ".bc"
+		try:
+			subprocess.check_output([uscc, "-o", bcFile, fileName + ".usc"], stderr=subprocess.STDOUT)
+			resultStr = subprocess.check_output([lli, bcFile], stderr=subprocess.STDOUT)
+			self.assertMultiLineEqual("and\nor\n", resultStr)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+
+	def checkRejected(self, args, message):
+		astFile = os.path.join(self.tempDir, "rejected.ast")
+		process = subprocess.Popen([uscc, "--emit-ast", astFile] + args,
+								   stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+		output = process.communicate()[0]
+		self.assertNotEqual(0, process.returncode)
+		self.assertIn(message, output)
+		self.assertFalse(os.path.exists(astFile))
+
+	def test_AST_multipleInputs(self):
+		self.checkRejected(["quicksort.usc", "test015.usc"],
+						   "uscc: error: --emit-ast cannot be used with more than one input file.")
+
+	def test_AST_wholeProgram(self):
+		self.checkRejected(["--whole-program", "prog01a.usc", "prog01b.usc"],
+						   "uscc: error: --emit-ast cannot be used with --whole-program.")
+
+	def test_AST_truncated(self):
+		astFile = self.saveAST("quicksort")
+		f = open(astFile, "rb")
+		data = f.read()
+		f.close()
+		f = open(astFile, "wb")
+		f.write(data[:len(data) / 2])
+		f.close()
+		try:
+			subprocess.check_output([uscc, "-a", "-l", astFile], stderr=subprocess.STDOUT)
+			self.fail("\nA truncated AST file was loaded")
+		except subprocess.CalledProcessError as e:
+			self.assertIn("uscc: error: " + astFile + ": AST file", e.output)
+
+if __name__ == '__main__':
+	unittest.main(verbosity=2)
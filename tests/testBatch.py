@@ -0,0 +1,47 @@
+#---------------------------------------------------------
+# Copyright (c) 2014, Sanjay Madhav
+# All rights reserved.
+#
+# This file is distributed under the BSD license.
+# See LICENSE.TXT for details.
+#---------------------------------------------------------
+import subprocess
+import os
+import sys
+
+import unittest
+uscc = "../bin/uscc"
+
+__unittest = True
+
+class BatchTests(unittest.TestCase):
+
+	def setUp(self):
+		self.maxDiff = None
+		if not os.path.isfile(uscc):
+			raise Exception("Can't run without uscc")
+
+	def checkBatch(self, fileNames, threads):
+		# the expected output is each file's AST, in the order given
+		expectedStr = ""
+		for fileName in fileNames:
+			expectFile = open("expected/" + fileName + ".ast", "r")
+			expectedStr += expectFile.read()
+			expectFile.close()
+		args = [uscc, "-j", str(threads), "-a"]
+		args += [fileName + ".usc" for fileName in fileNames]
+		try:
+			resultStr = subprocess.check_output(args, stderr=subprocess.STDOUT)
+			self.assertMultiLineEqual(expectedStr, resultStr)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+
+	def test_Batch_single_thread(self):
+		self.checkBatch(["test001", "test002", "test003", "quicksort"], 1)
+
+	def test_Batch_order(self):
+		self.checkBatch(["quicksort", "test019", "test001", "test010",
+			"test004", "test017", "test002", "test018"], 4)
+
+if __name__ == '__main__':
+	unittest.main(verbosity=2)
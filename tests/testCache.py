@@ -0,0 +1,123 @@
+#---------------------------------------------------------
+# Copyright (c) 2014, Sanjay Madhav
+# All rights reserved.
+#
+# This file is distributed under the BSD license.
+# See LICENSE.TXT for details.
+#---------------------------------------------------------
+import subprocess
+import os
+import sys
+import shutil
+import tempfile
+
+import unittest
+uscc = "../bin/uscc"
+lli = "../../bin/lli"
+
+__unittest = True
+
+class CacheTests(unittest.TestCase):
+
+	def setUp(self):
+		self.maxDiff = None
+		if not os.path.isfile(uscc):
+			raise Exception("Can't run without uscc")
+		self.cacheDir = tempfile.mkdtemp()
+
+	def tearDown(self):
+		shutil.rmtree(self.cacheDir)
+
+	def compile(self, fileName, outFile, extraArgs=[], cacheArg="--cache-dir"):
+		# storing an entry needs the same IR emission testEmit checks with lli
+		if not os.path.isfile(lli):
+			raise Exception("lli not found at ../../bin/lli")
+		args = [uscc, cacheArg, self.cacheDir] + extraArgs
+		args += ["-o", outFile, fileName + ".usc"]
+		try:
+			subprocess.check_output(args, stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+		bcFile = open(outFile, "rb")
+		bitcode = bcFile.read()
+		bcFile.close()
+		os.remove(outFile)
+		return bitcode
+
+	def checkNotCached(self, args, returnCode=0):
+		process = subprocess.Popen([uscc, "--cache-dir", self.cacheDir] + args,
+								   stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+		output = process.communicate()[0]
+		self.assertEqual(returnCode, process.returncode, output)
+		self.assertEqual([], self.cacheEntries())
+
+	def cacheEntries(self):
+		return [name for name in os.listdir(self.cacheDir) if name.endswith(".bc")]
+
+	def entryInodes(self):
+		# storing an entry renames a new file over it, so its inode changes
+		return dict([(name, os.stat(os.path.join(self.cacheDir, name)).st_ino)
+					 for name in self.cacheEntries()])
+
+	def runBitcode(self, bitcode):
+		bcFile = os.path.join(self.cacheDir, "run.bc.out")
+		f = open(bcFile, "wb")
+		f.write(bitcode)
+		f.close()
+		try:
+			return subprocess.check_output([lli, bcFile], stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+		finally:
+			os.remove(bcFile)
+
+	def test_Cache_hit(self):
+		first = self.compile("emit01", "cache01.bc")
+		self.assertEqual(1, len(self.cacheEntries()))
+		second = self.compile("emit01", "cache02.bc")
+		self.assertEqual(1, len(self.cacheEntries()))
+		self.assertEqual(first, second)
+
+	def test_Cache_flags(self):
+		self.compile("opt01", "cache01.bc")
+		self.compile("opt01", "cache02.bc", ["-O"])
+		self.assertEqual(2, len(self.cacheEntries()))
+
+	def test_Cache_errors(self):
+		# a failed compile has nothing to store
+		self.checkNotCached(["-o", os.path.join(self.cacheDir, "parse01e.out"), "parse01e.usc"], 1)
+		self.assertFalse(os.path.exists(os.path.join(self.cacheDir, "parse01e.out")))
+
+	def test_Cache_printAST(self):
+		# -a prints more than the bitcode, so it skips the cache
+		self.checkNotCached(["-a", "emit01.usc"])
+
+	def test_Cache_emitAST(self):
+		astFile = os.path.join(self.cacheDir, "emit01.ast")
+		self.checkNotCached(["--emit-ast", astFile, "emit01.usc"])
+		self.assertTrue(os.path.isfile(astFile))
+
+	def test_FuncCache_errors(self):
+		# a file that doesn't parse stores no functions
+		process = subprocess.Popen([uscc, "--func-cache", self.cacheDir,
+									"-o", os.path.join(self.cacheDir, "parse01e.out"), "parse01e.usc"],
+								   stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+		output = process.communicate()[0]
+		self.assertEqual(1, process.returncode, output)
+		self.assertEqual([], self.cacheEntries())
+
+	def test_FuncCache_reuse(self):
+		expectFile = open("expected/quicksort.output", "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		first = self.compile("quicksort", "cache01.bc", [], "--func-cache")
+		entries = self.entryInodes()
+		self.assertEqual(3, len(entries))
+		second = self.compile("quicksort", "cache02.bc", [], "--func-cache")
+		# every function came from the cache, so none was stored again
+		self.assertEqual(entries, self.entryInodes())
+		self.assertMultiLineEqual(expectedStr, self.runBitcode(first))
+		self.assertMultiLineEqual(expectedStr, self.runBitcode(second))
+
+if __name__ == '__main__':
+	unittest.main(verbosity=2)
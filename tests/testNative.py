@@ -0,0 +1,78 @@
+#---------------------------------------------------------
+# Copyright (c) 2014, Sanjay Madhav
+# All rights reserved.
+#
+# This file is distributed under the BSD license.
+# See LICENSE.TXT for details.
+#---------------------------------------------------------
+import subprocess
+import os
+import sys
+
+import unittest
+uscc = "../bin/uscc"
+lli = "../../bin/lli"
+cc = "cc"
+
+__unittest = True
+
+class NativeTests(unittest.TestCase):
+	
+	def setUp(self):
+		self.maxDiff = None
+		if not os.path.isfile(uscc):
+			raise Exception("Can't run without uscc")
+
+	def checkNative(self, fileName, outFile, extraArgs=[]):
+		# native output needs the same IR emission testEmit checks with lli
+		if not os.path.isfile(lli):
+			raise Exception("lli not found at ../../bin/lli")
+		# read in expected
+		expectFile = open("expected/" + fileName + ".output", "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		# compile to assembly or an object file with uscc, then link it
+		try:
+			subprocess.check_output([uscc] + extraArgs + ["-o", outFile, fileName + ".usc"],
+				stderr=subprocess.STDOUT)
+			subprocess.check_output([cc, "-o", fileName + ".native", outFile],
+				stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+		finally:
+			if os.path.isfile(outFile):
+				os.remove(outFile)
+		
+		# now run it and compare the output
+		try:
+			resultStr = subprocess.check_output(["./" + fileName + ".native"],
+				stderr=subprocess.STDOUT)
+			self.assertMultiLineEqual(expectedStr, resultStr)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+		finally:
+			os.remove(fileName + ".native")
+			
+	def test_Native_errors(self):
+		# a file that doesn't parse gets no object file
+		process = subprocess.Popen([uscc, "-c", "-o", "parse01e.o", "parse01e.usc"],
+			stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+		output = process.communicate()[0]
+		self.assertNotEqual(0, process.returncode)
+		self.assertIn("Error(s)", output)
+		self.assertFalse(os.path.isfile("parse01e.o"))
+		
+	def test_Native_object(self):
+		self.checkNative("quicksort", "quicksort.o", ["-c"])
+		
+	def test_Native_assembly(self):
+		self.checkNative("quicksort", "quicksort.s", ["-s"])
+		
+	def test_Native_opt(self):
+		self.checkNative("emit08", "emit08.o", ["-c", "-O", "-mcpu", "native"])
+		
+	def test_Native_regalloc(self):
+		self.checkNative("emit08", "emit08.o", ["-c", "--regalloc", "basic"])
+
+if __name__ == '__main__':
+	unittest.main(verbosity=2)
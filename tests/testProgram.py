@@ -0,0 +1,71 @@
+#---------------------------------------------------------
+# Copyright (c) 2014, Sanjay Madhav
+# All rights reserved.
+#
+# This file is distributed under the BSD license.
+# See LICENSE.TXT for details.
+#---------------------------------------------------------
+import subprocess
+import os
+import sys
+
+import unittest
+uscc = "../bin/uscc"
+lli = "../../bin/lli"
+
+__unittest = True
+
+class ProgramTests(unittest.TestCase):
+	
+	def setUp(self):
+		self.maxDiff = None
+		if not os.path.isfile(uscc):
+			raise Exception("Can't run without uscc")
+
+	def checkProgram(self, fileNames, expectName, extraArgs=[]):
+		# running needs the same IR emission testEmit checks with lli
+		if not os.path.isfile(lli):
+			raise Exception("lli not found at ../../bin/lli")
+		# read in expected
+		expectFile = open("expected/" + expectName + ".output", "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		# compile all the files as one program, and run it
+		args = [uscc, "--whole-program", "--run"] + extraArgs
+		args += [fileName + ".usc" for fileName in fileNames]
+		try:
+			resultStr = subprocess.check_output(args, stderr=subprocess.STDOUT)
+			self.assertMultiLineEqual(expectedStr, resultStr)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+			
+	def test_Program_prog01(self):
+		self.checkProgram(["prog01a", "prog01b"], "prog01")
+		
+	def test_Program_prog01_order(self):
+		self.checkProgram(["prog01b", "prog01a"], "prog01")
+		
+	def test_Program_prog01_parallel(self):
+		self.checkProgram(["prog01a", "prog01b"], "prog01", ["-O2", "-j", "2"])
+		
+	def checkRejected(self, fileNames, message):
+		args = [uscc, "--whole-program"] + [fileName + ".usc" for fileName in fileNames]
+		process = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+		output = process.communicate()[0]
+		self.assertNotEqual(0, process.returncode)
+		self.assertIn(message, output)
+		
+	def test_Program_redefined(self):
+		self.checkRejected(["prog01b", "prog02e"],
+			"Function 'sum' is defined in both prog01b.usc and prog02e.usc")
+		
+	def test_Program_redefined_order(self):
+		self.checkRejected(["prog02e", "prog01b"],
+			"Function 'sum' is defined in both prog02e.usc and prog01b.usc")
+		
+	def test_Program_missing(self):
+		self.checkRejected(["prog01a", "missing"],
+			"uscc: error: Input file missing.usc not found.")
+
+if __name__ == '__main__':
+	unittest.main(verbosity=2)
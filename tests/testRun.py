@@ -0,0 +1,109 @@
+#---------------------------------------------------------
+# Copyright (c) 2014, Sanjay Madhav
+# All rights reserved.
+#
+# This file is distributed under the BSD license.
+# See LICENSE.TXT for details.
+#---------------------------------------------------------
+import subprocess
+import os
+import sys
+
+import unittest
+uscc = "../bin/uscc"
+lli = "../../bin/lli"
+
+__unittest = True
+
+class RunTests(unittest.TestCase):
+	
+	def setUp(self):
+		self.maxDiff = None
+		if not os.path.isfile(uscc):
+			raise Exception("Can't run without uscc")
+
+	def requireEmit(self):
+		# running needs the same IR emission testEmit checks with lli
+		if not os.path.isfile(lli):
+			raise Exception("lli not found at ../../bin/lli")
+
+	def checkRun(self, fileName, extraArgs=[]):
+		self.requireEmit()
+		# read in expected
+		expectFile = open("expected/" + fileName + ".output", "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		# testEmit may have left a .bc behind
+		if os.path.isfile(fileName + ".bc"):
+			os.remove(fileName + ".bc")
+		# compile and run it in uscc
+		try:
+			resultStr = subprocess.check_output([uscc, "--run"] + extraArgs + [fileName + ".usc"],
+				stderr=subprocess.STDOUT)
+			self.assertMultiLineEqual(expectedStr, resultStr)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+		# --run doesn't write bitcode
+		self.assertFalse(os.path.isfile(fileName + ".bc"))
+			
+	def test_Run_errors(self):
+		# a file that doesn't parse is never run
+		process = subprocess.Popen([uscc, "--run", "parse01e.usc"],
+			stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+		output = process.communicate()[0]
+		self.assertNotEqual(0, process.returncode)
+		self.assertIn("Error(s)", output)
+		self.assertFalse(os.path.isfile("parse01e.bc"))
+		
+	def test_Run_emit02(self):
+		self.checkRun("emit02")
+		
+	def test_Run_emit08(self):
+		self.checkRun("emit08")
+		
+	def test_Run_quicksort(self):
+		self.checkRun("quicksort")
+		
+	def test_Run_quicksort_opt(self):
+		self.checkRun("quicksort", ["-O"])
+		
+	def test_Run_quicksort_O2(self):
+		self.checkRun("quicksort", ["-O2"])
+		
+	def test_Run_quicksort_O3(self):
+		self.checkRun("quicksort", ["-O3"])
+		
+	def test_Run_emit08_passes(self):
+		self.checkRun("emit08", ["--passes", "licm,constops,deadblocks,constops"])
+
+	def test_Run_listPasses(self):
+		# every name test_Run_emit08_passes uses has to be listed
+		try:
+			resultStr = subprocess.check_output([uscc, "--list-passes"], stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+		names = resultStr.split()
+		for name in ["licm", "constops", "deadblocks"]:
+			self.assertIn(name, names)
+
+	def test_Run_quicksort_parallel(self):
+		self.checkRun("quicksort", ["-O2", "-fparallel-codegen", "4"])
+		
+	def test_Run_parallel_identical(self):
+		# The bitcode must not depend on the number of threads
+		self.requireEmit()
+		bitcode = []
+		for threads in ["1", "4"]:
+			try:
+				subprocess.check_output([uscc, "-O3", "-fparallel-codegen", threads,
+					"-o", "parallel.bc", "quicksort.usc"], stderr=subprocess.STDOUT)
+			except subprocess.CalledProcessError as e:
+				self.fail("\n" + e.output)
+			bcFile = open("parallel.bc", "rb")
+			bitcode.append(bcFile.read())
+			bcFile.close()
+			os.remove("parallel.bc")
+		self.assertEqual(bitcode[0], bitcode[1])
+
+if __name__ == '__main__':
+	unittest.main(verbosity=2)
@@ -0,0 +1,69 @@
+#---------------------------------------------------------
+# Copyright (c) 2014, Sanjay Madhav
+# All rights reserved.
+#
+# This file is distributed under the BSD license.
+# See LICENSE.TXT for details.
+#---------------------------------------------------------
+import subprocess
+import os
+import sys
+import glob
+
+import unittest
+scanbench = "../bin/scanbench"
+uscc = "../bin/uscc"
+
+__unittest = True
+
+class ScanTests(unittest.TestCase):
+
+	def setUp(self):
+		self.maxDiff = None
+		if not os.path.isfile(scanbench):
+			raise Exception("Can't run without scanbench")
+
+	def checkScan(self, fileNames):
+		# the hand-written scanner has to match flex token for token
+		try:
+			subprocess.check_output([scanbench, "--check"] + fileNames, stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+
+	def checkParallel(self, fileName, expectedFile):
+		# lexing on another thread has to give the same output
+		expectFile = open("expected/" + expectedFile, "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		try:
+			resultStr = subprocess.check_output([uscc, "-fparallel-scan", "-a", "-l", fileName + ".usc"],
+												stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			resultStr = e.output.replace('\r\n','\n')
+		self.assertMultiLineEqual(expectedStr, resultStr)
+
+	def test_Scan_scan01(self):
+		self.checkScan(["scan01.usc"])
+
+	def test_Scan_scan02(self):
+		self.checkScan(["scan02.usc"])
+
+	def test_Scan_all(self):
+		self.checkScan(sorted(glob.glob("*.usc")))
+
+	def test_Scan_bench(self):
+		# a small run, just to make sure both scanners agree on the token count
+		try:
+			subprocess.check_output([scanbench, "--size", "1", "--iterations", "1", "quicksort.usc"],
+									stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+
+	def test_Scan_parallel_quicksort(self):
+		self.checkParallel("quicksort", "quicksort.semant.ast")
+
+	def test_Scan_parallel_semant07e(self):
+		self.checkParallel("semant07e", "semant07e.semant.err")
+
+if __name__ == '__main__':
+	unittest.main(verbosity=2)
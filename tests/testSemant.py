@@ -8,6 +8,8 @@
 import subprocess
 import os
 import sys
+import shutil
+import tempfile
 
 import unittest
 uscc = "../bin/uscc"
@@ -45,6 +47,18 @@ class SemantTests(unittest.TestCase):
 			outputStr = outputStr.replace('\r\n','\n')
 			self.assertMultiLineEqual(expectedStr, outputStr)
 
+	def checkParallel(self, fileName, expectedFile):
+		# parsing the functions on several threads has to give the same output
+		expectFile = open("expected/" + expectedFile, "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		try:
+			resultStr = subprocess.check_output([uscc, "-fparallel-parse", "4", "-a", "-l", fileName + ".usc"],
+												stderr=subprocess.STDOUT)
+		except subprocess.CalledProcessError as e:
+			resultStr = e.output.replace('\r\n','\n')
+		self.assertMultiLineEqual(expectedStr, resultStr)
+
 	def test_Sem_001(self):
 		self.checkAST("test001")
 
@@ -182,5 +196,37 @@ class SemantTests(unittest.TestCase):
 
 	def test_Sem_018(self):
 		self.checkAST("semant15")
+
+	def test_Sem_parallel_quicksort(self):
+		self.checkParallel("quicksort", "quicksort.semant.ast")
+
+	def test_SemErr_parallel_semant05e(self):
+		self.checkParallel("semant05e", "semant05e.semant.err")
+
+	def test_SemErr_parallel_parse03e(self):
+		# a syntax error falls back to one parse
+		self.checkParallel("parse03e", "parse03e.err")
+
+	def test_SemErr_long(self):
+		# an expression of 100,000 terms (one per line) with an error in the last one
+		tempDir = tempfile.mkdtemp()
+		try:
+			fileName = os.path.join(tempDir, "long.usc")
+			srcFile = open(fileName, "w")
+			srcFile.write("int main()\n{\n\tint x;\n\tx = 0")
+			for i in range(1, 100000):
+				srcFile.write("\n\t\t+ " + str(i % 10))
+			srcFile.write("\n\t\t+ \"a\";\n\treturn x;\n}\n")
+			srcFile.close()
+			expectedStr = fileName + ":100004:3: error: Cannot perform op between type int and char[]\n"
+			expectedStr += "\t\t+ \"a\";\n\t\t^\n1 Error(s)\n"
+			try:
+				resultStr = subprocess.check_output([uscc, "-a", "-l", fileName], stderr=subprocess.STDOUT)
+			except subprocess.CalledProcessError as e:
+				resultStr = e.output.replace('\r\n','\n')
+			self.assertMultiLineEqual(expectedStr, resultStr)
+		finally:
+			shutil.rmtree(tempDir)
+
 if __name__ == '__main__':
 	unittest.main(verbosity=2)
@@ -0,0 +1,62 @@
+#---------------------------------------------------------
+# Copyright (c) 2014, Sanjay Madhav
+# All rights reserved.
+#
+# This file is distributed under the BSD license.
+# See LICENSE.TXT for details.
+#---------------------------------------------------------
+import subprocess
+import os
+import sys
+
+import unittest
+uscc = "../bin/uscc"
+
+__unittest = True
+
+class ServerTests(unittest.TestCase):
+
+	def setUp(self):
+		self.maxDiff = None
+		if not os.path.isfile(uscc):
+			raise Exception("Can't run without uscc")
+
+	def readExpected(self, fileName):
+		expectFile = open("expected/" + fileName + ".ast", "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		return expectedStr
+
+	def readResponses(self, output, count):
+		# each response is a status line followed by stdout and stderr
+		responses = []
+		for i in range(count):
+			header, output = output.split("\n", 1)
+			fields = header.split(" ")
+			self.assertEqual("status", fields[0])
+			outLen = int(fields[2])
+			errLen = int(fields[3])
+			responses.append((int(fields[1]), output[:outLen], output[outLen:outLen + errLen]))
+			output = output[outLen + errLen:]
+		self.assertEqual("", output)
+		return responses
+
+	def test_Server_requests(self):
+		sourceFile = open("test002.usc", "r")
+		source = sourceFile.read()
+		sourceFile.close()
+		requests = "compile -a test001.usc\n"
+		requests += "source test002.usc " + str(len(source)) + " -a\n" + source
+		requests += "compile -a test003.usc\n"
+		requests += "quit\n"
+		proc = subprocess.Popen([uscc, "--serve"], stdin=subprocess.PIPE,
+			stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+		output, errors = proc.communicate(requests)
+		self.assertEqual(0, proc.returncode)
+		responses = self.readResponses(output, 3)
+		for fileName, response in zip(["test001", "test002", "test003"], responses):
+			self.assertEqual(0, response[0], response[2])
+			self.assertMultiLineEqual(self.readExpected(fileName), response[1])
+
+if __name__ == '__main__':
+	unittest.main(verbosity=2)
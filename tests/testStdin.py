@@ -0,0 +1,74 @@
+#---------------------------------------------------------
+# Copyright (c) 2014, Sanjay Madhav
+# All rights reserved.
+#
+# This file is distributed under the BSD license.
+# See LICENSE.TXT for details.
+#---------------------------------------------------------
+import subprocess
+import os
+import sys
+
+import unittest
+uscc = "../bin/uscc"
+lli = "../../bin/lli"
+
+__unittest = True
+
+class StdinTests(unittest.TestCase):
+
+	def setUp(self):
+		self.maxDiff = None
+		if not os.path.isfile(uscc):
+			raise Exception("Can't run without uscc")
+
+	def compilePiped(self, fileName, args):
+		# pipe the source in, so uscc can't re-read it
+		sourceFile = open(fileName + ".usc", "r")
+		process = subprocess.Popen([uscc] + args, stdin=subprocess.PIPE,
+								   stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+		output = process.communicate(sourceFile.read())[0]
+		sourceFile.close()
+		return (process.returncode, output)
+
+	def checkError(self, fileName, expectName, args):
+		# read in expected, which names the file
+		expectFile = open("expected/" + expectName, "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		expectedStr = expectedStr.replace(fileName + ".usc:", "<stdin>:")
+		(returnCode, outputStr) = self.compilePiped(fileName, args + ["-"])
+		self.assertNotEqual(0, returnCode)
+		self.assertMultiLineEqual(expectedStr, outputStr.replace('\r\n','\n'))
+
+	def test_Stdin_parse04e(self):
+		self.checkError("parse04e", "parse04e.err", ["-a"])
+
+	def test_Stdin_semant07e(self):
+		self.checkError("semant07e", "semant07e.semant.err", ["-a", "-l"])
+
+	def test_Stdin_emit02(self):
+		# read in expected
+		expectFile = open("expected/emit02.output", "r")
+		expectedStr = expectFile.read()
+		expectFile.close()
+		# stream the bitcode straight into lli
+		(returnCode, bitcode) = self.compilePiped("emit02", ["-o", "-", "-"])
+		self.assertEqual(0, returnCode)
+		process = subprocess.Popen([lli, "-"], stdin=subprocess.PIPE,
+								   stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+		resultStr = process.communicate(bitcode)[0]
+		self.assertMultiLineEqual(expectedStr, resultStr)
+
+	def test_Stdin_print_ir(self):
+		# with -p, -o - only writes the IR
+		try:
+			expectedStr = subprocess.check_output([uscc, "-p", "emit02.usc"])
+		except subprocess.CalledProcessError as e:
+			self.fail("\n" + e.output)
+		(returnCode, resultStr) = self.compilePiped("emit02", ["-p", "-o", "-", "-"])
+		self.assertEqual(0, returnCode)
+		self.assertMultiLineEqual(expectedStr.replace("emit02.usc", "<stdin>"), resultStr)
+
+if __name__ == '__main__':
+	unittest.main(verbosity=2)
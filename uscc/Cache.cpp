@@ -0,0 +1,310 @@
+//
+//  Cache.cpp
+//  uscc
+//
+//  Implements the compile cache used by --cache-dir.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "Cache.h"
+#include "Driver.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MD5.h>
+#pragma clang diagnostic pop
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace uscc::driver;
+
+namespace
+{
+
+// Bump this whenever the bitcode uscc emits changes,
+// so stale entries are never used
+const char* sCacheVersion = "uscc v0.5 cache 1";
+
+// Used to keep the temporary file names of each thread distinct
+std::atomic<unsigned int> sTempCounter(0);
+
+// Copies the file at from to to. Returns true on success.
+bool copyFile(const std::string& from, const std::string& to)
+{
+	std::ifstream input(from, std::ios::binary);
+	if (!input.is_open())
+	{
+		return false;
+	}
+
+	std::ofstream output(to, std::ios::binary | std::ios::trunc);
+	if (!output.is_open())
+	{
+		return false;
+	}
+
+	output << input.rdbuf();
+	return output.good();
+}
+
+} // anonymous
+
+CompileCache::CompileCache(const std::string& directory, uint64_t maxBytes)
+: mDirectory(directory)
+, mMaxBytes(maxBytes)
+{
+	// It's fine if this fails because it already exists
+	::mkdir(mDirectory.c_str(), 0777);
+}
+
+std::string CompileCache::flagString(const CompileOptions& options)
+{
+	// Everything that changes the bitcode has to be in here
+	std::ostringstream flags;
+	flags << sCacheVersion << '\0'
+		<< "O" << options.mOptimize << '\0'
+		<< "level" << options.mOptLevel << '\0'
+		<< "passes" << options.mPasses << '\0';
+	return flags.str();
+}
+
+std::string CompileCache::computeKey(const std::string& source,
+									 const CompileOptions& options)
+{
+	std::string flags = flagString(options) + "emit-bc";
+
+	llvm::MD5 hash;
+	hash.update(llvm::StringRef(flags.data(), flags.size()));
+	hash.update(llvm::StringRef(source.data(), source.size()));
+
+	llvm::MD5::MD5Result result;
+	hash.final(result);
+
+	llvm::SmallString<32> hex;
+	llvm::MD5::stringifyResult(result, hex);
+	return hex.str().str();
+}
+
+bool CompileCache::fetch(const std::string& key, const std::string& outputFile)
+{
+	std::string entry = entryPath(key);
+	if (::access(entry.c_str(), R_OK) != 0)
+	{
+		return false;
+	}
+
+	// Copy to a new file and rename it over the output. The output is
+	// never a link to the entry: whatever rewrites the output in place
+	// later (such as an uncached compile) would change the entry too.
+	std::ostringstream temp;
+	temp << outputFile << ".tmp." << ::getpid() << '.' << sTempCounter++;
+	if (!copyFile(entry, temp.str()) ||
+		std::rename(temp.str().c_str(), outputFile.c_str()) != 0)
+	{
+		std::remove(temp.str().c_str());
+		return false;
+	}
+
+	// Mark the entry as recently used
+	::utimes(entry.c_str(), nullptr);
+	return true;
+}
+
+void CompileCache::store(const std::string& key, const std::string& file)
+{
+	// Write to a temporary name first, so no other process
+	// can ever see a partial entry
+	std::string temp = tempPath(key);
+	if (!copyFile(file, temp))
+	{
+		std::remove(temp.c_str());
+		return;
+	}
+
+	commit(key, temp);
+}
+
+bool CompileCache::load(const std::string& key, std::string& data)
+{
+	std::string entry = entryPath(key);
+	std::ifstream input(entry, std::ios::binary);
+	if (!input.is_open())
+	{
+		return false;
+	}
+
+	std::ostringstream contents;
+	contents << input.rdbuf();
+	if (input.bad())
+	{
+		return false;
+	}
+	data = contents.str();
+
+	// Mark the entry as recently used
+	::utimes(entry.c_str(), nullptr);
+	return true;
+}
+
+void CompileCache::storeData(const std::string& key, const std::string& data)
+{
+	std::string temp = tempPath(key);
+	{
+		std::ofstream output(temp, std::ios::binary | std::ios::trunc);
+		output.write(data.data(), static_cast<std::streamsize>(data.size()));
+		if (!output.good())
+		{
+			output.close();
+			std::remove(temp.c_str());
+			return;
+		}
+	}
+
+	commit(key, temp);
+}
+
+void CompileCache::remove(const std::string& key)
+{
+	std::remove(entryPath(key).c_str());
+}
+
+void CompileCache::commit(const std::string& key, const std::string& temp)
+{
+	if (std::rename(temp.c_str(), entryPath(key).c_str()) != 0)
+	{
+		std::remove(temp.c_str());
+		return;
+	}
+
+	trim();
+}
+
+std::string CompileCache::tempPath(const std::string& key) const
+{
+	std::ostringstream path;
+	path << entryPath(key) << ".tmp." << ::getpid() << '.' << sTempCounter++;
+	return path.str();
+}
+
+std::string CompileCache::entryPath(const std::string& key) const
+{
+	return mDirectory + "/" + key + ".bc";
+}
+
+void CompileCache::trim()
+{
+	struct Entry
+	{
+		std::string mPath;
+		time_t mLastUsed;
+		uint64_t mSize;
+	};
+
+	DIR* dir = ::opendir(mDirectory.c_str());
+	if (!dir)
+	{
+		return;
+	}
+
+	std::vector<Entry> entries;
+	uint64_t totalSize = 0;
+	while (dirent* file = ::readdir(dir))
+	{
+		std::string name = file->d_name;
+		if (name.size() < 3 || name.compare(name.size() - 3, 3, ".bc") != 0)
+		{
+			continue;
+		}
+
+		Entry entry;
+		entry.mPath = mDirectory + "/" + name;
+		struct stat info;
+		if (::stat(entry.mPath.c_str(), &info) != 0)
+		{
+			continue;
+		}
+		entry.mLastUsed = info.st_mtime;
+		entry.mSize = static_cast<uint64_t>(info.st_size);
+		totalSize += entry.mSize;
+		entries.push_back(entry);
+	}
+	::closedir(dir);
+
+	if (totalSize <= mMaxBytes)
+	{
+		return;
+	}
+
+	std::sort(entries.begin(), entries.end(),
+			  [](const Entry& a, const Entry& b) { return a.mLastUsed < b.mLastUsed; });
+
+	// Another process may be trimming at the same time,
+	// so it's fine if an entry is already gone
+	for (const auto& entry : entries)
+	{
+		if (totalSize <= mMaxBytes)
+		{
+			break;
+		}
+		std::remove(entry.mPath.c_str());
+		totalSize -= entry.mSize;
+	}
+}
+
+FunctionBitcodeCache::FunctionBitcodeCache(const std::string& directory,
+										   uint64_t maxBytes,
+										   const CompileOptions& options)
+: mCache(directory, maxBytes)
+, mFlags(CompileCache::flagString(options))
+{
+
+}
+
+bool FunctionBitcodeCache::load(const std::string& key, std::string& bitcode)
+{
+	return mCache.load(saltKey(key), bitcode);
+}
+
+void FunctionBitcodeCache::store(const std::string& key, const std::string& bitcode)
+{
+	mCache.storeData(saltKey(key), bitcode);
+}
+
+void FunctionBitcodeCache::remove(const std::string& key)
+{
+	mCache.remove(saltKey(key));
+}
+
+std::string FunctionBitcodeCache::saltKey(const std::string& key) const
+{
+	// The emitter's key only covers the function itself
+	std::string flags = mFlags + "func" + '\0' + key;
+
+	llvm::MD5 hash;
+	hash.update(llvm::StringRef(flags.data(), flags.size()));
+
+	llvm::MD5::MD5Result result;
+	hash.final(result);
+
+	llvm::SmallString<32> hex;
+	llvm::MD5::stringifyResult(result, hex);
+	return hex.str().str();
+}
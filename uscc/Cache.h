@@ -0,0 +1,104 @@
+//
+//  Cache.h
+//  uscc
+//
+//  Declares the compile cache used by --cache-dir.
+//
+//  Bitcode is stored under a key that hashes the source,
+//  the compiler version and every option that changes the
+//  bitcode. Entries are written to a temporary file and
+//  renamed into place, so several uscc processes can share
+//  one cache directory. Once the cache grows past its size
+//  cap, the least recently used entries are deleted.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include "../parse/Emitter.h"
+#include <cstdint>
+#include <string>
+
+namespace uscc
+{
+namespace driver
+{
+
+struct CompileOptions;
+
+class CompileCache
+{
+public:
+	CompileCache(const std::string& directory, uint64_t maxBytes);
+
+	// Returns the options that change the bitcode, in a form that
+	// can be hashed
+	static std::string flagString(const CompileOptions& options);
+
+	// Returns the key for this source compiled with these options
+	static std::string computeKey(const std::string& source,
+								  const CompileOptions& options);
+
+	// If there's an entry for key, copies it to
+	// outputFile and returns true
+	bool fetch(const std::string& key, const std::string& outputFile);
+
+	// Adds the bitcode in file to the cache under key,
+	// then trims the cache if it's over the size cap
+	void store(const std::string& key, const std::string& file);
+
+	// Reads the entry for key into data. Returns false if there isn't one.
+	bool load(const std::string& key, std::string& data);
+
+	// Adds data to the cache under key, then trims the cache
+	void storeData(const std::string& key, const std::string& data);
+
+	// Deletes the entry for key, if there is one
+	void remove(const std::string& key);
+
+private:
+	// Renames temp to the entry for key, then trims the cache
+	void commit(const std::string& key, const std::string& temp);
+
+	// Returns a temporary file name for an entry for key
+	std::string tempPath(const std::string& key) const;
+
+	// Returns the path of the entry for key
+	std::string entryPath(const std::string& key) const;
+
+	// Deletes the least recently used entries until the
+	// cache is under the size cap
+	void trim();
+
+	std::string mDirectory;
+	uint64_t mMaxBytes;
+};
+
+// Stores the bitcode of each function for --func-cache
+class FunctionBitcodeCache : public parse::FunctionCache
+{
+public:
+	FunctionBitcodeCache(const std::string& directory, uint64_t maxBytes,
+						 const CompileOptions& options);
+
+	bool load(const std::string& key, std::string& bitcode) override;
+	void store(const std::string& key, const std::string& bitcode) override;
+	void remove(const std::string& key) override;
+
+private:
+	// Returns key salted with everything else that changes the bitcode
+	std::string saltKey(const std::string& key) const;
+
+	CompileCache mCache;
+	// The options that change the bitcode of a function
+	std::string mFlags;
+};
+
+} // driver
+} // uscc
@@ -0,0 +1,748 @@
+//
+//  Driver.cpp
+//  uscc
+//
+//  Implements single file and batch compiles for the
+//  uscc driver.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "Driver.h"
+#include "Cache.h"
+#include "Run.h"
+#include "../parse/ASTFile.h"
+#include "../parse/Parse.h"
+#include "../parse/ParseExcept.h"
+#include "../parse/Emitter.h"
+#include "../support/MemoryStats.h"
+#include "../support/Parallel.h"
+#include "../support/Timing.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/raw_os_ostream.h>
+#pragma clang diagnostic pop
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace uscc;
+using namespace uscc::driver;
+
+namespace
+{
+
+// Everything we need to track for one file in a batch
+struct BatchJob
+{
+	BatchJob()
+	: mExitCode(0)
+	, mMilliseconds(0.0)
+	, mDone(false)
+	{ }
+
+	std::string mFileName;
+	std::ostringstream mOut;
+	std::ostringstream mErr;
+	int mExitCode;
+	double mMilliseconds;
+	// Guarded by the batch mutex
+	bool mDone;
+};
+
+// The name diagnostics use for source read from stdin
+const char* sStdinName = "<stdin>";
+
+// Returns true if this input or output file name means stdin/stdout
+bool isStdStream(const std::string& fileName)
+{
+	return fileName == "-";
+}
+
+// Returns the name of the file we should write to, if
+// -o wasn't specified
+std::string defaultOutputName(const std::string& fileName, const char* ext)
+{
+	std::string retVal = fileName;
+	if (retVal == sStdinName)
+	{
+		retVal = "stdin";
+	}
+	size_t extLoc = retVal.find_last_of(".");
+	if (extLoc != std::string::npos)
+	{
+		// Strip the last extension
+		retVal = retVal.substr(0, extLoc);
+	}
+	retVal += ext;
+	return retVal;
+}
+
+// Returns true if this compile writes assembly or an object file
+bool emitsNative(const CompileOptions& options)
+{
+	return options.mAssembly || options.mObject;
+}
+
+// Returns the name of the bitcode file for this compile
+std::string bitcodeFileName(const std::string& fileName, const CompileOptions& options)
+{
+	// If output file not specified, default is
+	// input file with the extension replaced with .bc
+	if (options.mOutputFile.empty() || emitsNative(options))
+	{
+		return defaultOutputName(fileName, ".bc");
+	}
+	return options.mOutputFile;
+}
+
+// Returns the name of the assembly or object file for this compile
+std::string nativeFileName(const std::string& fileName, const CompileOptions& options)
+{
+	// -o is ignored if -b is also given, since there are two outputs
+	if (options.mOutputFile.empty() || options.mForceBitcode)
+	{
+		return defaultOutputName(fileName, options.mAssembly ? ".s" : ".o");
+	}
+	return options.mOutputFile;
+}
+
+// Runs everything after emission: optimization, printing, verifying,
+// and writing (or running) the output. fileName picks the default
+// output file names.
+int finishCompile(parse::Emitter& emit, const std::string& fileName,
+				  const CompileOptions& options, std::ostream& out, std::ostream& err)
+{
+	emit.setOptThreads(options.mOptThreads);
+	
+	// Check if we should run optimization passes
+	if (!options.mPasses.empty())
+	{
+		std::string badName;
+		if (!emit.optimize(options.mPasses, badName))
+		{
+			err << "uscc: error: Unknown pass " << badName << " in --passes." << std::endl;
+			return 1;
+		}
+	}
+	else if (options.mOptimize)
+	{
+		emit.optimize(options.mOptLevel);
+	}
+
+	if (!emit.getSplitError().empty())
+	{
+		err << "uscc: warning: Couldn't optimize the functions separately ("
+			<< emit.getSplitError() << "), so -fparallel-codegen was ignored." << std::endl;
+	}
+
+	bool shouldEmitBC = true;
+	if ((emitsNative(options) || options.mRun) && !options.mForceBitcode)
+	{
+		shouldEmitBC = false;
+	}
+	
+	// With -p, -o - means the IR is what goes to stdout
+	std::string bcFile = bitcodeFileName(fileName, options);
+	if (options.mPrintIR && isStdStream(bcFile))
+	{
+		shouldEmitBC = false;
+	}
+
+	// Print the human readable bitcode
+	if (options.mPrintIR)
+	{
+		llvm::raw_os_ostream irStream(out);
+		emit.print(irStream);
+	}
+
+	// Before we write anything, verify the IR doesn't have major errors
+	bool verified = emit.verify();
+	if (!emit.getCacheError().empty())
+	{
+		err << "uscc: error: " << emit.getCacheError() << " Compilation halted." << std::endl;
+		return 1;
+	}
+	if (!verified)
+	{
+		err << std::endl;
+		err << "uscc: error: Emitted bad IR. Compilation halted." << std::endl;
+		return 1;
+	}
+
+	// Write the bitcode file
+	if (shouldEmitBC && isStdStream(bcFile))
+	{
+		llvm::raw_os_ostream bcStream(out);
+		emit.writeBitcode(bcStream);
+	}
+	else if (shouldEmitBC)
+	{
+		emit.writeBitcode(bcFile.c_str());
+	}
+	
+	// Write the assembly or object file
+	if (emitsNative(options))
+	{
+		std::string nativeFile = nativeFileName(fileName, options);
+		std::string error;
+		bool written;
+		if (isStdStream(nativeFile))
+		{
+			llvm::raw_os_ostream nativeStream(out);
+			written = options.mAssembly ?
+				emit.writeAsm(nativeStream, options.mTarget, error) :
+				emit.writeObject(nativeStream, options.mTarget, error);
+		}
+		else
+		{
+			written = options.mAssembly ?
+				emit.writeAsm(nativeFile.c_str(), options.mTarget, error) :
+				emit.writeObject(nativeFile.c_str(), options.mTarget, error);
+		}
+		if (!written)
+		{
+			err << "uscc: error: " << error << std::endl;
+			return 1;
+		}
+	}
+	
+	// Execute the verified module in this process, and
+	// exit with whatever the program's main returns
+	if (options.mRun)
+	{
+		out.flush();
+		return runModule(emit.releaseModule(), fileName, err);
+	}
+	
+	return 0;
+}
+
+// Runs the phases of a compile on source that's already in memory
+// (contents), or on source, or else on the file
+int runPhasesOn(const std::string& fileName, const std::string* contents, std::istream* source,
+				const CompileOptions& options, std::ostream& out, std::ostream& err)
+{
+	const char* fileNameStr = fileName.c_str();
+	std::ostream* astStream = nullptr;
+	if (options.mPrintAST)
+	{
+		astStream = &out;
+	}
+
+	try
+	{
+		std::unique_ptr<parse::Parser> parserPtr;
+		if (contents)
+		{
+			// Lexed like a mapped file, so -fparallel-scan
+			// and -fparallel-parse still apply
+			const char* begin = contents->data();
+			parserPtr.reset(new parse::Parser(fileNameStr, begin, begin + contents->size(),
+											  &err, astStream, options.mPrintSymbols,
+											  options.mParallelScan, options.mParseThreads));
+		}
+		else if (source)
+		{
+			parserPtr.reset(new parse::Parser(fileNameStr, *source, &err, astStream,
+											  options.mPrintSymbols));
+		}
+		else
+		{
+			// A file saved with --emit-ast doesn't need to be parsed again
+			parse::ASTReader reader(fileNameStr);
+			if (reader.isASTFile())
+			{
+				parserPtr.reset(new parse::Parser(reader, &err, astStream,
+												  options.mPrintSymbols));
+			}
+			else
+			{
+				parserPtr.reset(new parse::Parser(fileNameStr, &err, astStream,
+												  options.mPrintSymbols, options.mParallelScan,
+												  options.mParseThreads));
+			}
+		}
+		parse::Parser& parser = *parserPtr;
+
+		if (!parser.IsValid())
+		{
+			err << parser.GetNumErrors() << " Error(s)" << std::endl;
+			return 1;
+		}
+
+		if (!options.mEmitASTFile.empty())
+		{
+			support::PhaseScope timeWrite("write AST");
+			parse::ASTWriter writer(parser);
+			std::ofstream astFile(options.mEmitASTFile, std::ios::binary);
+			if (!astFile.is_open() || !writer.write(astFile))
+			{
+				err << "uscc: error: Unable to write the AST to "
+					<< options.mEmitASTFile << "." << std::endl;
+				return 1;
+			}
+		}
+
+		// If we set -a or --emit-ast, we don't continue to later steps
+		if ((options.mPrintAST || !options.mEmitASTFile.empty()) &&
+			!options.mForceBitcode && !emitsNative(options) && !options.mPrintIR)
+		{
+			return 0;
+		}
+
+		// Each compile gets its own LLVM context, so compiles running
+		// on different threads never share any LLVM state
+		llvm::LLVMContext context;
+
+		// With --func-cache, only the functions that changed are emitted
+		std::unique_ptr<FunctionBitcodeCache> funcCache;
+		if (!options.mFuncCacheDir.empty())
+		{
+			funcCache.reset(new FunctionBitcodeCache(options.mFuncCacheDir,
+													 options.mCacheSize,
+													 options));
+		}
+
+		// Now emit LLVM bitcode
+		parse::Emitter emit(parser, context, funcCache.get());
+
+		return finishCompile(emit, fileName, options, out, err);
+	}
+	catch (parse::FileNotFound& fe)
+	{
+		err << "uscc: error: Input file " << fileName << " not found." << std::endl;
+	}
+	catch (parse::BadASTFile& e)
+	{
+		err << "uscc: error: " << fileName << ": " << e.what() << "." << std::endl;
+		return 1;
+	}
+	catch (parse::ParseExcept& e)
+	{
+		err << "uscc: error: Critical error. Compilation halted." << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+// Runs the phases of a compile (called by compile)
+int runPhases(const std::string& fileName, std::istream* source,
+			  const CompileOptions& options, std::ostream& out, std::ostream& err)
+{
+	return runPhasesOn(fileName, nullptr, source, options, out, err);
+}
+
+// Returns true if the only thing this compile produces is
+// the bitcode file, so it can come from the cache
+bool isCacheable(const CompileOptions& options)
+{
+	return !options.mCacheDir.empty() && !options.mRun &&
+		!options.mPrintAST && !options.mPrintSymbols && !options.mPrintIR &&
+		options.mEmitASTFile.empty() &&
+		!emitsNative(options) && !isStdStream(options.mOutputFile);
+}
+
+// Runs the compile through the cache (called by compile)
+int runCached(const std::string& fileName, std::istream* source,
+			  const CompileOptions& options, std::ostream& out, std::ostream& err)
+{
+	// The key needs the whole source, so read it in once
+	// and parse from memory on a miss
+	std::string contents;
+	bool fromFile = !source;
+	{
+		std::ifstream file;
+		if (!source)
+		{
+			file.open(fileName, std::ios::binary);
+			if (!file.is_open())
+			{
+				err << "uscc: error: Input file " << fileName << " not found." << std::endl;
+				return 0;
+			}
+			source = &file;
+		}
+		std::ostringstream buffer;
+		buffer << source->rdbuf();
+		contents = buffer.str();
+	}
+	
+	CompileCache cache(options.mCacheDir, options.mCacheSize);
+	std::string key = CompileCache::computeKey(contents, options);
+	std::string bcFile = bitcodeFileName(fileName, options);
+	{
+		support::PhaseScope timeLookup("cache lookup");
+		if (cache.fetch(key, bcFile))
+		{
+			return 0;
+		}
+	}
+	
+	// A saved AST is loaded from the file, not parsed
+	bool isAST = fromFile && parse::ASTReader::isASTData(contents.data(), contents.size());
+	int retVal = runPhasesOn(fileName, isAST ? nullptr : &contents, nullptr, options, out, err);
+	if (retVal == 0)
+	{
+		support::PhaseScope timeStore("cache store");
+		cache.store(key, bcFile);
+	}
+	return retVal;
+}
+
+// Runs the phases of a whole-program compile (called by compileProgram)
+int runProgram(const std::vector<std::string>& fileNames, const CompileOptions& options,
+			   unsigned int numThreads, std::ostream& out, std::ostream& err)
+{
+	if (!options.mEmitASTFile.empty())
+	{
+		err << "uscc: error: --emit-ast cannot be used with --whole-program." << std::endl;
+		return 1;
+	}
+	
+	size_t count = fileNames.size();
+	
+	// Each file is parsed twice, so read it in once
+	std::vector<std::string> sources(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		std::ostringstream buffer;
+		if (isStdStream(fileNames[i]))
+		{
+			buffer << std::cin.rdbuf();
+		}
+		else
+		{
+			std::ifstream file(fileNames[i], std::ios::binary);
+			if (!file.is_open())
+			{
+				err << "uscc: error: Input file " << fileNames[i] << " not found." << std::endl;
+				return 1;
+			}
+			buffer << file.rdbuf();
+		}
+		sources[i] = buffer.str();
+	}
+	
+	// First find the functions each file defines.
+	// (Any errors are reported by the full parse.)
+	std::vector<std::unique_ptr<std::istringstream>> signatureSources(count);
+	std::vector<std::unique_ptr<parse::Parser>> signatures(count);
+	{
+		support::PhaseScope timeSignatures("parse signatures");
+		support::parallelFor(count, numThreads, [&](size_t i)
+		{
+			signatureSources[i].reset(new std::istringstream(sources[i]));
+			signatures[i].reset(new parse::Parser(fileNames[i].c_str(), *signatureSources[i],
+												  nullptr, nullptr, false,
+												  parse::ParseMode::Signatures,
+												  std::vector<parse::ASTFunction*>()));
+		});
+	}
+	
+	// All the files share one function namespace
+	std::map<std::string, size_t> definedIn;
+	bool redefined = false;
+	for (size_t i = 0; i < count; i++)
+	{
+		for (auto func : signatures[i]->GetFunctions())
+		{
+			const std::string& name = func->getIdent().getName();
+			auto iter = definedIn.find(name);
+			if (iter != definedIn.end())
+			{
+				err << "uscc: error: Function '" << name << "' is defined in both "
+					<< fileNames[iter->second] << " and " << fileNames[i] << "." << std::endl;
+				redefined = true;
+			}
+			else
+			{
+				definedIn.emplace(name, i);
+			}
+		}
+	}
+	if (redefined)
+	{
+		return 1;
+	}
+	
+	// Now parse each file with the functions of the others declared
+	std::vector<std::unique_ptr<std::istringstream>> fullSources(count);
+	std::vector<std::unique_ptr<parse::Parser>> parsers(count);
+	std::vector<std::unique_ptr<std::ostringstream>> parseOut(count);
+	std::vector<std::unique_ptr<std::ostringstream>> parseErr(count);
+	{
+		support::PhaseScope timeParse("parse files");
+		support::parallelFor(count, numThreads, [&](size_t i)
+		{
+			std::vector<parse::ASTFunction*> externs;
+			for (size_t j = 0; j < count; j++)
+			{
+				if (j != i)
+				{
+					auto funcs = signatures[j]->GetFunctions();
+					externs.insert(externs.end(), funcs.begin(), funcs.end());
+				}
+			}
+			
+			fullSources[i].reset(new std::istringstream(sources[i]));
+			parseOut[i].reset(new std::ostringstream());
+			parseErr[i].reset(new std::ostringstream());
+			parsers[i].reset(new parse::Parser(fileNames[i].c_str(), *fullSources[i],
+											   parseErr[i].get(),
+											   options.mPrintAST ? parseOut[i].get() : nullptr,
+											   options.mPrintSymbols, parse::ParseMode::Full,
+											   externs));
+		});
+	}
+	
+	// Output is always in the order the files were given
+	size_t numErrors = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		out << parseOut[i]->str();
+		err << parseErr[i]->str();
+		numErrors += parsers[i]->GetNumErrors();
+	}
+	if (numErrors != 0)
+	{
+		err << numErrors << " Error(s)" << std::endl;
+		return 1;
+	}
+	
+	// If we set -a, we don't continue to later steps
+	if (options.mPrintAST &&
+		!options.mForceBitcode && !emitsNative(options) && !options.mPrintIR)
+	{
+		return 0;
+	}
+	
+	// An LLVM context can only be used by one thread, so the files
+	// are emitted one after another, then linked into one module
+	llvm::LLVMContext context;
+	std::vector<std::unique_ptr<parse::Emitter>> emitters;
+	for (size_t i = 0; i < count; i++)
+	{
+		emitters.emplace_back(new parse::Emitter(*parsers[i], context));
+	}
+	for (size_t i = 1; i < count; i++)
+	{
+		std::string error;
+		if (!emitters[0]->link(*emitters[i], error))
+		{
+			err << "uscc: error: Unable to link " << fileNames[i] << ": " << error << std::endl;
+			return 1;
+		}
+	}
+	
+	return finishCompile(*emitters[0], fileNames[0], options, out, err);
+}
+
+// Runs a compile with a phase timer, if any of the timing
+// options are set
+int runTimed(const CompileOptions& options, std::ostream& err,
+			 const std::function<int()>& run)
+{
+	if (!options.mTimeReport && options.mTimeTraceFile.empty() &&
+		!options.mPerfCounters && !options.mMemReport)
+	{
+		return run();
+	}
+	
+	// The counters only count this thread, which is the one
+	// that runs the compile
+	support::PhaseTimer timer;
+	if (options.mPerfCounters)
+	{
+		timer.enableCounters();
+	}
+	if (options.mMemReport)
+	{
+		support::enableAllocationTracking();
+		timer.enableMemoryReport();
+	}
+	
+	int retVal;
+	{
+		support::ActivePhaseTimer activeTimer(&timer);
+		retVal = run();
+	}
+	
+	if (options.mTimeReport || options.mPerfCounters || options.mMemReport)
+	{
+		timer.printReport(err);
+	}
+	
+	if (!options.mTimeTraceFile.empty() && !timer.writeTrace(options.mTimeTraceFile))
+	{
+		err << "uscc: error: Unable to write time trace " << options.mTimeTraceFile
+			<< "." << std::endl;
+		retVal = 1;
+	}
+	
+	return retVal;
+}
+
+// Shared implementation of compileFile/compileSource.
+// If source is null, the file is opened by the parser.
+int compile(const std::string& fileName, std::istream* source,
+			const CompileOptions& options, std::ostream& out, std::ostream& err)
+{
+	auto run = isCacheable(options) ? runCached : runPhases;
+	return runTimed(options, err, [&]()
+	{
+		return run(fileName, source, options, out, err);
+	});
+}
+
+} // anonymous
+
+int driver::compileFile(const std::string& fileName, const CompileOptions& options,
+						std::ostream& out, std::ostream& err)
+{
+	if (isStdStream(fileName))
+	{
+		// The parser records stdin as it reads it, so it
+		// can still show the lines with errors
+		return compile(sStdinName, &std::cin, options, out, err);
+	}
+	return compile(fileName, nullptr, options, out, err);
+}
+
+int driver::compileSource(const std::string& fileName, const std::string& source,
+						  const CompileOptions& options,
+						  std::ostream& out, std::ostream& err)
+{
+	std::istringstream sourceStream(source);
+	return compile(fileName, &sourceStream, options, out, err);
+}
+
+int driver::compileProgram(const std::vector<std::string>& fileNames,
+						   const CompileOptions& options, unsigned int numThreads,
+						   std::ostream& out, std::ostream& err)
+{
+	return runTimed(options, err, [&]()
+	{
+		return runProgram(fileNames, options, numThreads, out, err);
+	});
+}
+
+int driver::compileBatch(const std::vector<std::string>& fileNames,
+						 const CompileOptions& options,
+						 unsigned int numThreads, bool summary)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point batchStart = Clock::now();
+
+	std::vector<BatchJob> jobs(fileNames.size());
+	for (size_t i = 0; i < fileNames.size(); i++)
+	{
+		jobs[i].mFileName = fileNames[i];
+	}
+
+	if (numThreads == 0)
+	{
+		numThreads = 1;
+	}
+	if (numThreads > jobs.size())
+	{
+		numThreads = static_cast<unsigned int>(jobs.size());
+	}
+
+	std::atomic<size_t> nextJob(0);
+	std::mutex mutex;
+	std::condition_variable jobDone;
+
+	// Each worker grabs the next file that hasn't been started yet
+	auto worker = [&]()
+	{
+		for (;;)
+		{
+			size_t i = nextJob++;
+			if (i >= jobs.size())
+			{
+				break;
+			}
+
+			BatchJob& job = jobs[i];
+			Clock::time_point start = Clock::now();
+			job.mExitCode = compileFile(job.mFileName, options, job.mOut, job.mErr);
+			std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+			job.mMilliseconds = elapsed.count();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				job.mDone = true;
+			}
+			jobDone.notify_all();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < numThreads; i++)
+	{
+		threads.emplace_back(worker);
+	}
+
+	// Write out the results in input order, as soon as each one is done
+	int retVal = 0;
+	for (auto& job : jobs)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobDone.wait(lock, [&job]() { return job.mDone; });
+		}
+
+		std::cout << job.mOut.str();
+		std::cout.flush();
+		std::cerr << job.mErr.str();
+
+		if (job.mExitCode != 0)
+		{
+			retVal = 1;
+		}
+	}
+
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+
+	if (summary)
+	{
+		std::chrono::duration<double, std::milli> elapsed = Clock::now() - batchStart;
+		std::cerr << "uscc: compiled " << jobs.size() << " file(s) on "
+			<< numThreads << " thread(s) in " << std::fixed << std::setprecision(3)
+			<< elapsed.count() << " ms" << std::endl;
+		for (const auto& job : jobs)
+		{
+			std::cerr << std::setw(12) << job.mMilliseconds << " ms  "
+				<< job.mFileName;
+			if (job.mExitCode != 0)
+			{
+				std::cerr << " (failed)";
+			}
+			std::cerr << std::endl;
+		}
+	}
+
+	return retVal;
+}
@@ -0,0 +1,139 @@
+//
+//  Driver.h
+//  uscc
+//
+//  Declares the functions the uscc driver uses to run
+//  compiles. A compile writes everything it would print
+//  to the streams it's handed, so several compiles can
+//  run on a pool of threads and still produce output in
+//  a deterministic order.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include "../parse/Emitter.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace uscc
+{
+namespace driver
+{
+
+// Options that control a single compile (set on the command line)
+struct CompileOptions
+{
+	CompileOptions()
+	: mPrintAST(false)
+	, mPrintSymbols(false)
+	, mPrintIR(false)
+	, mOptimize(false)
+	, mOptLevel(0)
+	, mForceBitcode(false)
+	, mAssembly(false)
+	, mObject(false)
+	, mTimeReport(false)
+	, mPerfCounters(false)
+	, mMemReport(false)
+	, mCacheSize(256 * 1024 * 1024)
+	, mRun(false)
+	, mOptThreads(0)
+	, mParallelScan(false)
+	, mParseThreads(0)
+	{ }
+
+	// -a
+	bool mPrintAST;
+	// -l
+	bool mPrintSymbols;
+	// -p
+	bool mPrintIR;
+	// -O, -O1, -O2, -O3 or --passes
+	bool mOptimize;
+	// 1 for -O and -O1, up to 3 for -O3 (0 without optimization)
+	unsigned int mOptLevel;
+	// --passes (if set, this is run instead of a level)
+	std::string mPasses;
+	// -b
+	bool mForceBitcode;
+	// -s
+	bool mAssembly;
+	// -c
+	bool mObject;
+	// -march, -mcpu (and -O)
+	parse::NativeTarget mTarget;
+	// -o (empty if the default output name should be used,
+	// or - to write to the output stream of the compile)
+	std::string mOutputFile;
+	// -ftime-report
+	bool mTimeReport;
+	// -ftime-trace (empty if no trace should be written)
+	std::string mTimeTraceFile;
+	// --perf-counters
+	bool mPerfCounters;
+	// --mem-report
+	bool mMemReport;
+	// --cache-dir (empty if there's no cache)
+	std::string mCacheDir;
+	// --cache-size, in bytes
+	uint64_t mCacheSize;
+	// --func-cache (empty if there's no function cache)
+	std::string mFuncCacheDir;
+	// --run
+	bool mRun;
+	// -fparallel-codegen (0 if it isn't set)
+	unsigned int mOptThreads;
+	// -fparallel-scan
+	bool mParallelScan;
+	// -fparallel-parse (0 if it isn't set)
+	unsigned int mParseThreads;
+	// --emit-ast (empty if the AST shouldn't be saved)
+	std::string mEmitASTFile;
+};
+
+// Compiles a single file (or stdin, if fileName is -).
+// Anything that would go to stdout is written to out, and
+// diagnostics are written to err.
+// Returns the exit code for this compile.
+int compileFile(const std::string& fileName, const CompileOptions& options,
+				std::ostream& out, std::ostream& err);
+
+// Compiles source that's already in memory.
+// fileName is only used in diagnostics and to pick the
+// default output file name.
+int compileSource(const std::string& fileName, const std::string& source,
+				  const CompileOptions& options,
+				  std::ostream& out, std::ostream& err);
+
+// Compiles the files as one program: each file can call the
+// functions the others define, and they're all emitted into
+// one module (so the optimizer sees the whole program).
+// The files are parsed on up to numThreads threads. The output
+// files are named after the first file, unless -o is set.
+int compileProgram(const std::vector<std::string>& fileNames,
+				   const CompileOptions& options, unsigned int numThreads,
+				   std::ostream& out, std::ostream& err);
+
+// Compiles each file with its own Parser/Emitter on a pool
+// of numThreads workers.
+// The output of each file is written to stdout/stderr in
+// the order the files were specified, regardless of which
+// compile finishes first.
+// If summary is true, the wall time of each file is written
+// to stderr once all compiles are done.
+// Returns 0 if every file compiled, otherwise 1.
+int compileBatch(const std::vector<std::string>& fileNames,
+				 const CompileOptions& options,
+				 unsigned int numThreads, bool summary);
+
+} // driver
+} // uscc
@@ -0,0 +1,91 @@
+//
+//  MemoryHooks.cpp
+//  uscc
+//
+//  Replaces the global operator new/delete, so --mem-report
+//  can count heap allocations.
+//  Until --mem-report turns the counting on, each hook only
+//  checks a flag and calls malloc or free.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "../support/MemoryStats.h"
+#include <cstdlib>
+#include <new>
+
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#define USCC_BLOCK_SIZE(ptr) malloc_size(ptr)
+#else
+#include <malloc.h>
+#define USCC_BLOCK_SIZE(ptr) malloc_usable_size(ptr)
+#endif
+
+using namespace uscc;
+
+void* operator new(size_t size)
+{
+	void* ptr = std::malloc(size ? size : 1);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	if (support::allocationTrackingEnabled())
+	{
+		support::noteAllocation(USCC_BLOCK_SIZE(ptr));
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	void* ptr = std::malloc(size ? size : 1);
+	if (ptr && support::allocationTrackingEnabled())
+	{
+		support::noteAllocation(USCC_BLOCK_SIZE(ptr));
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (ptr)
+	{
+		if (support::allocationTrackingEnabled())
+		{
+			support::noteFree(USCC_BLOCK_SIZE(ptr));
+		}
+		std::free(ptr);
+	}
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	operator delete(ptr);
+}
@@ -0,0 +1,92 @@
+//
+//  Run.cpp
+//  uscc
+//
+//  Implements the in-process execution used by uscc --run.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "Run.h"
+#include "../support/Timing.h"
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/TargetSelect.h>
+#pragma clang diagnostic pop
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace uscc;
+using namespace llvm;
+
+namespace
+{
+
+std::once_flag sInitNative;
+
+} // anonymous
+
+int driver::runModule(Module* module, const std::string& fileName, std::ostream& err)
+{
+	// The native target only has to be set up once per process
+	std::call_once(sInitNative, []()
+	{
+		InitializeNativeTarget();
+		InitializeNativeTargetAsmPrinter();
+		InitializeNativeTargetAsmParser();
+	});
+	
+	Function* mainFunc = module->getFunction("main");
+	if (!mainFunc || mainFunc->isDeclaration())
+	{
+		delete module;
+		err << "uscc: error: " << fileName << " has no main function to run." << std::endl;
+		return 1;
+	}
+	
+	std::unique_ptr<ExecutionEngine> engine;
+	{
+		support::PhaseScope timeJit("jit");
+		
+		// On success, the engine owns module
+		std::string errStr;
+		engine.reset(EngineBuilder(module)
+					 .setErrorStr(&errStr)
+					 .setEngineKind(EngineKind::JIT)
+					 .setUseMCJIT(true)
+					 .create());
+		if (!engine)
+		{
+			delete module;
+			err << "uscc: error: Unable to create the JIT: " << errStr << std::endl;
+			return 1;
+		}
+		engine->finalizeObject();
+	}
+	
+	int retVal;
+	{
+		support::PhaseScope timeRun("run");
+		std::vector<std::string> args;
+		args.push_back(fileName);
+		retVal = engine->runFunctionAsMain(mainFunc, args, nullptr);
+		
+		// The program writes with the C library, so make sure everything
+		// it printed is out before uscc writes anything else
+		std::fflush(stdout);
+	}
+	
+	return retVal;
+}
@@ -0,0 +1,41 @@
+//
+//  Run.h
+//  uscc
+//
+//  Declares the in-process execution used by uscc --run.
+//  The verified module is handed straight to MCJIT, so
+//  running a program doesn't write, reread or reparse any
+//  bitcode, and doesn't launch lli.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <ostream>
+#include <string>
+
+namespace llvm
+{
+	class Module;
+}
+
+namespace uscc
+{
+namespace driver
+{
+
+// JIT compiles module and calls its main function.
+// Takes ownership of module. The program writes to the
+// process stdout directly.
+// Returns the value main returns, or 1 if module
+// couldn't be run (with the reason written to err).
+int runModule(llvm::Module* module, const std::string& fileName, std::ostream& err);
+
+} // driver
+} // uscc
@@ -0,0 +1,275 @@
+//
+//  Server.cpp
+//  uscc
+//
+//  Implements the compile server used by uscc --serve.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#include "Server.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace uscc;
+using namespace uscc::driver;
+
+namespace
+{
+
+// Reads and writes a file descriptor, so a socket connection
+// can be served by serveStream
+class FdStreamBuf : public std::streambuf
+{
+public:
+	FdStreamBuf(int fd)
+	: mFd(fd)
+	{
+		setg(mIn, mIn, mIn);
+		setp(mOut, mOut + sizeof(mOut));
+	}
+
+	~FdStreamBuf()
+	{
+		flushOutput();
+	}
+
+protected:
+	int_type underflow() override
+	{
+		ssize_t count;
+		do
+		{
+			count = ::read(mFd, mIn, sizeof(mIn));
+		}
+		while (count < 0 && errno == EINTR);
+
+		if (count <= 0)
+		{
+			return traits_type::eof();
+		}
+
+		setg(mIn, mIn, mIn + count);
+		return traits_type::to_int_type(*gptr());
+	}
+
+	int_type overflow(int_type c) override
+	{
+		if (flushOutput() != 0)
+		{
+			return traits_type::eof();
+		}
+
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+		{
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	int sync() override
+	{
+		return flushOutput();
+	}
+
+private:
+	// Writes out everything in the put area.
+	// Returns 0 on success.
+	int flushOutput()
+	{
+		char* curr = pbase();
+		while (curr < pptr())
+		{
+			ssize_t count = ::write(mFd, curr, pptr() - curr);
+			if (count < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return -1;
+			}
+			curr += count;
+		}
+		setp(mOut, mOut + sizeof(mOut));
+		return 0;
+	}
+
+	int mFd;
+	char mIn[4096];
+	char mOut[4096];
+};
+
+// Returns true if a server is accepting connections at addr
+bool isListening(const sockaddr_un& addr)
+{
+	int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+	bool connected = ::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+	::close(fd);
+	return connected;
+}
+
+} // anonymous
+
+void driver::serveStream(std::istream& input, std::ostream& output,
+						 const RequestHandler& handler)
+{
+	std::string line;
+	while (std::getline(input, line))
+	{
+		std::istringstream lineStream(line);
+		std::string command;
+		if (!(lineStream >> command))
+		{
+			// Skip blank lines
+			continue;
+		}
+
+		if (command == "quit")
+		{
+			break;
+		}
+
+		std::ostringstream out;
+		std::ostringstream err;
+		int exitCode = 1;
+		bool sessionOver = false;
+
+		if (command == "compile")
+		{
+			std::vector<std::string> args;
+			std::string arg;
+			while (lineStream >> arg)
+			{
+				args.push_back(arg);
+			}
+
+			exitCode = handler(args, nullptr, nullptr, out, err);
+		}
+		else if (command == "source")
+		{
+			std::string name;
+			size_t length = 0;
+			if (!(lineStream >> name >> length))
+			{
+				err << "uscc: error: Expected source <name> <length>." << std::endl;
+			}
+			else
+			{
+				std::vector<std::string> args;
+				std::string arg;
+				while (lineStream >> arg)
+				{
+					args.push_back(arg);
+				}
+
+				std::string source(length, '\0');
+				input.read(&source[0], static_cast<std::streamsize>(length));
+				if (static_cast<size_t>(input.gcount()) != length)
+				{
+					err << "uscc: error: Input ended before the end of the source." << std::endl;
+					sessionOver = true;
+				}
+				else
+				{
+					exitCode = handler(args, &name, &source, out, err);
+				}
+			}
+		}
+		else
+		{
+			err << "uscc: error: Unknown request '" << command << "'." << std::endl;
+		}
+
+		std::string outStr = out.str();
+		std::string errStr = err.str();
+		output << "status " << exitCode << ' ' << outStr.size() << ' '
+			<< errStr.size() << '\n' << outStr << errStr;
+		output.flush();
+
+		if (sessionOver)
+		{
+			break;
+		}
+	}
+}
+
+bool driver::serveSocket(const char* path, const RequestHandler& handler)
+{
+	// A client that hangs up shouldn't take down the server
+	std::signal(SIGPIPE, SIG_IGN);
+
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (std::strlen(path) >= sizeof(addr.sun_path))
+	{
+		return false;
+	}
+	std::strcpy(addr.sun_path, path);
+
+	int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0)
+	{
+		return false;
+	}
+
+	// Remove a socket left behind by a previous server. Anything
+	// else at path (including a socket a server is still listening
+	// on) is left alone, and bind fails.
+	struct stat info;
+	if (::lstat(path, &info) == 0 && S_ISSOCK(info.st_mode) && !isListening(addr))
+	{
+		::unlink(path);
+	}
+	if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+		::listen(listenFd, SOMAXCONN) != 0)
+	{
+		::close(listenFd);
+		return false;
+	}
+
+	for (;;)
+	{
+		int fd = ::accept(listenFd, nullptr, nullptr);
+		if (fd < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+			{
+				continue;
+			}
+			::close(listenFd);
+			return false;
+		}
+
+		std::thread([fd, handler]()
+		{
+			{
+				FdStreamBuf buffer(fd);
+				std::iostream stream(&buffer);
+				serveStream(stream, stream, handler);
+			}
+			::close(fd);
+		}).detach();
+	}
+}
@@ -0,0 +1,71 @@
+//
+//  Server.h
+//  uscc
+//
+//  Declares the compile server used by uscc --serve.
+//  The server answers compile requests without restarting
+//  the process, so LLVM initialization and pass
+//  registration only happen once.
+//
+//  Requests are read one line at a time:
+//
+//    compile <uscc options> <input>
+//        Compiles a file on disk.
+//    source <name> <length> <uscc options>
+//        Compiles the <length> bytes of USC source that
+//        immediately follow the request line. <name> is
+//        used in diagnostics and for the default output name.
+//    quit
+//        Ends the session.
+//
+//  Options are separated by whitespace, and can't contain
+//  whitespace themselves. Every request is answered with
+//
+//    status <exit code> <stdout length> <stderr length>
+//
+//  followed by the stdout and stderr bytes of the compile.
+//
+//---------------------------------------------------------
+//  Copyright (c) 2014, Sanjay Madhav
+//  All rights reserved.
+//
+//  This file is distributed under the BSD license.
+//  See LICENSE.TXT for details.
+//---------------------------------------------------------
+
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace uscc
+{
+namespace driver
+{
+
+// Runs a single request.
+// args holds the options from the request line, and source
+// points to the inline source (or is null for "compile").
+// Anything the compile prints is written to out/err.
+// Returns the exit code of the compile.
+typedef std::function<int(const std::vector<std::string>& args,
+						  const std::string* sourceName,
+						  const std::string* source,
+						  std::ostream& out, std::ostream& err)> RequestHandler;
+
+// Answers requests from input until it's closed or "quit" is sent
+void serveStream(std::istream& input, std::ostream& output,
+				 const RequestHandler& handler);
+
+// Listens on a Unix domain socket at path, and answers the
+// requests sent over each connection.
+// Every connection is served on its own thread.
+// A stale socket at path is replaced, but nothing else is.
+// Only returns if the socket can't be set up (returns false).
+bool serveSocket(const char* path, const RequestHandler& handler);
+
+} // driver
+} // uscc
@@ -14,10 +14,13 @@
 //  See LICENSE.TXT for details.
 //---------------------------------------------------------
 
-#include "../parse/Parse.h"
-#include "../parse/ParseExcept.h"
+#include "Driver.h"
+#include "Server.h"
+#include "../opt/Passes.h"
 #include "../parse/Emitter.h"
+#include <algorithm>
 #include <iostream>
+#include <thread>
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wcast-qual"
 #pragma clang diagnostic push
@@ -28,17 +31,14 @@
 #pragma GCC diagnostic pop
 
 using namespace uscc;
+using namespace uscc::driver;
 
-int main(int argc, const char * argv[])
+namespace
+{
+
+// Adds the options shared by the command line and compile server requests
+void addCompileOptions(ez::ezOptionParser& opt)
 {
-	ez::ezOptionParser opt;
-	opt.doublespace = 1;
-	opt.overview = "University Simple C Compiler v0.5";
-	opt.syntax = "uscc [OPTIONS] <input>";
-	
-	opt.add("", false, 0, 0,
-			"Display this message.",
-			"-h", "--help");
 	opt.add("", false, 0, 0,
 			"Output parse AST to stdout, and do not proceed to further compilation steps. "
 			"(Unless -b or -s is also specified.)",
@@ -56,18 +56,281 @@ int main(int argc, const char * argv[])
 			"Output LLVM IR to stdout.",
 			"-p", "--print-bc");
 	opt.add("", false, 0, 0,
-			"Enable optimization passes.",
+			"Enable optimization passes (the same as -O1).",
 			"-O");
-	// Note: ASM generation disabled
-	/*opt.add("", false, 0, 0,
+	opt.add("", false, 0, 0,
+			"Run the cheap uscc passes: constant ops, constant branches, dead blocks and LICM.",
+			"-O1");
+	opt.add("", false, 0, 0,
+			"Like -O1, then run uscc's dead code elimination and some cheap LLVM cleanups.",
+			"-O2");
+	opt.add("", false, 0, 0,
+			"Like -O2, then run LLVM's standard scalar, loop and vector passes.",
+			"-O3");
+	opt.add("", false, 1, 0,
+			"Run exactly the passes in this comma separated list, in order, instead of an "
+			"optimization level. For example: constops,constbranch,deadblocks,licm. "
+			"Passes can be repeated. Use --list-passes to see every pass.",
+			"--passes");
+	opt.add("", false, 1, 0,
+			"Optimize each function in a module of its own, on the specified number of "
+			"threads (0 uses one thread per core). The output is the same for any "
+			"number of threads.",
+			"-fparallel-codegen");
+	opt.add("", false, 0, 0,
+			"Lex the source on a thread of its own, while the parser runs. "
+			"This only helps on large files, and is ignored for stdin.",
+			"-fparallel-scan");
+	opt.add("", false, 1, 0,
+			"Parse and check the functions of the file on the specified number of threads "
+			"(0 uses one thread per core). The output is the same for any number of threads. "
+			"This only helps on large files, and is ignored for stdin.",
+			"-fparallel-parse");
+	opt.add("", false, 1, 0,
+			"Save the AST and symbols of the file to the specified file, in a binary format. "
+			"uscc reads a saved file in place of source, and skips the scan and the parse. "
+			"Unless -b, -p, -s or -c is also set, nothing else is written. "
+			"Not supported in whole-program compiles.",
+			"--emit-ast");
+	opt.add("", false, 0, 0,
 			"Generate an x86 assembly file from the LLVM IR generated by uscc."
-			" No optimization is performed."
+			" The code generator only optimizes if -O is also specified."
 			"\n\nThis is provided for convenience in case LLVM developer tools (specifically llc)"
 			" are not installed. GCC or clang can turn this assembly file into an executable.",
-			"-s", "--assembly");*/
+			"-s", "-S", "--assembly");
+	opt.add("", false, 0, 0,
+			"Generate an x86 object file from the LLVM IR generated by uscc, like -s. "
+			"GCC or clang can link this object file into an executable.",
+			"-c", "--compile");
+	opt.add("", false, 1, 0,
+			"Architecture to generate code for with -s or -c, such as x86 or x86-64. "
+			"The default is the host's.",
+			"-march");
 	opt.add("", false, 1, 0,
-			"Specify output file. This is ignored if -b and -s are specified simultaneously.",
+			"CPU to generate code for with -s or -c, such as corei7. "
+			"native uses the host's CPU and its features.",
+			"-mcpu");
+	opt.add("", false, 1, 0,
+			"Specify output file. This is ignored if -b and -s (or -c) are specified simultaneously. "
+			"- writes the output to stdout (with -p, only the IR is written).",
 			"-o", "--output");
+	opt.add("", false, 0, 0,
+			"Write the time spent in each phase of the compile (scan, parse, emit, each "
+			"optimization pass, verify and writing bitcode) to stderr.",
+			"-ftime-report");
+	opt.add("", false, 1, 0,
+			"Write the time spent in each phase of the compile to the specified file, "
+			"in the Chrome trace event format.",
+			"-ftime-trace");
+	opt.add("", false, 0, 0,
+			"Like -ftime-report, but also record the instructions, cycles, cache misses "
+			"and branch misses of each phase with the hardware performance counters "
+			"(Linux only).",
+			"--perf-counters");
+	opt.add("", false, 0, 0,
+			"Like -ftime-report, but also record the heap allocations, bytes allocated "
+			"and peak RSS of each phase.",
+			"--mem-report");
+	opt.add("", false, 1, 0,
+			"Cache the bitcode of each compile in the specified directory, keyed by a hash "
+			"of the source, the compiler version and the options. Compiling the same source "
+			"with the same options again links the cached bitcode instead of recompiling. "
+			"The directory can be shared by several uscc processes. "
+			"Only used when bitcode is the only output.",
+			"--cache-dir");
+	opt.add("256", false, 1, 0,
+			"Maximum size of the --cache-dir cache, in megabytes. "
+			"The least recently used entries are deleted to stay under it.",
+			"--cache-size");
+	opt.add("", false, 1, 0,
+			"Cache the bitcode of each function in the specified directory, keyed by a hash "
+			"of the function and the signatures of the functions it calls. On a recompile, "
+			"only the functions that changed are emitted and optimized again. "
+			"The size cap is shared with --cache-size.",
+			"--func-cache");
+}
+
+// Reads the options added by addCompileOptions
+CompileOptions readCompileOptions(ez::ezOptionParser& opt)
+{
+	CompileOptions options;
+	options.mPrintAST = opt.isSet("-a") != 0;
+	options.mPrintSymbols = opt.isSet("-l") != 0;
+	options.mPrintIR = opt.isSet("-p") != 0;
+	if (opt.isSet("-O3"))
+	{
+		options.mOptLevel = 3;
+	}
+	else if (opt.isSet("-O2"))
+	{
+		options.mOptLevel = 2;
+	}
+	else if (opt.isSet("-O1") || opt.isSet("-O"))
+	{
+		options.mOptLevel = 1;
+	}
+	if (opt.isSet("--passes"))
+	{
+		opt.get("--passes")->getString(options.mPasses);
+	}
+	options.mOptimize = options.mOptLevel > 0 || !options.mPasses.empty();
+	if (opt.isSet("-fparallel-codegen"))
+	{
+		int optThreads = 1;
+		opt.get("-fparallel-codegen")->getInt(optThreads);
+		if (optThreads <= 0)
+		{
+			optThreads = static_cast<int>(std::thread::hardware_concurrency());
+		}
+		options.mOptThreads = static_cast<unsigned int>(std::max(optThreads, 1));
+	}
+	options.mParallelScan = opt.isSet("-fparallel-scan") != 0;
+	if (opt.isSet("-fparallel-parse"))
+	{
+		int parseThreads = 1;
+		opt.get("-fparallel-parse")->getInt(parseThreads);
+		if (parseThreads <= 0)
+		{
+			parseThreads = static_cast<int>(std::thread::hardware_concurrency());
+		}
+		options.mParseThreads = static_cast<unsigned int>(std::max(parseThreads, 1));
+	}
+	if (opt.isSet("--emit-ast"))
+	{
+		opt.get("--emit-ast")->getString(options.mEmitASTFile);
+	}
+	options.mForceBitcode = opt.isSet("-b") != 0;
+	options.mAssembly = opt.isSet("-s") != 0;
+	options.mObject = opt.isSet("-c") != 0;
+	if (opt.isSet("-march"))
+	{
+		opt.get("-march")->getString(options.mTarget.mArch);
+	}
+	if (opt.isSet("-mcpu"))
+	{
+		opt.get("-mcpu")->getString(options.mTarget.mCPU);
+	}
+	options.mTarget.mOptimize = options.mOptimize;
+	if (opt.isSet("-o"))
+	{
+		opt.get("-o")->getString(options.mOutputFile);
+	}
+	options.mTimeReport = opt.isSet("-ftime-report") != 0;
+	if (opt.isSet("-ftime-trace"))
+	{
+		opt.get("-ftime-trace")->getString(options.mTimeTraceFile);
+	}
+	options.mPerfCounters = opt.isSet("--perf-counters") != 0;
+	options.mMemReport = opt.isSet("--mem-report") != 0;
+	if (opt.isSet("--cache-dir"))
+	{
+		opt.get("--cache-dir")->getString(options.mCacheDir);
+	}
+	int cacheSize = 256;
+	opt.get("--cache-size")->getInt(cacheSize);
+	if (cacheSize > 0)
+	{
+		options.mCacheSize = static_cast<uint64_t>(cacheSize) * 1024 * 1024;
+	}
+	if (opt.isSet("--func-cache"))
+	{
+		opt.get("--func-cache")->getString(options.mFuncCacheDir);
+	}
+	return options;
+}
+
+// Runs one compile server request.
+// The options are parsed exactly like they are on the command line.
+int runRequest(const std::vector<std::string>& args,
+			   const std::string* sourceName, const std::string* source,
+			   std::ostream& out, std::ostream& err)
+{
+	std::vector<const char*> argv;
+	argv.push_back("uscc");
+	for (const auto& arg : args)
+	{
+		argv.push_back(arg.c_str());
+	}
+	
+	ez::ezOptionParser opt;
+	addCompileOptions(opt);
+	opt.parse(static_cast<int>(argv.size()), argv.data());
+	CompileOptions options = readCompileOptions(opt);
+	
+	if (source)
+	{
+		if (opt.lastArgs.size() != 0)
+		{
+			err << "uscc: error: A source request can't name an input file." << std::endl;
+			return 1;
+		}
+		return compileSource(*sourceName, *source, options, out, err);
+	}
+	
+	if (opt.lastArgs.size() != 1)
+	{
+		err << "uscc: error: A compile request needs exactly one input file." << std::endl;
+		return 1;
+	}
+	if (*opt.lastArgs[0] == "-")
+	{
+		// stdin is where the requests come from
+		err << "uscc: error: A compile request can't read stdin; use a source request." << std::endl;
+		return 1;
+	}
+	return compileFile(*opt.lastArgs[0], options, out, err);
+}
+
+} // anonymous
+
+int main(int argc, const char * argv[])
+{
+	ez::ezOptionParser opt;
+	opt.doublespace = 1;
+	opt.overview = "University Simple C Compiler v0.5";
+	opt.syntax = "uscc [OPTIONS] <input> [<input> ...]\n\n"
+		"An input of - reads the source from stdin.";
+	
+	opt.add("", false, 0, 0,
+			"Display this message.",
+			"-h", "--help");
+	addCompileOptions(opt);
+	opt.add("1", false, 1, 0,
+			"Number of threads to use when more than one input file is specified. "
+			"Each file is compiled with its own parser and emitter, and output is "
+			"always written in the order the files were given. "
+			"0 uses one thread per core.",
+			"-j", "--jobs");
+	opt.add("", false, 0, 0,
+			"When more than one input file is specified, write the wall time "
+			"of each file to stderr.",
+			"--summary");
+	opt.add("", false, 0, 0,
+			"Run as a compile server, answering requests on stdin. "
+			"See uscc/Server.h for the request format.",
+			"--serve");
+	opt.add("", false, 1, 0,
+			"Run as a compile server, answering requests sent to the Unix "
+			"domain socket at the specified path.",
+			"--socket");
+	opt.add("", false, 0, 0,
+			"Run the program's main function in this process with the JIT, instead "
+			"of writing a bitcode file (unless -b is also specified). The program's "
+			"output goes to stdout, and uscc exits with the value main returns.",
+			"--run");
+	opt.add("", false, 1, 0,
+			"Register allocator to use with -s or -c: uscc (the USCC register allocator, "
+			"when LLVM is built with it), basic, fast, greedy or pbqp. "
+			"The default is greedy with -O, and fast without it.",
+			"--regalloc");
+	opt.add("", false, 0, 0,
+			"List the passes --passes accepts.",
+			"--list-passes");
+	opt.add("", false, 0, 0,
+			"Compile all the input files as one program. Each file can call the functions "
+			"the others define, and everything is emitted into one module. The files are "
+			"parsed on -j threads. The output is named after the first file, unless -o is set.",
+			"--whole-program");
 	
 	opt.parse(argc, argv);
 	if (opt.isSet("-h"))
@@ -78,142 +341,112 @@ int main(int argc, const char * argv[])
 		return 0;
 	}
 	
+	if (opt.isSet("--list-passes"))
+	{
+		for (const auto& name : uscc::opt::getOptPassNames())
+		{
+			std::cout << name << std::endl;
+		}
+		return 0;
+	}
+	
+	// Register the analyses used by the opt passes once, up front
+	uscc::opt::initializeOptPasses();
+	
+	if (opt.isSet("--regalloc"))
+	{
+		std::string regAlloc;
+		opt.get("--regalloc")->getString(regAlloc);
+		if (!parse::Emitter::setRegisterAllocator(regAlloc))
+		{
+			std::cerr << "uscc: error: Unknown register allocator " << regAlloc << "." << std::endl;
+			return 1;
+		}
+	}
+	
+	if (opt.isSet("--socket"))
+	{
+		std::string path;
+		opt.get("--socket")->getString(path);
+		if (!serveSocket(path.c_str(), runRequest))
+		{
+			std::cerr << "uscc: error: Unable to listen on socket " << path << "." << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+	
+	if (opt.isSet("--serve"))
+	{
+		// Requests are read with iostreams only
+		std::ios::sync_with_stdio(false);
+		serveStream(std::cin, std::cout, runRequest);
+		return 0;
+	}
+	
 	if (opt.lastArgs.size() < 1)
 	{
 		std::cerr << "uscc: error: No input file specified." << std::endl;
 		return 1;
 	}
-	if (opt.lastArgs.size() > 1)
+	
+	CompileOptions options = readCompileOptions(opt);
+	options.mRun = opt.isSet("--run") != 0;
+	
+	if (options.mAssembly && options.mObject)
 	{
-		std::cerr << "uscc: error: Only a single input file is supported." << std::endl;
+		std::cerr << "uscc: error: -s and -c cannot be used together." << std::endl;
 		return 1;
 	}
 	
-	const char* fileName = opt.lastArgs[0]->c_str();
-	std::ostream* astStream = nullptr;
-	bool outputSymbols = false;
-	if (opt.isSet("-a"))
+	int numThreads = 1;
+	opt.get("-j")->getInt(numThreads);
+	if (numThreads <= 0)
 	{
-		astStream = &std::cout;
+		numThreads = static_cast<int>(std::thread::hardware_concurrency());
 	}
-
-	if (opt.isSet("-l"))
+	
+	std::vector<std::string> fileNames;
+	for (auto arg : opt.lastArgs)
 	{
-		outputSymbols = true;
+		fileNames.push_back(*arg);
 	}
 	
-	try
+	if (opt.isSet("--whole-program"))
 	{
-		parse::Parser parser(fileName, &std::cerr, astStream, outputSymbols);
-		
-		if (!parser.IsValid())
-		{
-			std::cerr << parser.GetNumErrors() << " Error(s)" << std::endl;
-			return 1;
-		}
-		
-		// If we set -a, we don't continue to later steps
-		if (opt.isSet("-a") &&
-			!opt.isSet("-b") && !opt.isSet("-s") && !opt.isSet("-p"))
-		{
-			return 0;
-		}
-		
-		// Now emit LLVM bitcode
-		parse::Emitter emit(parser);
-		
-		// Check if we should run optimization passes
-		if (opt.isSet("-O"))
-		{
-			emit.optimize();
-		}
-		
-		bool shouldEmitBC = true;
-		if (opt.isSet("-s") && !opt.isSet("-b"))
-		{
-			shouldEmitBC = false;
-		}
-		
-		// Print the human readable bitcode to stdout
-		if (opt.isSet("-p"))
-		{
-			emit.print();
-		}
-		
-		// Before we write anything, verify the IR doesn't have major errors
-		if (!emit.verify())
-		{
-			std::cerr << std::endl;
-			std::cerr << "uscc: error: Emitted bad IR. Compilation halted." << std::endl;
-			return 1;
-		}
-		
-		// Write the bitcode file
-		if (shouldEmitBC)
-		{
-			std::string bcFile;
-			// If output file not specified, default is
-			// input file with the extension replaced with .bc
-			if (!opt.isSet("-o") || opt.isSet("-s"))
-			{
-				bcFile = fileName;
-				size_t extLoc = bcFile.find_last_of(".");
-				if (extLoc != std::string::npos)
-				{
-					// Strip the last extension
-					bcFile = bcFile.substr(0, extLoc);
-				}
-				bcFile += ".bc";
-			}
-			else
-			{
-				ez::OptionGroup* params = opt.get("-o");
-				params->getString(bcFile);
-			}
-			
-			emit.writeBitcode(bcFile.c_str());
-		}
-		
-		// Functionality removed because it doesn't work with LLVM 3.5.0
-		// Write the assembly file
-		/*if (opt.isSet("-s"))
-		{
-			std::string asmFile;
-			// If output file not specified, default is
-			// input file with the extension replaced with .bc
-			if (!opt.isSet("-o") || opt.isSet("-b"))
-			{
-				asmFile = fileName;
-				size_t extLoc = asmFile.find_last_of(".");
-				if (extLoc != std::string::npos)
-				{
-					// Strip the last extension
-					asmFile = asmFile.substr(0, extLoc);
-				}
-				asmFile += ".s";
-			}
-			else
-			{
-				ez::OptionGroup* params = opt.get("-o");
-				params->getString(asmFile);
-			}
-			
-			if (!emit.writeAsm(asmFile.c_str()))
-			{
-				std::cerr << "uscc: error: Unable to emit assembly. Compilation halted." << std::endl;
-			}
-		}*/
-	}
-	catch (parse::FileNotFound& fe)
-	{
-		std::cerr << "uscc: error: Input file " << fileName << " not found." << std::endl;
-	}
-	catch (parse::ParseExcept& e)
-	{
-		std::cerr << "uscc: error: Critical error. Compilation halted." << std::endl;
+		return compileProgram(fileNames, options, static_cast<unsigned int>(numThreads),
+							  std::cout, std::cerr);
+	}
+	
+	if (opt.lastArgs.size() == 1)
+	{
+		return compileFile(*opt.lastArgs[0], options, std::cout, std::cerr);
+	}
+	
+	if (!options.mOutputFile.empty())
+	{
+		std::cerr << "uscc: error: -o cannot be used with more than one input file." << std::endl;
+		return 1;
+	}
+	
+	if (!options.mEmitASTFile.empty())
+	{
+		std::cerr << "uscc: error: --emit-ast cannot be used with more than one input file." << std::endl;
+		return 1;
+	}
+	
+	if (!options.mTimeTraceFile.empty())
+	{
+		std::cerr << "uscc: error: -ftime-trace cannot be used with more than one input file." << std::endl;
 		return 1;
 	}
 	
-	return 0;
+	if (options.mRun)
+	{
+		std::cerr << "uscc: error: --run cannot be used with more than one input file." << std::endl;
+		return 1;
+	}
+	
+	return compileBatch(fileNames, options, static_cast<unsigned int>(numThreads),
+						opt.isSet("--summary") != 0);
 }
-